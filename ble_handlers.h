@@ -6,6 +6,24 @@
 #ifndef BLE_HANDLERS_H
 #define BLE_HANDLERS_H
 
+#include <M5Unified.h>
+#include "BLEDevice.h"
+#include "BLEUtils.h"
+#include "BLEServer.h"
+#include "BLE2902.h"
+
+#include "camera.h"
+#include "capture.h"
+#include "config.h"
+#include "events.h"
+#include "heapprobe.h"
+#include "log.h"
+#include "scheduler.h"
+#include "settings.h"
+#include "soak.h"
+#include "toast.h"
+#include "trace.h"
+
 // BLE variables
 BLEServer* pServer = nullptr;
 BLEService* pService = nullptr;
@@ -13,6 +31,14 @@ BLECharacteristic* pWriteCharacteristic = nullptr;
 BLECharacteristic* pNotifyCharacteristic = nullptr;
 BLEScan* pBLEScan = nullptr;
 
+// Whether we have advertising running. Connecting stops it in the controller
+// without telling us, so this can be stale "true" - that only costs the
+// settle time before the next start.
+bool advertisingOn = false;
+// Time the controller needs after stopping advertising before it is set up
+// and started again. loop() waits it out on DEADLINE_ADVERTISING.
+const unsigned long advertisingSettleTime = 100;
+
 // Global GATT Interface ID for unicast
 uint16_t g_gattsIf = 0;
 
@@ -20,243 +46,99 @@ uint16_t g_gattsIf = 0;
 void myGattsHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
     if (event == ESP_GATTS_REG_EVT) {
         g_gattsIf = gatts_if;
-        Serial.print("Captured GATTS IF: ");
-        Serial.println(g_gattsIf);
+        LOGI("Captured GATTS IF: %u", g_gattsIf);
     }
 }
 
-// UI Request flags (handled in loop)
-volatile bool updateScreenRequested = false;
-volatile int connectionMessageId = 0; // 0=None, 1=Cam1, 2=Cam2, 3=Unknown, 4=Paired
-volatile int pairingSlotCompleted = 0;
+// UI Request flags (set while handling BLE events, consumed in loop)
+bool updateScreenRequested = false;
 
 // Forward declarations
 void setNormalAdvertising();
 void setWakeAdvertising(uint8_t* wakePayload);
+void showNotConnectedMessage();  // ui.h
+
+// Publish a connect/disconnect event from a Bluedroid callback
+void pushLinkEvent(BleEventType type, uint16_t connId, const uint8_t* bda) {
+  trace(type == BLE_EVT_CONNECT ? TRACE_CONNECT : TRACE_DISCONNECT, 0, connId);
+  if (type == BLE_EVT_CONNECT) captureRecord(CAPTURE_CONNECT, connId, bda, 6);
+  else captureRecord(CAPTURE_DISCONNECT, connId, nullptr, 0);
+  BleEvent* evt = reserveBleEvent();
+  if (!evt) return;
+  evt->type = type;
+  evt->connId = connId;
+  evt->time = millis();
+  memcpy(evt->link.bda, bda, 6);
+  commitBleEvent();
+  signalLoop();
+}
+
+// Find the (complete or shortened) local name in a raw advertisement and copy
+// it into `out`. Reads the payload in place so the scan callback never
+// allocates. Returns false when the advertisement carries no name.
+bool findAdvertisedName(const uint8_t* payload, size_t len, char* out, size_t outSize) {
+  size_t pos = 0;
+  while (pos + 1 < len) {
+    uint8_t fieldLen = payload[pos];
+    if (fieldLen == 0 || pos + 1 + fieldLen > len) break;
+    uint8_t adType = payload[pos + 1];
+    if (adType == 0x09 || adType == 0x08) {  // Complete / shortened local name
+      size_t nameLen = fieldLen - 1;
+      if (nameLen >= outSize) nameLen = outSize - 1;
+      memcpy(out, payload + pos + 2, nameLen);
+      out[nameLen] = '\0';
+      return true;
+    }
+    pos += 1 + fieldLen;
+  }
+  return false;
+}
 
 // BLE Scan callback to capture camera info during pairing mode
 class MyScanCallbacks: public BLEAdvertisedDeviceCallbacks {
     void onResult(BLEAdvertisedDevice advertisedDevice) {
       if (!pairingMode) return; // Only process during pairing mode
+      HEAP_PROBE_SCOPE(HEAP_SITE_BLE_CALLBACK);
 
       // Look for Insta360 cameras
-      if (advertisedDevice.haveName()) {
-        String deviceName = advertisedDevice.getName().c_str();
-        String deviceAddress = advertisedDevice.getAddress().toString().c_str();
-
-        Serial.print("Scan found: ");
-        Serial.print(deviceName);
-        Serial.print(" @ ");
-        Serial.println(deviceAddress);
+      char name[30];
+      if (findAdvertisedName(advertisedDevice.getPayload(), advertisedDevice.getPayloadLength(),
+                             name, sizeof(name))) {
 
         // Check if this is an Insta360 camera
-        if (deviceName.startsWith("X3 ") ||
-            deviceName.startsWith("X4 ") ||
-            deviceName.startsWith("X5 ") ||
-            deviceName.startsWith("RS ") ||
-            deviceName.startsWith("ONE ") ||
-            deviceName.startsWith("Ace ") ||
-            deviceName.startsWith("ACE ")) {
-
-          // Found an Insta360 camera - save its info
-          detectedCameraName = deviceName;
-          detectedCameraAddress = deviceAddress;
-
-          Serial.print("Found Insta360 camera: ");
-          Serial.println(detectedCameraName);
+        if (strncmp(name, "X3 ", 3) == 0 ||
+            strncmp(name, "X4 ", 3) == 0 ||
+            strncmp(name, "X5 ", 3) == 0 ||
+            strncmp(name, "RS ", 3) == 0 ||
+            strncmp(name, "ONE ", 4) == 0 ||
+            strncmp(name, "Ace ", 4) == 0 ||
+            strncmp(name, "ACE ", 4) == 0) {
+
+          // Found an Insta360 camera - hand its info to loop()
+          BleEvent* evt = reserveBleEvent();
+          if (!evt) return;
+          BLEAddress address = advertisedDevice.getAddress();
+          evt->type = BLE_EVT_SCAN_RESULT;
+          evt->connId = 0;
+          evt->time = millis();
+          snprintf(evt->scan.name, sizeof(evt->scan.name), "%s", name);
+          memcpy(evt->scan.bda, *address.getNative(), 6);
+          evt->scan.addrType = advertisedDevice.getAddressType();
+          commitBleEvent();
+          signalLoop();
         }
       }
     }
 };
 
+// Callbacks run on the Bluedroid task - they only record events for loop()
 class MyServerCallbacks: public BLEServerCallbacks {
     void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t *param) {
-      // Get the connected device's address
-      char addressStr[18];
-      sprintf(addressStr, "%02x:%02x:%02x:%02x:%02x:%02x",
-              param->connect.remote_bda[0],
-              param->connect.remote_bda[1],
-              param->connect.remote_bda[2],
-              param->connect.remote_bda[3],
-              param->connect.remote_bda[4],
-              param->connect.remote_bda[5]);
-      String connectedAddress = String(addressStr);
-      uint16_t connId = param->connect.conn_id;
-
-      Serial.print("Device connected from address: ");
-      Serial.println(connectedAddress);
-      Serial.print("Connection ID: ");
-      Serial.println(connId);
-
-      // Check if we're in pairing mode and have detected a camera
-      if (pairingMode && detectedCameraName.length() > 0 && pairingCameraSlot > 0) {
-        // Stop scanning
-        if (pBLEScan) {
-          pBLEScan->stop();
-        }
-        pairingMode = false;
-
-        Serial.print("Pairing camera to slot ");
-        Serial.print(pairingCameraSlot);
-        Serial.print(": ");
-        Serial.println(detectedCameraName);
-
-        // Validate camera name format
-        bool validFormat = false;
-        if (detectedCameraName.length() >= 9) { // "X5 " + 6 chars minimum
-          int spaceIndex = detectedCameraName.indexOf(' ');
-          if (spaceIndex > 0 && detectedCameraName.length() - spaceIndex > 6) {
-            validFormat = true;
-          }
-        }
-
-        if (validFormat) {
-          // Save to the appropriate slot
-          saveCamera(pairingCameraSlot, detectedCameraName, detectedCameraAddress);
-
-          // Mark as connected
-          if (pairingCameraSlot == 1) {
-            camera1Connected = true;
-            camera1.connId = connId;
-            camera1ConnectedAddress = connectedAddress;
-          } else {
-            camera2Connected = true;
-            camera2.connId = connId;
-            camera2ConnectedAddress = connectedAddress;
-          }
-          
-          pairingSlotCompleted = pairingCameraSlot;
-          connectionMessageId = 4; // Paired message
-          pairingCameraSlot = 0;  // Reset pairing slot
-        } else {
-           // Invalid format handling - should be handled in main loop ideally, 
-           // but for now we just disconnect.
-           pServer->disconnect(connId);
-        }
-      } else if (pairingMode) {
-        // In pairing mode but no camera detected yet (direct connect?)
-        // This is ambiguous, usually scan finds it first.
-        // We'll treat it as unknown/failed for now.
-        pairingMode = false;
-        pairingCameraSlot = 0;
-        if (pBLEScan) {
-          pBLEScan->stop();
-        }
-        pServer->disconnect(connId);
-      } else {
-        // Not in pairing mode - check if this is a known camera reconnecting
-        bool knownCamera = false;
-
-        // Check if this is camera1
-        bool matched1 = false;
-        if (camera1.isValid && connectedAddress.equalsIgnoreCase(camera1.address)) {
-          camera1Connected = true;
-          camera1.connId = connId;
-          camera1ConnectedAddress = connectedAddress;
-          Serial.print("Camera 1 reconnected: ");
-          Serial.println(camera1.name);
-          knownCamera = true;
-          connectionMessageId = 1;
-          matched1 = true;
-        }
-
-        // Check if this is camera2
-        // Only match camera 2 if it wasn't already matched to camera 1, 
-        // OR if it is matched but we want to ensure unique assignment (prevent double-dot for single cam)
-        // If user REALLY wants same cam on both, we'll allow it but prioritize slot 1 visually if we had to choose.
-        // But the issue reported is confusing double-dots. 
-        // We will prevent Slot 2 from activating if Slot 1 already claimed this Connection ID, 
-        // UNLESS the addresses are explicitly different (which shouldn't happen if they matched the same string).
-        // Actually, if the addresses are identical, we should probably only light up one.
-        
-        bool matched2 = false;
-        if (camera2.isValid && connectedAddress.equalsIgnoreCase(camera2.address)) {
-           if (!matched1) {
-              camera2Connected = true;
-              camera2.connId = connId;
-              camera2ConnectedAddress = connectedAddress;
-              Serial.print("Camera 2 reconnected: ");
-              Serial.println(camera2.name);
-              knownCamera = true;
-              connectionMessageId = 2;
-              matched2 = true;
-           } else {
-              Serial.println("Device matches both slots - skipping Slot 2 activation to prevent duplicate status.");
-           }
-        }
-
-        if (!knownCamera) {
-          Serial.println("Unknown camera connected");
-          connectionMessageId = 3;
-          // Save unknown address to global for display
-          detectedCameraAddress = connectedAddress; 
-          // Disconnect unknown camera
-          pServer->disconnect(connId);
-        }
-      }
-
-      updateScreenRequested = true;
-      
-      // CRITICAL FIX: Restart advertising to allow other cameras to connect
-      // We only restart if we are not in wake mode (wake mode has special advertising)
-      // and not in pairing mode (pairing flow handles its own state)
-      if (!wakeMode && !pairingMode) {
-        // Small delay to ensure stack stability before restarting advertising
-        // Note: blocking in callback is bad, but strict restart sometimes needs a tick.
-        // Better to just call start().
-        BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
-        if (pAdvertising) {
-            pAdvertising->start();
-            Serial.println("Advertising restarted for multi-connection support");
-        }
-      }
+      pushLinkEvent(BLE_EVT_CONNECT, param->connect.conn_id, param->connect.remote_bda);
     }
 
     void onDisconnect(BLEServer* pServer, esp_ble_gatts_cb_param_t *param) {
-      uint16_t connId = param->disconnect.conn_id;
-      Serial.print("Camera disconnected, ID: ");
-      Serial.println(connId);
-
-      bool changed = false;
-
-      // Check which camera disconnected based on connId
-      if (camera1Connected && camera1.connId == connId) {
-        camera1Connected = false;
-        camera1.connId = 0xFFFF;
-        camera1ConnectedAddress = "";
-        Serial.println("Camera 1 disconnected");
-        changed = true;
-      } 
-      
-      if (camera2Connected && camera2.connId == connId) {
-        camera2Connected = false;
-        camera2.connId = 0xFFFF;
-        camera2ConnectedAddress = "";
-        Serial.println("Camera 2 disconnected");
-        changed = true;
-      }
-
-      // Fallback: Only wipe if we are SURE no one is connected.
-      // Using getConnectedCount() immediately after disconnect callback might be race-prone.
-      // Safer to rely on ID matching. 
-      // If ID matching failed (changed == false), it means we disconnected something we didn't track as active.
-      // So we shouldn't wipe the active ones!
-      if (!changed) {
-         Serial.println("Disconnected device was not tracked as active camera.");
-      }
-
-      if (changed) {
-        updateScreenRequested = true;
-      }
-
-      // Return to normal advertising to allow reconnection
-      if (!wakeMode && !pairingMode) {
-        // Ensure advertising is running
-        BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
-        if (pAdvertising) {
-             pAdvertising->start();
-        }
-      }
+      pushLinkEvent(BLE_EVT_DISCONNECT, param->disconnect.conn_id, param->disconnect.remote_bda);
     }
     
     void onDisconnect(BLEServer* pServer) {
@@ -267,41 +149,32 @@ class MyServerCallbacks: public BLEServerCallbacks {
 
 class MyCharacteristicCallbacks: public BLECharacteristicCallbacks {
     void onWrite(BLECharacteristic* pCharacteristic, esp_ble_gatts_cb_param_t* param) {
+      HEAP_PROBE_SCOPE(HEAP_SITE_BLE_CALLBACK);
       uint16_t connId = param->write.conn_id;
       uint8_t* data = param->write.value;
       size_t len = param->write.len;
 
       if (len > 0) {
-        // Heuristic: Timer packets are usually length 19 or 20 AND contain ASCII digits/colons.
-        // We scan for ':' (0x3A) to confirm it's a timer packet.
-        
-        bool isTimerPacket = false;
-        if (len >= 18) {
-            for (int i = 0; i < len; i++) {
-                if (data[i] == 0x3A) { // Found ':'
-                    isTimerPacket = true;
-                    break;
-                }
-            }
-        }
-
-        if (isTimerPacket) {
-           if (camera1Connected && camera1.connId == connId) {
-               // Only request full screen update if state CHANGES (Start Recording)
-               if (!camera1.isRecording) {
-                   camera1.isRecording = true;
-                   updateScreenRequested = true; 
-               }
-               camera1.lastTimerTime = millis();
-           } 
-           else if (camera2Connected && camera2.connId == connId) {
-               // Only request full screen update if state CHANGES (Start Recording)
-               if (!camera2.isRecording) {
-                   camera2.isRecording = true;
-                   updateScreenRequested = true;
-               }
-               camera2.lastTimerTime = millis();
-           }
+        captureRecord(CAPTURE_WRITE, connId, data, len);
+
+        // Validate and decode in place (see packets.h)
+        DecodedPacket packet;
+        decodeCameraPacket(data, len, &packet);
+        if (packet.kind == PACKET_TIMER) trace(TRACE_TIMER_PACKET, 0, connId);
+
+        BleEvent* evt = reserveBleEvent();
+        if (!evt) return;
+        evt->type = BLE_EVT_PACKET;
+        evt->connId = connId;
+        evt->time = millis();
+        evt->packet.kind = packet.kind;
+        evt->packet.frameType = packet.type;
+        evt->packet.elapsedSeconds = packet.elapsedSeconds;
+        commitBleEvent();
+
+        // Timer packets arrive every second - only wake loop() for ones that matter
+        if (packet.kind == PACKET_TIMER) {
+          signalLoop();
         }
       }
     }
@@ -309,17 +182,247 @@ class MyCharacteristicCallbacks: public BLECharacteristicCallbacks {
     void onWrite(BLECharacteristic* pCharacteristic) {}
 };
 
-void setWakeAdvertising(uint8_t* wakePayload) {
-  Serial.print("Setting wake advertising with payload: ");
-  for (int i = 0; i < 6; i++) {
-    Serial.printf("%02X ", wakePayload[i]);
+// Load the saved cameras into the controller's allow list (filter accept
+// list). The controller won't change the list while advertising with a
+// filter, so this only runs when advertising is stopped or about to start.
+// A refused update leaves the list dirty, so the next start tries again.
+void syncAllowList() {
+  if (!allowListDirty) return;
+
+  if (esp_ble_gap_clear_whitelist() != ESP_OK) {
+    allowListErrors++;
+    LOGW("Allow list clear refused - keeping the old list");
+    return;
+  }
+  int entries = 0;
+  int failed = 0;
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    if (!cameras[i].isValid) continue;
+    uint8_t bda[6];
+    unpackAddress(cameras[i].address, bda);
+    uint8_t type = cameras[i].addressType;
+    // Cameras saved before the type was recorded go in as both
+    if (type == BLE_ADDR_TYPE_PUBLIC || type == ADDR_TYPE_UNKNOWN) {
+      if (esp_ble_gap_update_whitelist(true, bda, BLE_WL_ADDR_TYPE_PUBLIC) == ESP_OK) entries++;
+      else failed++;
+    }
+    if (type == BLE_ADDR_TYPE_RANDOM || type == ADDR_TYPE_UNKNOWN) {
+      if (esp_ble_gap_update_whitelist(true, bda, BLE_WL_ADDR_TYPE_RANDOM) == ESP_OK) entries++;
+      else failed++;
+    }
+  }
+  if (failed > 0) {
+    allowListErrors++;
+    LOGW("Allow list loaded %d entries, %d refused", entries, failed);
+    return;
   }
-  Serial.println();
+  allowListDirty = false;
+  LOGI("Allow list loaded: %d entries", entries);
+}
+
+// Outside pairing only saved cameras may connect - the controller turns
+// everyone else away before a link is set up. Takes effect on the next start().
+void applyAdvertisingFilter(BLEAdvertising* pAdvertising) {
+  syncAllowList();
+  pAdvertising->setScanFilter(false, !pairingMode);
+}
+
+// Restart advertising so other cameras can (re)connect. A connection stops
+// it, also in the wake window - there it comes back with the wake payload still
+// set, so the cameras that are still asleep keep seeing it. The pairing flow
+// handles its own state.
+bool restartAdvertisingIfIdle() {
+  if (deadlines[DEADLINE_ADVERTISING].armed) return true; // Starts when settled, filter and all
+  if (!pairingMode) {
+    BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
+    if (pAdvertising) {
+        applyAdvertisingFilter(pAdvertising);
+        pAdvertising->start();
+        advertisingOn = true;
+        return true;
+    }
+  }
+  return false;
+}
+
+void handleConnectEvent(const BleEvent& evt) {
+  // Get the connected device's address
+  char addressStr[18];
+  sprintf(addressStr, "%02x:%02x:%02x:%02x:%02x:%02x",
+          evt.link.bda[0], evt.link.bda[1], evt.link.bda[2],
+          evt.link.bda[3], evt.link.bda[4], evt.link.bda[5]);
+  uint16_t connId = evt.connId;
+  uint64_t address = packAddress(evt.link.bda);
+
+  LOGI("Device connected from %s, connection ID %u", addressStr, connId);
+
+  // Check if we're in pairing mode and have detected a camera
+  if (pairingMode && detectedCameraName[0] != '\0' && pairingCameraSlot > 0) {
+    // Stop scanning
+    if (pBLEScan) {
+      pBLEScan->stop();
+    }
+    pairingMode = false;
+
+    LOGI("Pairing camera to slot %d: %s", pairingCameraSlot, detectedCameraName);
+
+    // Validate camera name format
+    bool validFormat = false;
+    size_t nameLen = strlen(detectedCameraName);
+    if (nameLen >= 9) { // "X5 " + 6 chars minimum
+      const char* space = strchr(detectedCameraName, ' ');
+      if (space && space > detectedCameraName && nameLen - (space - detectedCameraName) > 6) {
+        validFormat = true;
+      }
+    }
 
-  // Stop current advertising
+    if (validFormat) {
+      // Save to the appropriate slot
+      saveCamera(pairingCameraSlot, detectedCameraName, detectedCameraAddr, detectedCameraAddrType);
+
+      // Mark as connected
+      setCameraConnected(pairingCameraSlot - 1, connId, addressStr);
+      
+      pairingCameraSlot = 0;  // Reset pairing slot
+      soakNoteConnect(SOAK_CONNECT_PAIRED);
+    } else {
+       // Invalid format - drop the link
+       pServer->disconnect(connId);
+       soakNoteConnect(SOAK_CONNECT_REJECTED);
+    }
+  } else if (pairingMode) {
+    // In pairing mode but no camera detected yet (direct connect?)
+    // This is ambiguous, usually scan finds it first.
+    // We'll treat it as unknown/failed for now.
+    pairingMode = false;
+    pairingCameraSlot = 0;
+    if (pBLEScan) {
+      pBLEScan->stop();
+    }
+    pServer->disconnect(connId);
+    soakNoteConnect(SOAK_CONNECT_REJECTED);
+  } else {
+    // Not in pairing mode - check if this is a known camera reconnecting.
+    // The lowest matching slot wins so a camera saved in two slots only
+    // lights up once.
+    int slot = findCameraSlotByAddress(address);
+    bool knownCamera = (slot >= 0);
+
+    if (knownCamera) {
+      setCameraConnected(slot, connId, addressStr);
+      LOGI("Camera %d reconnected: %s", slot + 1, cameras[slot].name);
+      soakNoteConnect(SOAK_CONNECT_KNOWN);
+    }
+
+    if (!knownCamera) {
+      LOGW("Unknown camera connected");
+      // Save unknown address to global for display
+      snprintf(detectedCameraAddress, sizeof(detectedCameraAddress), "%s", addressStr);
+      // Disconnect unknown camera
+      pServer->disconnect(connId);
+      soakNoteConnect(SOAK_CONNECT_REJECTED);
+    }
+  }
+
+  updateScreenRequested = true;
+
+  // CRITICAL FIX: Restart advertising to allow other cameras to connect
+  if (restartAdvertisingIfIdle()) {
+    LOGD("Advertising restarted for multi-connection support");
+  }
+}
+
+void handleDisconnectEvent(const BleEvent& evt) {
+  uint16_t connId = evt.connId;
+  LOGI("Camera disconnected, ID: %u", connId);
+
+  // Check which camera disconnected based on connId.
+  // If ID matching fails we disconnected something we didn't track as
+  // active (e.g. an unknown device), so leave the active ones alone.
+  int slot = clearCameraConnection(connId);
+  if (slot >= 0) {
+    LOGI("Camera %d disconnected", slot + 1);
+    updateScreenRequested = true;
+  } else {
+    LOGD("Disconnected device was not tracked as active camera.");
+  }
+  soakNoteDisconnect(slot >= 0);
+
+  // Return to normal advertising to allow reconnection
+  restartAdvertisingIfIdle();
+}
+
+void handlePacketEvent(const BleEvent& evt) {
+  CameraInfo* camera = findCameraByConnId(evt.connId);
+  if (!camera) return;
+
+  DecodedPacket packet;
+  packet.kind = evt.packet.kind;
+  packet.type = evt.packet.frameType;
+  packet.payload = nullptr;
+  packet.payloadLen = 0;
+  packet.elapsedSeconds = evt.packet.elapsedSeconds;
+  applyPacketToStatus(&camera->status, &packet);
+
+  if (packet.kind == PACKET_TIMER) {
+    // Only request full screen update if state CHANGES (Start Recording)
+    if (!camera->isRecording) {
+      camera->isRecording = true;
+      camera->stopSentTime = 0;
+      captureRecordingChange(camera - cameras, true);
+      updateScreenRequested = true;
+      noteFirstTimerPacket(camera, evt.time);
+    } else {
+      noteTimerGap(camera, evt.time - camera->lastTimerTime);
+    }
+    camera->lastTimerTime = evt.time;
+  }
+}
+
+void handleScanEvent(const BleEvent& evt) {
+  if (!pairingMode) return;
+
+  // Save its info for the pairing connect
+  snprintf(detectedCameraName, sizeof(detectedCameraName), "%s", evt.scan.name);
+  detectedCameraAddr = packAddress(evt.scan.bda);
+  detectedCameraAddrType = evt.scan.addrType;
+  formatAddress(detectedCameraAddr, detectedCameraAddress, sizeof(detectedCameraAddress));
+
+  LOGI("Found Insta360 camera: %s @ %s", evt.scan.name, detectedCameraAddress);
+}
+
+// Apply everything the BLE callbacks have reported since the last call.
+// Only called from the loop task, so camera state needs no locking.
+void processBleEvents() {
+  BleEvent evt;
+  while (popBleEvent(&evt)) {
+    switch (evt.type) {
+      case BLE_EVT_CONNECT:     handleConnectEvent(evt); break;
+      case BLE_EVT_DISCONNECT:  handleDisconnectEvent(evt); break;
+      case BLE_EVT_PACKET:      handlePacketEvent(evt); break;
+      case BLE_EVT_SCAN_RESULT: handleScanEvent(evt); break;
+    }
+  }
+
+  static uint32_t reportedDrops = 0;
+  uint32_t drops = bleEventsDropped.load(std::memory_order_relaxed);
+  if (drops != reportedDrops) {
+    LOGW("BLE event queue overflow, events dropped: %lu", (unsigned long)(drops - reportedDrops));
+    reportedDrops = drops;
+  }
+}
+
+// Stop advertising before reconfiguring it. Returns whether something was
+// on air, in which case the controller needs advertisingSettleTime first.
+bool stopAdvertisingIfRunning() {
+  if (!advertisingOn) return false;
   BLEDevice::stopAdvertising();
-  delay(100);
+  advertisingOn = false;
+  return true;
+}
 
+// Fill in the wake advertisement for one camera (iBeacon format)
+void buildWakeAdvertisement(const uint8_t* wakePayload, BLEAdvertisementData& adData) {
   // Create manufacturer data for wake-up (iBeacon format)
   uint8_t manufacturerData[26];
 
@@ -352,121 +455,226 @@ void setWakeAdvertising(uint8_t* wakePayload) {
   manufacturerData[24] = 0xe4;  // TX Power
   manufacturerData[25] = 0x01;  // Additional byte
 
-  BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
-  pAdvertising->addServiceUUID(GPS_REMOTE_SERVICE_UUID);
-
-  // Convert manufacturer data to Arduino String
-  String mfgDataString = "";
-  for (int i = 0; i < 26; i++) {
-    mfgDataString += (char)manufacturerData[i];
-  }
+  // The BLE library takes an Arduino String - build it in one allocation
+  String mfgDataString((const char*)manufacturerData, sizeof(manufacturerData));
 
   // Set manufacturer data using BLEAdvertisementData
-  BLEAdvertisementData adData;
   adData.setManufacturerData(mfgDataString);
 
   // Use exact name to match official remotes (Ace Pro 2 requires exact match)
-  String deviceName = "Insta360 GPS Remote";
-  adData.setName(deviceName);
+  adData.setName(REMOTE_DEVICE_NAME);
+}
 
+// Set up and start advertising for the current mode: the wake payload in
+// wakeMode, else the name and service for (re)connecting
+void startAdvertising() {
+  BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
+  BLEAdvertisementData adData;
+  if (wakeMode) {
+    pAdvertising->addServiceUUID(GPS_REMOTE_SERVICE_UUID);
+    buildWakeAdvertisement(currentWakePayload, adData);
+  } else {
+    // Use exact name to match official remotes (Ace Pro 2 requires exact match)
+    adData.setName(REMOTE_DEVICE_NAME);
+    adData.setCompleteServices(BLEUUID(GPS_REMOTE_SERVICE_UUID));
+  }
   pAdvertising->setAdvertisementData(adData);
-
   pAdvertising->setScanResponse(false);
   pAdvertising->setMinPreferred(0x0);
-
-  wakeMode = true;
-  memcpy(currentWakePayload, wakePayload, 6);
+  applyAdvertisingFilter(pAdvertising);
 
   pAdvertising->start();
-  Serial.println("Wake advertising started");
+  advertisingOn = true;
+  if (wakeMode) {
+    LOGD("Wake advertising started");
+  } else {
+    LOGD("Normal advertising started with name: %s", REMOTE_DEVICE_NAME);
+  }
 }
 
-void setNormalAdvertising() {
-  Serial.println("Setting normal advertising");
+// Switch advertising to the current mode. What was on air stops now and the
+// new advertising starts from loop() once the controller has settled, so the
+// control pass never waits for the radio. At boot it starts right away.
+void restartAdvertising() {
+  if (stopAdvertisingIfRunning()) {
+    armDeadline(DEADLINE_ADVERTISING, millis() + advertisingSettleTime);
+  } else if (!deadlines[DEADLINE_ADVERTISING].armed) {
+    startAdvertising();
+  }
+}
 
-  // Stop current advertising
-  BLEDevice::stopAdvertising();
-  delay(100);
+// When advertising set up now goes on air: after the settle time if a
+// restart is waiting for it
+unsigned long advertisingStartTime() {
+  return deadlines[DEADLINE_ADVERTISING].armed ? deadlines[DEADLINE_ADVERTISING].at : millis();
+}
 
-  // Create fresh advertising without manufacturer data
-  BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
+// Start advertising once the settle time is over. Called from loop().
+void updateAdvertising() {
+  if (!deadlines[DEADLINE_ADVERTISING].armed) return;
+  if ((long)(millis() - deadlines[DEADLINE_ADVERTISING].at) < 0) return;
+  cancelDeadline(DEADLINE_ADVERTISING);
+  startAdvertising();
+}
 
-  // Clear any previous advertisement data
-  BLEAdvertisementData adData;
+void setWakeAdvertising(uint8_t* wakePayload) {
+  LOGD("Setting wake advertising with payload: %02X %02X %02X %02X %02X %02X",
+       wakePayload[0], wakePayload[1], wakePayload[2], wakePayload[3], wakePayload[4], wakePayload[5]);
 
-  // Use exact name to match official remotes (Ace Pro 2 requires exact match)
-  String deviceName = "Insta360 GPS Remote";
-  adData.setName(deviceName);
-  adData.setCompleteServices(BLEUUID(GPS_REMOTE_SERVICE_UUID));
+  wakeMode = true;
+  memcpy(currentWakePayload, wakePayload, 6);
+  restartAdvertising();
+}
 
-  // Set the clean advertisement data (no manufacturer data)
-  pAdvertising->setAdvertisementData(adData);
-  pAdvertising->setScanResponse(false);
-  pAdvertising->setMinPreferred(0x0);
+// Swap the wake payload while wake advertising keeps running. The controller
+// accepts new advertising data without being stopped, so this does not block.
+void rotateWakeAdvertising(const uint8_t* wakePayload) {
+  if (!wakeMode) return;
+
+  BLEAdvertisementData adData;
+  buildWakeAdvertisement(wakePayload, adData);
+  BLEDevice::getAdvertising()->setAdvertisementData(adData);
+  memcpy(currentWakePayload, wakePayload, 6);
+}
 
+void setNormalAdvertising() {
   wakeMode = false;
   memset(currentWakePayload, 0, 6);
+  restartAdvertising();
+}
 
-  pAdvertising->start();
-  Serial.print("Normal advertising started with name: ");
-  Serial.println(deviceName);
+// Outgoing command queue - producers post here, loop() drains it
+#define TX_QUEUE_SIZE 8
+#define TX_BROADCAST 0xFFFF  // connId marker for a notify to every connected camera
+
+struct TxCommand {
+  uint16_t connId;      // Target connection, or TX_BROADCAST
+  uint8_t* data;        // Points at one of the static payloads in config.h
+  size_t length;
+  const char* name;
+  unsigned long sendAt; // Held in the queue until this time (staggered starts)
+  bool isStart;         // Shutter start - measure latency to first timer packet
+};
+
+TxCommand txQueue[TX_QUEUE_SIZE];
+uint8_t txHead = 0;  // Next slot to send
+uint8_t txTail = 0;  // Next free slot
+
+// Shutter toggles and power-off end a running recording
+bool stopsRecording(const uint8_t* data) {
+  return data == SHUTTER_CMD || data == POWER_OFF_CMD;
+}
+
+// A shutter or power-off may not overtake an earlier one for the same camera:
+// the shutter toggles, so the camera would end up in the opposite state
+bool txMustFollow(const TxCommand& earlier, const TxCommand& later) {
+  bool sameCamera = earlier.connId == later.connId || earlier.connId == TX_BROADCAST || later.connId == TX_BROADCAST;
+  return sameCamera && (earlier.isStart || stopsRecording(earlier.data)) &&
+         (later.isStart || stopsRecording(later.data));
+}
+
+// The queue is kept in sendAt order and drained from the head, so a command
+// due now is not held behind a staggered start queued up to maxStartStagger
+// ahead. Equal sendAt keeps the order they were queued in.
+bool enqueueTx(uint16_t connId, uint8_t* command, size_t length, const char* commandName,
+               unsigned long delayMs = 0, bool isStart = false) {
+  uint8_t next = (txTail + 1) % TX_QUEUE_SIZE;
+  if (next == txHead) {
+    LOGW("TX queue full, dropping %s", commandName);
+    return false;
+  }
+  TxCommand cmd;
+  cmd.connId = connId;
+  cmd.data = command;
+  cmd.length = length;
+  cmd.name = commandName;
+  cmd.sendAt = millis() + delayMs;
+  cmd.isStart = isStart;
+
+  // Insert from the tail, moving later-due entries up one slot
+  uint8_t at = txTail;
+  while (at != txHead) {
+    uint8_t prev = (at + TX_QUEUE_SIZE - 1) % TX_QUEUE_SIZE;
+    const TxCommand& before = txQueue[prev];
+    if ((long)(before.sendAt - cmd.sendAt) <= 0 || txMustFollow(before, cmd)) break;
+    txQueue[at] = before;
+    at = prev;
+  }
+  txQueue[at] = cmd;
+  txTail = next;
+  return true;
 }
 
-void sendCommand(uint8_t* command, size_t length, const char* commandName) {
+bool txQueueEmpty() {
+  return txHead == txTail;
+}
+
+void sendCommand(uint8_t* command, size_t length, const char* commandName, bool isStart = false) {
   // Check if at least one camera is connected
-  bool anyConnected = camera1Connected || camera2Connected;
+  bool anyConnected = countConnectedCameras() > 0;
 
   if (!anyConnected || !pServer || pServer->getConnectedCount() == 0) {
-    M5.Lcd.fillScreen(BLACK);
-    M5.Lcd.setCursor(40, 35);
-    M5.Lcd.setTextColor(RED);
-    M5.Lcd.println("Not Connected!");
-    delay(1500);
-    updateDisplay();
+    showNotConnectedMessage();
     return;
   }
 
-  Serial.print("TX (Broadcast) ");
-  Serial.print(commandName);
-  Serial.print(": ");
-  for (int i = 0; i < length; i++) {
-    Serial.printf("%02X ", command[i]);
-  }
-  Serial.println();
-
-  pNotifyCharacteristic->setValue(command, length);
-  pNotifyCharacteristic->notify();
-
-  // Brief visual feedback in blue bar
-  showBottomStatus("SENT!", BLUE);
-  delay(500);
-  updateDisplay();
+  enqueueTx(TX_BROADCAST, command, length, commandName, 0, isStart);
 }
 
 void sendUnicastCommand(uint16_t connId, uint8_t* command, size_t length, const char* commandName) {
   if (!pServer || !pNotifyCharacteristic) return;
 
-  Serial.print("TX (Unicast ID:");
-  Serial.print(connId);
-  Serial.print(") ");
-  Serial.print(commandName);
-  Serial.print(": ");
-  for (int i = 0; i < length; i++) {
-    Serial.printf("%02X ", command[i]);
+  enqueueTx(connId, command, length, commandName);
+}
+
+// Transmit everything queued and due. Feedback is a timed status bar
+// overlay rather than a blocking delay.
+void processTxQueue() {
+  while (!txQueueEmpty()) {
+    TxCommand& cmd = txQueue[txHead];
+    unsigned long now = millis();
+    if ((long)(now - cmd.sendAt) < 0) {
+      armDeadline(DEADLINE_TX_DUE, cmd.sendAt);
+      return;
+    }
+    txHead = (txHead + 1) % TX_QUEUE_SIZE;
+
+    if (!pServer || !pNotifyCharacteristic) continue;
+
+    // Every command shares the FC EF FE 86 00 03 header - log the payload bytes
+    const uint8_t* payload = cmd.data + cmd.length - 3;
+    if (cmd.connId == TX_BROADCAST) {
+      LOGI("TX (Broadcast) %s: .. %02X %02X %02X", cmd.name, payload[0], payload[1], payload[2]);
+    } else {
+      LOGI("TX (Unicast ID:%u) %s: .. %02X %02X %02X", cmd.connId, cmd.name, payload[0], payload[1], payload[2]);
+    }
+    uint8_t commandId = traceCommandId(cmd.data);
+    trace(TRACE_CMD_TX, commandId, cmd.connId);
+    captureRecord(CAPTURE_TX, cmd.connId, &commandId, 1);
+
+    if (cmd.connId == TX_BROADCAST) {
+      pNotifyCharacteristic->setValue(cmd.data, cmd.length);
+      pNotifyCharacteristic->notify();
+      for (int i = 0; i < MAX_CAMERAS; i++) {
+        if (!cameras[i].connected) continue;
+        if (cmd.isStart) markStartSent(&cameras[i], now);
+        else if (stopsRecording(cmd.data) && cameras[i].isRecording) markStopSent(&cameras[i], now);
+      }
+      showStatusToast("SENT!", BLUE, 500);
+    } else {
+      // Use low-level ESP API to send to specific connection
+      // uint16_t gattsIf = pServer->getGattsIf(); // Private, using global capture
+      uint16_t attrHandle = pNotifyCharacteristic->getHandle();
+
+      // false = Notification (not Indication)
+      esp_ble_gatts_send_indicate(g_gattsIf, cmd.connId, attrHandle, cmd.length, cmd.data, false);
+      CameraInfo* camera = findCameraByConnId(cmd.connId);
+      if (camera && cmd.isStart) markStartSent(camera, now);
+      else if (camera && stopsRecording(cmd.data) && camera->isRecording) markStopSent(camera, now);
+      showStatusToast("SYNC!", BLUE, 500);
+    }
   }
-  Serial.println();
-
-  // Use low-level ESP API to send to specific connection
-  // uint16_t gattsIf = pServer->getGattsIf(); // Private, using global capture
-  uint16_t attrHandle = pNotifyCharacteristic->getHandle();
-  
-  // false = Notification (not Indication)
-  esp_ble_gatts_send_indicate(g_gattsIf, connId, attrHandle, length, command, false);
-
-  // Brief visual feedback in blue bar
-  showBottomStatus("SYNC!", BLUE);
-  delay(500);
-  updateDisplay();
+  cancelDeadline(DEADLINE_TX_DUE);
 }
 
 #endif // BLE_HANDLERS_H
\ No newline at end of file
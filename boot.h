@@ -0,0 +1,52 @@
+/*
+ * boot.h
+ * Boot phase timestamps and the time-to-advertise summary
+ */
+
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <Arduino.h>
+
+
+// setup() marks the end of each phase; the summary is printed once the UI is
+// up. Times are millis() since the ESP32 timer started, which is within a few
+// ms of the bootloader handing over to the app.
+enum BootPhase {
+  BOOT_M5_BEGIN = 0, // M5.begin() - power hold, display, buttons
+  BOOT_SETTINGS,     // Saved cameras and UI settings
+  BOOT_BLE_INIT,     // Controller/host bring-up and scanner
+  BOOT_GATT,         // Server, service and characteristics
+  BOOT_ADVERTISING,  // First advertisement on air
+  BOOT_INPUTS,       // GPIO pins and wake-up interrupts
+  BOOT_UI,           // Rotation, canvas and first frame
+  BOOT_PHASE_COUNT
+};
+
+const char* const bootPhaseNames[BOOT_PHASE_COUNT] = {
+  "m5", "settings", "ble", "gatt", "adv", "inputs", "ui"
+};
+
+// Cameras can reconnect once we advertise - keep this under the target
+const unsigned long bootAdvertiseTarget = 1000;
+
+unsigned long bootPhaseEnd[BOOT_PHASE_COUNT];
+
+void markBootPhase(BootPhase phase) {
+  bootPhaseEnd[phase] = millis();
+}
+
+// One line per boot, e.g. "Boot ms: m5=310 settings=4 ... | advertising at 540 ms (target 1000)"
+void reportBootPhases() {
+  unsigned long previous = 0;
+  Serial.print("Boot ms:");
+  for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+    Serial.printf(" %s=%lu", bootPhaseNames[i], bootPhaseEnd[i] - previous);
+    previous = bootPhaseEnd[i];
+  }
+  unsigned long advertisedAt = bootPhaseEnd[BOOT_ADVERTISING];
+  Serial.printf(" | advertising at %lu ms (target %lu)%s\n", advertisedAt, bootAdvertiseTarget,
+                advertisedAt > bootAdvertiseTarget ? " OVER" : "");
+}
+
+#endif // BOOT_H
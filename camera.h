@@ -6,167 +6,300 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include <Arduino.h>
+
+#include "packets.h"
+
+// Number of camera slots. Override at build time for larger rigs (the
+// ESP32 controller can hold up to CONFIG_BT_ACL_CONNECTIONS links).
+#ifndef MAX_CAMERAS
+#define MAX_CAMERAS 2
+#endif
+
+// Largest GATT connection ID tracked in the direct lookup table
+#define MAX_CONN_IDS 16
+#define NO_CONN_ID 0xFFFF
+#define NO_SLOT 0xFF
+
+// Timer-packet inter-arrival samples kept per camera
+#define TIMER_GAP_SAMPLES 16
+
+// Address type for cameras saved before the type was recorded
+#define ADDR_TYPE_UNKNOWN 0xFF
+
+// Per-camera progress through an incremental Smart Wake
+enum SmartWakeState {
+  WAKE_IDLE = 0,   // Not part of a Smart Wake
+  WAKE_WAITING,    // Wake sent, waiting for the camera to reconnect
+  WAKE_SETTLING,   // Connected, giving the link a moment before starting
+  WAKE_STARTED     // Start sent (or camera was already recording)
+};
+
 // Camera info structure
 struct CameraInfo {
   char name[30];
-  char address[20];
+  uint64_t address;              // Packed 48-bit BD_ADDR, first byte most significant
+  uint8_t addressType;           // BLE_ADDR_TYPE_*, or ADDR_TYPE_UNKNOWN
   uint8_t wakePayload[6];
   bool isValid;
   uint16_t connId;
   int batteryLevel;
   bool isRecording;
   unsigned long lastTimerTime;
+  bool connected;
+  char connectedAddress[18];
+  // Shutter latency tracking (command sent -> first timer packet)
+  unsigned long startSentTime;   // When the last start was sent, 0 if none pending
+  unsigned long startLatencyMs;  // Rolling estimate, 0 until first measured
+  unsigned long firstTimerTime;  // First timer packet of the current recording
+  bool inStartBatch;             // Part of the start whose skew is being measured
+  // Recording-stop detection from the timer-packet cadence
+  uint16_t timerGaps[TIMER_GAP_SAMPLES]; // Recent inter-arrival times (ms), ring
+  uint8_t timerGapCount;         // Valid entries in timerGaps
+  uint8_t timerGapNext;          // Next ring slot to overwrite
+  unsigned long timerGapP95;     // 95th percentile of timerGaps, 0 until enough samples
+  unsigned long stopSentTime;    // When we last sent this camera a stop, 0 if none
+  CameraStatus status;           // Decoded from the camera's notifications
+  SmartWakeState wakeState;      // Smart Wake progress
+  unsigned long wakeReadyAt;     // When a settling camera may be started
 };
 
-// Global camera variables - dual camera support
-CameraInfo camera1;
-CameraInfo camera2;
-Preferences preferences;
+// Camera registry - slot index is the user-facing slot number minus one
+CameraInfo cameras[MAX_CAMERAS];
+uint8_t connIdSlot[MAX_CONN_IDS];  // connId -> slot index, NO_SLOT if unused
 
 // UI Settings (Global)
 bool isVerticalLayout = false;
 
 // Pairing mode variables
-bool pairingMode = false;
-int pairingCameraSlot = 0;  // 1 for camera1, 2 for camera2
-String detectedCameraName = "";
-String detectedCameraAddress = "";
+enum PairingPhase {
+  PAIRING_IDLE = 0,
+  PAIRING_SPLASH,     // "PAIRING CAM n" before the scan starts
+  PAIRING_SCANNING    // Scanning and advertising for the camera
+};
+PairingPhase pairingPhase = PAIRING_IDLE;
+bool pairingMode = false;   // Scan results and connects are for pairing
+int pairingCameraSlot = 0;  // 1-based slot being paired, 0 when idle
+char detectedCameraName[30] = "";
+char detectedCameraAddress[18] = "";
+uint64_t detectedCameraAddr = 0;
+uint8_t detectedCameraAddrType = ADDR_TYPE_UNKNOWN;
 
-// Connection tracking for both cameras
-bool camera1Connected = false;
-bool camera2Connected = false;
-String camera1ConnectedAddress = "";
-String camera2ConnectedAddress = "";
+// Set when the saved cameras change so the controller's allow list is reloaded
+bool allowListDirty = true;
+uint32_t allowListErrors = 0;  // Allow list reloads the controller refused
 
 // Wake-up variables
 bool wakeMode = false;
 uint8_t currentWakePayload[6] = {0};
 
-void saveLayoutPreference(bool vertical) {
-  preferences.begin("ui_settings", false);
-  preferences.putBool("vert_layout", vertical);
-  preferences.end();
-  isVerticalLayout = vertical;
-  Serial.print("Layout saved: ");
-  Serial.println(vertical ? "Vertical" : "Horizontal");
-}
-
-void loadCamera(int cameraNum, CameraInfo* camera) {
-  String namespaceName = (cameraNum == 1) ? "camera1" : "camera2";
-  Serial.print("Loading camera ");
-  Serial.print(cameraNum);
-  Serial.println(" from preferences...");
-
-  preferences.begin(namespaceName.c_str(), false);
-
-  preferences.getString("name", camera->name, 30);
-  preferences.getString("address", camera->address, 20);
-  
-  // Trim any potential whitespace from address
-  String addrStr = String(camera->address);
-  addrStr.trim();
-  addrStr.toCharArray(camera->address, 20);
-
-  Serial.print("Loaded name: ");
-  Serial.println(camera->name);
-  Serial.print("Loaded address: ");
-  Serial.println(camera->address);
-
-  size_t len = preferences.getBytesLength("wake");
-
-  if (len == 6) {
-    preferences.getBytes("wake", camera->wakePayload, 6);
-    camera->isValid = (strlen(camera->name) > 0);
-    camera->connId = 0xFFFF;
-    camera->batteryLevel = -1;
-    camera->isRecording = false;
-    camera->lastTimerTime = 0;
-
-    if (camera->isValid) {
-      Serial.print("Wake payload loaded: ");
-      for (int i = 0; i < 6; i++) {
-        Serial.printf("%02X ", camera->wakePayload[i]);
-      }
-      Serial.println();
-    }
+void initCameraRegistry() {
+  for (int i = 0; i < MAX_CONN_IDS; i++) {
+    connIdSlot[i] = NO_SLOT;
+  }
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    cameras[i].connected = false;
+    cameras[i].connId = NO_CONN_ID;
+    cameras[i].connectedAddress[0] = '\0';
+    cameras[i].startSentTime = 0;
+    cameras[i].startLatencyMs = 0;
+    cameras[i].firstTimerTime = 0;
+    cameras[i].inStartBatch = false;
+    cameras[i].timerGapCount = 0;
+    cameras[i].timerGapNext = 0;
+    cameras[i].timerGapP95 = 0;
+    cameras[i].stopSentTime = 0;
+    cameras[i].wakeState = WAKE_IDLE;
+    cameras[i].wakeReadyAt = 0;
+    memset(&cameras[i].status, 0, sizeof(CameraStatus));
+  }
+}
+
+// Direct lookup of the camera on a GATT connection, nullptr if none
+CameraInfo* findCameraByConnId(uint16_t connId) {
+  if (connId < MAX_CONN_IDS) {
+    uint8_t slot = connIdSlot[connId];
+    return (slot == NO_SLOT) ? nullptr : &cameras[slot];
+  }
+  // IDs outside the table fall back to a scan (not expected from Bluedroid)
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    if (cameras[i].connected && cameras[i].connId == connId) return &cameras[i];
+  }
+  return nullptr;
+}
+
+// BD_ADDR bytes (as Bluedroid reports them) <-> one integer
+uint64_t packAddress(const uint8_t* bda) {
+  uint64_t address = 0;
+  for (int i = 0; i < 6; i++) {
+    address = (address << 8) | bda[i];
+  }
+  return address;
+}
+
+void unpackAddress(uint64_t address, uint8_t* bda) {
+  for (int i = 5; i >= 0; i--) {
+    bda[i] = address & 0xFF;
+    address >>= 8;
+  }
+}
+
+void formatAddress(uint64_t address, char* out, size_t outSize) {
+  uint8_t bda[6];
+  unpackAddress(address, bda);
+  snprintf(out, outSize, "%02x:%02x:%02x:%02x:%02x:%02x",
+           bda[0], bda[1], bda[2], bda[3], bda[4], bda[5]);
+}
+
+// Value of one hex digit the caller has already checked with isxdigit()
+uint8_t hexDigitValue(char c) {
+  if (c <= '9') return c - '0';
+  return (c | 0x20) - 'a' + 10;
+}
+
+// Parse "aa:bb:cc:dd:ee:ff" (either case). Exactly two hex digits per byte,
+// nothing before or after. Returns false if malformed.
+bool parseAddress(const char* text, uint64_t* address) {
+  uint8_t bda[6];
+  for (int i = 0; i < 6; i++) {
+    if (!isxdigit((unsigned char)text[0]) || !isxdigit((unsigned char)text[1])) return false;
+    if (text[2] != (i < 5 ? ':' : '\0')) return false;
+    bda[i] = (hexDigitValue(text[0]) << 4) | hexDigitValue(text[1]);
+    text += 3;
+  }
+  *address = packAddress(bda);
+  return true;
+}
+
+// Lowest saved slot matching this address, -1 if none
+int findCameraSlotByAddress(uint64_t address) {
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    if (cameras[i].isValid && cameras[i].address == address) return i;
+  }
+  return -1;
+}
+
+void setCameraConnected(int slot, uint16_t connId, const char* address) {
+  CameraInfo* camera = &cameras[slot];
+  // Re-pairing a slot that still holds another link drops the stale mapping
+  if (camera->connected && camera->connId < MAX_CONN_IDS) {
+    connIdSlot[camera->connId] = NO_SLOT;
+  }
+  camera->connected = true;
+  camera->connId = connId;
+  snprintf(camera->connectedAddress, sizeof(camera->connectedAddress), "%s", address);
+  if (connId < MAX_CONN_IDS) {
+    connIdSlot[connId] = slot;
+  }
+}
+
+// Clear the camera on this connection; returns its slot or -1 if untracked
+int clearCameraConnection(uint16_t connId) {
+  CameraInfo* camera = findCameraByConnId(connId);
+  if (!camera) return -1;
+
+  if (connId < MAX_CONN_IDS) {
+    connIdSlot[connId] = NO_SLOT;
+  }
+  camera->connected = false;
+  camera->connId = NO_CONN_ID;
+  camera->connectedAddress[0] = '\0';
+  return camera - cameras;
+}
+
+// Latencies above this are treated as a missed start rather than a sample
+const unsigned long maxStartLatency = 5000;
+
+// A start shutter command just went out to this camera
+void markStartSent(CameraInfo* camera, unsigned long now) {
+  camera->startSentTime = now ? now : 1;
+  camera->inStartBatch = true;
+}
+
+// First timer packet of a recording - fold the start latency into the estimate
+void noteFirstTimerPacket(CameraInfo* camera, unsigned long now) {
+  camera->firstTimerTime = now;
+  if (camera->startSentTime == 0) return; // Started from the camera or another remote
+
+  unsigned long latency = now - camera->startSentTime;
+  camera->startSentTime = 0;
+  if (latency > maxStartLatency) return;
+
+  if (camera->startLatencyMs == 0) {
+    camera->startLatencyMs = latency;
   } else {
-    camera->isValid = false;
-    Serial.println("No valid wake payload found");
-  }
-
-  preferences.end();
-
-  Serial.print("Camera ");
-  Serial.print(cameraNum);
-  Serial.print(" isValid: ");
-  Serial.println(camera->isValid);
-}
-
-void loadAllCameras() {
-  Serial.println("=== Loading all cameras ===");
-  loadCamera(1, &camera1);
-  loadCamera(2, &camera2);
-  
-  // Load UI Settings
-  preferences.begin("ui_settings", false);
-  isVerticalLayout = preferences.getBool("vert_layout", false);
-  preferences.end();
-  Serial.print("Loaded Layout: ");
-  Serial.println(isVerticalLayout ? "Vertical" : "Horizontal");
-  
-  Serial.println("=== Camera loading complete ===");
-}
-
-void saveCamera(int cameraNum, String cameraName, String cameraAddress) {
-  CameraInfo* camera = (cameraNum == 1) ? &camera1 : &camera2;
-  String namespaceName = (cameraNum == 1) ? "camera1" : "camera2";
-
-  Serial.print("Saving camera ");
-  Serial.print(cameraNum);
-  Serial.print(": ");
-  Serial.print(cameraName);
-  Serial.print(" @ ");
-  Serial.println(cameraAddress);
-
-  // Extract wake payload from camera name (last 6 characters)
-  if (cameraName.length() >= 6) {
-    String nameEnd = cameraName.substring(cameraName.length() - 6);
-    Serial.print("Wake payload suffix: ");
-    Serial.println(nameEnd);
-
-    // Convert to ASCII bytes
-    for (int i = 0; i < 6; i++) {
-      camera->wakePayload[i] = (uint8_t)nameEnd[i];
-    }
+    camera->startLatencyMs = (camera->startLatencyMs * 3 + latency) / 4;
+  }
+}
+
+int countConnectedCameras() {
+  int count = 0;
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    if (cameras[i].connected) count++;
+  }
+  return count;
+}
+
+int countSavedCameras() {
+  int count = 0;
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    if (cameras[i].isValid) count++;
+  }
+  return count;
+}
+
+// Recording is assumed stopped once timer packets have been missing for
+// p95(inter-arrival) x recordingTimeoutMargin, clamped to the range below.
+// Until a camera has given us enough samples the old fixed 5 s applies.
+const unsigned long defaultRecordingTimeout = 5000;
+const unsigned long minRecordingTimeout = 1500;
+const int minTimerGapSamples = 8;
+const unsigned long recordingTimeoutMargin = 2;
+// After we sent a stop, one missed packet (p95 x 5/4) is enough
+const unsigned long stopHintMin = 600;
 
-    // Save camera info
-    snprintf(camera->name, 30, "%s", cameraName.c_str());
-    snprintf(camera->address, 20, "%s", cameraAddress.c_str());
-    camera->isValid = true;
-    camera->connId = 0xFFFF;
-    camera->batteryLevel = -1;
-    camera->isRecording = false;
-    camera->lastTimerTime = 0;
-
-    // Store in preferences
-    preferences.begin(namespaceName.c_str(), false);
-    preferences.putString("name", camera->name);
-    preferences.putString("address", camera->address);
-    preferences.putBytes("wake", camera->wakePayload, 6);
-    preferences.end();
-
-    Serial.print("Wake payload bytes: ");
-    for (int i = 0; i < 6; i++) {
-      Serial.printf("%02X ", camera->wakePayload[i]);
+// Record the gap between two timer packets of the same recording
+void noteTimerGap(CameraInfo* camera, unsigned long gap) {
+  if (gap > 0xFFFF) gap = 0xFFFF;
+  camera->timerGaps[camera->timerGapNext] = gap;
+  camera->timerGapNext = (camera->timerGapNext + 1) % TIMER_GAP_SAMPLES;
+  if (camera->timerGapCount < TIMER_GAP_SAMPLES) camera->timerGapCount++;
+  if (camera->timerGapCount < minTimerGapSamples) return;
+
+  // Small enough to sort a copy each time
+  uint16_t sorted[TIMER_GAP_SAMPLES];
+  int n = camera->timerGapCount;
+  for (int i = 0; i < n; i++) {
+    uint16_t v = camera->timerGaps[i];
+    int j = i;
+    while (j > 0 && sorted[j - 1] > v) {
+      sorted[j] = sorted[j - 1];
+      j--;
     }
-    Serial.println();
-    Serial.print("Camera ");
-    Serial.print(cameraNum);
-    Serial.println(" saved successfully");
-  } else {
-    Serial.println("Camera name too short for valid wake payload");
-    camera->isValid = false;
+    sorted[j] = v;
+  }
+  camera->timerGapP95 = sorted[(n * 95 + 99) / 100 - 1];
+}
+
+// How long this camera may go without a timer packet before it counts as stopped
+unsigned long recordingTimeout(const CameraInfo* camera) {
+  if (camera->timerGapP95 == 0) return defaultRecordingTimeout;
+
+  unsigned long timeout = camera->timerGapP95 * recordingTimeoutMargin;
+  if (camera->stopSentTime != 0) {
+    // We asked it to stop - don't wait for the full margin
+    timeout = camera->timerGapP95 * 5 / 4;
+    if (timeout < stopHintMin) timeout = stopHintMin;
+  } else if (timeout < minRecordingTimeout) {
+    timeout = minRecordingTimeout;
   }
+  if (timeout > defaultRecordingTimeout) timeout = defaultRecordingTimeout;
+  return timeout;
+}
+
+// A command that should end this camera's recording just went out
+void markStopSent(CameraInfo* camera, unsigned long now) {
+  camera->stopSentTime = now ? now : 1;
 }
 
 #endif // CAMERA_H
\ No newline at end of file
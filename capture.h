@@ -0,0 +1,156 @@
+/*
+ * capture.h
+ * Session capture - camera BLE traffic and recording-state changes to Serial
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <Arduino.h>
+
+#include "camera.h"
+#include "log.h"
+
+// Toggled with the 'C' console command. While on, every connect, disconnect
+// and raw write to the remote's characteristic is recorded together with the
+// recording-state changes the firmware derived from them and the commands
+// it sent. Records are queued (the BLE callbacks must not print) and written
+// from loop() as lines:
+//
+//   CAPTURE BEGIN <time> <max data>
+//   CAPTURE CAMERA <slot> <address> <name>     one per saved camera
+//   CAP <hex>      <hex> = dt varint | type | connId | len varint | data
+//   CAPTURE END
+//
+// dt is milliseconds since the previous record and len the full length of
+// the data, both LEB128 varints. Only the first <max data> bytes are kept, so
+// a record is complete when len <= max. A typical timer packet costs about
+// 50 characters on the wire. tools/capture_decode.py turns a Serial log into
+// a timeline and compares state-transition timing against a reference
+// capture; host/capture_replay.cpp feeds one back through the firmware.
+
+// Must be a power of two
+#define CAPTURE_QUEUE_SIZE 64
+#define CAPTURE_MAX_DATA 64
+
+enum CaptureType : uint8_t {
+  CAPTURE_CONNECT = 1,     // data = BD_ADDR (6)
+  CAPTURE_DISCONNECT,      // no data
+  CAPTURE_WRITE,           // data = bytes written by the camera (the first CAPTURE_MAX_DATA)
+  CAPTURE_RECORDING,       // connId = slot, data[0] = 1 started / 0 stopped
+  CAPTURE_TX               // data = TraceCommand, connId = target (0xFF broadcast)
+};
+
+struct CaptureRecord {
+  uint32_t time;
+  uint8_t type;
+  uint8_t connId;
+  uint16_t fullLen;        // Length before truncation
+  uint8_t len;             // Bytes kept in data
+  uint8_t data[CAPTURE_MAX_DATA];
+};
+
+CaptureRecord captureQueue[CAPTURE_QUEUE_SIZE];
+uint32_t captureHead = 0;       // Next record to write out (loop() only)
+uint32_t captureTail = 0;       // Next record to fill (under captureMux)
+uint32_t captureDropped = 0;
+uint32_t captureLastTime = 0;   // Time of the last record written out
+volatile bool captureEnabled = false;
+portMUX_TYPE captureMux = portMUX_INITIALIZER_UNLOCKED;
+
+void captureRecord(CaptureType type, uint16_t connId, const uint8_t* data, size_t fullLen) {
+  if (!captureEnabled) return;
+  if (fullLen > 0xFFFF) fullLen = 0xFFFF;
+  size_t len = fullLen > CAPTURE_MAX_DATA ? CAPTURE_MAX_DATA : fullLen;
+
+  portENTER_CRITICAL(&captureMux);
+  if (captureTail - captureHead >= CAPTURE_QUEUE_SIZE) {
+    captureDropped++;
+  } else {
+    CaptureRecord& rec = captureQueue[captureTail & (CAPTURE_QUEUE_SIZE - 1)];
+    rec.time = millis();
+    rec.type = type;
+    rec.connId = connId > 0xFF ? 0xFF : connId;
+    rec.fullLen = fullLen;
+    rec.len = len;
+    memcpy(rec.data, data, len);
+    captureTail++;
+  }
+  portEXIT_CRITICAL(&captureMux);
+}
+
+void captureRecordingChange(int slot, bool recording) {
+  uint8_t state = recording ? 1 : 0;
+  captureRecord(CAPTURE_RECORDING, slot, &state, 1);
+}
+
+void setCaptureEnabled(bool enabled) {
+  if (enabled && !captureEnabled) {
+    captureHead = captureTail;
+    captureDropped = 0;
+    captureLastTime = millis();
+    Serial.printf("CAPTURE BEGIN %lu %d\n", (unsigned long)captureLastTime, CAPTURE_MAX_DATA);
+    // The saved cameras, so a replay can set up the same allow list
+    for (int i = 0; i < MAX_CAMERAS; i++) {
+      if (!cameras[i].isValid) continue;
+      char address[18];
+      formatAddress(cameras[i].address, address, sizeof(address));
+      Serial.printf("CAPTURE CAMERA %d %s %s\n", i + 1, address, cameras[i].name);
+    }
+  }
+  captureEnabled = enabled;
+  if (!enabled) Serial.println("CAPTURE END");
+}
+
+// LEB128: seven bits per byte, low first, top bit set on all but the last
+size_t putVarint(uint8_t* out, uint32_t value) {
+  size_t n = 0;
+  do {
+    uint8_t b = value & 0x7F;
+    value >>= 7;
+    out[n++] = value ? (b | 0x80) : b;
+  } while (value);
+  return n;
+}
+
+// Write queued records while the UART has room (same rules as drainLog())
+void drainCapture() {
+  // dt (up to 5 bytes) | type | connId | len (up to 3) | data
+  uint8_t bytes[5 + 2 + 3 + CAPTURE_MAX_DATA];
+  char line[4 + 2 * sizeof(bytes) + 2];
+
+  while (captureHead != captureTail) {
+    const CaptureRecord& rec = captureQueue[captureHead & (CAPTURE_QUEUE_SIZE - 1)];
+
+    size_t n = putVarint(bytes, rec.time - captureLastTime);
+    bytes[n++] = rec.type;
+    bytes[n++] = rec.connId;
+    n += putVarint(bytes + n, rec.fullLen);
+    memcpy(bytes + n, rec.data, rec.len);
+    n += rec.len;
+
+    int len = snprintf(line, sizeof(line), "CAP ");
+    for (size_t i = 0; i < n; i++) {
+      len += snprintf(line + len, sizeof(line) - len, "%02x", bytes[i]);
+    }
+    line[len++] = '\n';
+
+    if (Serial.availableForWrite() < len) {
+      armDeadline(DEADLINE_LOG_DRAIN, millis() + logRetryInterval);
+      return;
+    }
+    Serial.write((const uint8_t*)line, len);
+    captureLastTime = rec.time;
+    captureHead++;
+  }
+
+  portENTER_CRITICAL(&captureMux);
+  uint32_t dropped = captureDropped;
+  captureDropped = 0;
+  portEXIT_CRITICAL(&captureMux);
+  if (dropped) {
+    Serial.printf("CAPTURE DROPPED %lu\n", (unsigned long)dropped);
+  }
+}
+
+#endif // CAPTURE_H
@@ -6,142 +6,244 @@
 #ifndef COMMANDS_H
 #define COMMANDS_H
 
+#include <M5Unified.h>
+
+#include "ble_handlers.h"
+#include "camera.h"
+#include "config.h"
+#include "log.h"
+#include "render.h"
+#include "scheduler.h"
+#include "settings.h"
+#include "toast.h"
+#include "trace.h"
+#include "ui.h"
+
 // Forward declarations needed
 void executeShutter();
 void executeSleep();
 void executeWake();
 
+// External Smart Wake state (defined in main sketch)
+extern bool pendingRecordAfterWake;
+extern unsigned long wakeRequestTime;
+
+// Pairing runs as a state machine driven from loop(), so BLE events, the TX
+// queue and recording timeouts keep going while it waits for the camera
+const unsigned long pairingSplashTime = 2000;
+const unsigned long pairingScanTimeout = 30000;
+
+unsigned long pairingPhaseUntil = 0;
+bool pairingFoundShown = false;
+
+void setPairingPhase(PairingPhase phase, unsigned long duration) {
+  pairingPhase = phase;
+  pairingPhaseUntil = millis() + duration;
+  armDeadline(DEADLINE_PAIRING, pairingPhaseUntil);
+}
+
+void endPairing() {
+  pairingPhase = PAIRING_IDLE;
+  cancelDeadline(DEADLINE_PAIRING);
+  updateDisplay();
+}
+
+void stopPairingScan() {
+  pairingMode = false;
+  pairingCameraSlot = 0;
+  if (pBLEScan) {
+    pBLEScan->stop();
+  }
+  setNormalAdvertising(); // Back to allow-list-only connections
+}
+
 void connectCamera(int cameraNum) {
-  Serial.print("Starting camera ");
-  Serial.print(cameraNum);
-  Serial.println(" pairing process");
+  LOGI("Starting camera %d pairing process", cameraNum);
 
   // Set pairing mode for this camera slot
   pairingCameraSlot = cameraNum;
 
   // Reset detection variables
-  detectedCameraName = "";
-  detectedCameraAddress = "";
-
-  M5.Lcd.fillScreen(BLACK);
-  // Draw pairing icon
-  drawBitmap(64, 15, pairing_icon, 32, 32, ICON_CYAN);
-  M5.Lcd.setCursor(25, 50);
-  M5.Lcd.setTextColor(YELLOW);
-  M5.Lcd.print("PAIRING CAM ");
-  M5.Lcd.print(cameraNum);
-  M5.Lcd.setCursor(25, 65);
-  M5.Lcd.setTextColor(CYAN);
-  M5.Lcd.setTextSize(1);
-  M5.Lcd.println("B:Cancel");
-  delay(2000);
-
-  // Start scanning for cameras
-  pairingMode = true;
-  Serial.println("Starting scan for Insta360 cameras");
-
-  M5.Lcd.fillScreen(BLACK);
-  // Draw pairing icon again
-  drawBitmap(64, 10, pairing_icon, 32, 32, ICON_CYAN);
-  M5.Lcd.setCursor(35, 45);
-  M5.Lcd.setTextColor(YELLOW);
-  M5.Lcd.println("Scanning...");
-  M5.Lcd.setCursor(40, 65);
-  M5.Lcd.setTextColor(CYAN);
-  M5.Lcd.println("B:Cancel");
-
-  // Start continuous scanning
-  if (pBLEScan) {
-    pBLEScan->start(0, nullptr, false); // Continuous scan
-  }
+  detectedCameraName[0] = '\0';
+  detectedCameraAddress[0] = '\0';
+  pairingFoundShown = false;
 
-  // Ensure advertising is on
-  setNormalAdvertising();
+  char title[16];
+  snprintf(title, sizeof(title), "PAIRING CAM %d", cameraNum);
+  setPairingPhase(PAIRING_SPLASH, pairingSplashTime);
+  postRender(RENDER_PAIRING, title, YELLOW);
+}
 
-  // Wait for camera to be detected and connect
-  unsigned long startTime = millis();
-  while (pairingMode && millis() - startTime < 30000) { // 30 second timeout
-    M5.update();
+// Called from loop() every pass. Returns true while pairing owns the buttons.
+bool updatePairing() {
+  if (pairingPhase == PAIRING_IDLE) return false;
+  bool due = (long)(millis() - pairingPhaseUntil) >= 0;
 
-    if (M5.BtnB.wasReleased()) {
-      Serial.println("Pairing cancelled by user");
-      pairingMode = false;
+  if (M5.BtnB.wasReleased()) {
+    LOGI("Pairing cancelled by user");
+    if (pairingPhase == PAIRING_SCANNING) {
+      stopPairingScan();
+    } else {
       pairingCameraSlot = 0;
+    }
+    endPairing();
+    return true;
+  }
+
+  switch (pairingPhase) {
+    case PAIRING_SPLASH:
+      if (!due) break;
+      // Start scanning for cameras
+      pairingMode = true;
+      LOGI("Starting scan for Insta360 cameras");
+      postRender(RENDER_PAIRING, "Scanning...", YELLOW);
       if (pBLEScan) {
-        pBLEScan->stop();
+        pBLEScan->start(0, nullptr, false); // Continuous scan
       }
-      updateDisplay();
-      return;
-    }
+      setNormalAdvertising(); // Ensure advertising is on
+      setPairingPhase(PAIRING_SCANNING, pairingScanTimeout);
+      break;
 
-    // Update display with detected camera if found
-    static String lastDetected = "";
-    if (detectedCameraName.length() > 0 && detectedCameraName != lastDetected) {
-      lastDetected = detectedCameraName;
-      M5.Lcd.fillRect(15, 45, 130, 15, BLACK);
-      M5.Lcd.setCursor(35, 45);
-      M5.Lcd.setTextColor(BLUE);
-      M5.Lcd.print("Found!");
-    }
+    case PAIRING_SCANNING:
+      if (!pairingMode) {
+        endPairing(); // The connect handler paired or turned away the camera
+        break;
+      }
+      if (detectedCameraName[0] != '\0' && !pairingFoundShown) {
+        pairingFoundShown = true;
+        postRender(RENDER_PAIRING, "Found!", BLUE);
+      }
+      if (due) {
+        LOGI("Pairing timed out");
+        stopPairingScan();
+        endPairing();
+        showMessageToast("Timeout", "Try again", YELLOW, 2000);
+      }
+      break;
 
-    delay(100);
+    default:
+      break;
   }
+  return true;
+}
 
-  // Timeout - stop scanning
-  if (pairingMode) {
-    pairingMode = false;
-    pairingCameraSlot = 0;
-    if (pBLEScan) {
-      pBLEScan->stop();
+// Cap on how long the fastest camera is held back during a staggered start
+const unsigned long maxStartStagger = 1000;
+
+// Start every connected camera with unicast sends staggered by their measured
+// start latency, slowest first, so recording begins as close together as
+// possible. Returns false when there is nothing to compensate for.
+bool startWithLatencyCompensation() {
+  unsigned long latency[MAX_CAMERAS];
+  unsigned long knownTotal = 0;
+  int knownCount = 0;
+  int connectedCount = 0;
+
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    if (!cameras[i].connected) continue;
+    connectedCount++;
+    if (cameras[i].startLatencyMs > 0) {
+      knownTotal += cameras[i].startLatencyMs;
+      knownCount++;
     }
+  }
+  if (connectedCount < 2 || knownCount == 0) return false;
 
-    M5.Lcd.fillScreen(BLACK);
-    M5.Lcd.setCursor(40, 30);
-    M5.Lcd.setTextColor(YELLOW);
-    M5.Lcd.println("Timeout");
-    M5.Lcd.setCursor(35, 45);
-    M5.Lcd.setTextColor(WHITE);
-    M5.Lcd.println("Try again");
-    delay(2000);
+  // Cameras without a measurement yet are assumed to be average
+  unsigned long defaultLatency = knownTotal / knownCount;
+  unsigned long maxLatency = 0;
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    if (!cameras[i].connected) continue;
+    latency[i] = cameras[i].startLatencyMs > 0 ? cameras[i].startLatencyMs : defaultLatency;
+    if (latency[i] > maxLatency) maxLatency = latency[i];
   }
 
-  updateDisplay();
-}
+  // Queue in send order (largest latency = smallest delay first)
+  bool queued[MAX_CAMERAS] = {false};
+  for (int n = 0; n < connectedCount; n++) {
+    int next = -1;
+    for (int i = 0; i < MAX_CAMERAS; i++) {
+      if (!cameras[i].connected || queued[i]) continue;
+      if (next < 0 || latency[i] > latency[next]) next = i;
+    }
+    queued[next] = true;
 
-// Wrapper functions for each camera
-void connectCamera1() {
-  connectCamera(1);
+    unsigned long delayMs = maxLatency - latency[next];
+    if (delayMs > maxStartStagger) delayMs = maxStartStagger;
+    LOGI("Start Cam %d: est. latency %lu ms, send +%lu ms", next + 1, latency[next], delayMs);
+    enqueueTx(cameras[next].connId, SHUTTER_CMD, sizeof(SHUTTER_CMD), "SHUTTER (START)", delayMs, true);
+  }
+  return true;
 }
 
-void connectCamera2() {
-  connectCamera(2);
+// Once every camera in the last start has sent its first timer packet,
+// print how far apart they actually started. Called from loop().
+void reportStartSkew() {
+  unsigned long now = millis();
+  unsigned long earliest = 0;
+  unsigned long latest = 0;
+  int count = 0;
+
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    CameraInfo* camera = &cameras[i];
+    if (!camera->inStartBatch) continue;
+
+    if (!camera->connected || (camera->startSentTime != 0 && now - camera->startSentTime > maxStartLatency)) {
+      // Dropped out or never started - leave it out of the measurement
+      camera->inStartBatch = false;
+      camera->startSentTime = 0;
+      continue;
+    }
+    if (camera->startSentTime != 0) return; // Still waiting for its first timer packet
+
+    if (count == 0 || (long)(camera->firstTimerTime - earliest) < 0) earliest = camera->firstTimerTime;
+    if (count == 0 || (long)(camera->firstTimerTime - latest) > 0) latest = camera->firstTimerTime;
+    count++;
+  }
+  if (count < 2) {
+    for (int i = 0; i < MAX_CAMERAS; i++) cameras[i].inStartBatch = false;
+    return;
+  }
+
+  LOGI("Start skew: %lu ms across %d cameras", latest - earliest, count);
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    if (!cameras[i].inStartBatch) continue;
+    LOGI("  Cam %d: +%lu ms (latency est. %lu ms)", i + 1,
+         cameras[i].firstTimerTime - earliest, cameras[i].startLatencyMs);
+    cameras[i].inStartBatch = false;
+  }
 }
 
 void executeShutter() {
   // Sync Check Logic
-  bool c1Rec = camera1Connected && camera1.isRecording;
-  bool c2Rec = camera2Connected && camera2.isRecording;
-  
-  if (c1Rec && !c2Rec) {
-     // Camera 1 is recording, Camera 2 is stopped.
-     // We want to STOP Camera 1 to sync them (both stopped).
-     // Send Unicast Toggle to Camera 1 ONLY.
-     if (camera1Connected) {
-       Serial.println("Syncing: Stopping Cam 1 to match Cam 2");
-       sendUnicastCommand(camera1.connId, SHUTTER_CMD, sizeof(SHUTTER_CMD), "SHUTTER (U1)");
+  int recordingCount = 0;
+  int stoppedCount = 0;
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    if (!cameras[i].connected) continue;
+    if (cameras[i].isRecording) recordingCount++;
+    else stoppedCount++;
+  }
+
+  if (recordingCount > 0 && stoppedCount > 0) {
+     // Cameras are out of sync - some recording, some stopped.
+     // We want to STOP the recording ones so all are stopped.
+     // Send Unicast Toggle to each recording camera ONLY.
+     for (int i = 0; i < MAX_CAMERAS; i++) {
+       if (cameras[i].connected && cameras[i].isRecording) {
+         LOGI("Syncing: Stopping Cam %d to match the others", i + 1);
+         sendUnicastCommand(cameras[i].connId, SHUTTER_CMD, sizeof(SHUTTER_CMD), "SHUTTER (SYNC)");
+       }
      }
   } 
-  else if (!c1Rec && c2Rec) {
-     // Camera 2 is recording, Camera 1 is stopped.
-     // We want to STOP Camera 2 to sync them.
-     // Send Unicast Toggle to Camera 2 ONLY.
-     if (camera2Connected) {
-       Serial.println("Syncing: Stopping Cam 2 to match Cam 1");
-       sendUnicastCommand(camera2.connId, SHUTTER_CMD, sizeof(SHUTTER_CMD), "SHUTTER (U2)");
+  else if (recordingCount == 0 && stoppedCount > 0) {
+     // All stopped - start them, compensating for per-camera latency once
+     // we have measurements, otherwise a plain broadcast.
+     if (!startWithLatencyCompensation()) {
+       sendCommand(SHUTTER_CMD, sizeof(SHUTTER_CMD), "SHUTTER", true);
      }
-  } 
+  }
   else {
-     // Both are in same state (Both Rec or Both Stop).
+     // All are in same state (All Rec or none connected).
      // Standard Broadcast Toggle.
      sendCommand(SHUTTER_CMD, sizeof(SHUTTER_CMD), "SHUTTER");
   }
@@ -159,38 +261,189 @@ void executeSleep() {
   sendCommand(POWER_OFF_CMD, sizeof(POWER_OFF_CMD), "SLEEP");
 }
 
+// Wake engine: every saved camera is woken in one shared window. Wake
+// advertising stays on and the iBeacon payload is swapped between cameras
+// every wakeRotateInterval ms, so each camera sees its own payload several
+// times per second while it scans instead of waiting for its turn. Each pass
+// through the cameras holds the payloads a little longer than the last, so
+// the cycle cannot lock onto a camera whose scan period is a multiple of it
+// and keep showing that camera someone else's payload.
+const unsigned long wakeDuration = 3000;      // Same window one camera used to get
+const unsigned long wakeRotateInterval = 100; // A few advertising events per payload
+const unsigned long wakeRotateStretch = 30;   // Added per pass, over wakeRotatePasses passes
+const int wakeRotatePasses = 4;
+
+bool wakeInProgress = false;
+int wakeSlot = -1;                // Camera whose payload is on air
+int wakePass = 0;                 // Passes through the saved cameras so far
+unsigned long wakeEndTime = 0;
+
+// How long this pass holds each payload
+unsigned long wakeRotateDwell() {
+  return wakeRotateInterval + (wakePass % wakeRotatePasses) * wakeRotateStretch;
+}
+
+// Next saved camera after `slot`, wrapping around; -1 if none are saved
+int nextWakeSlot(int slot) {
+  for (int n = 1; n <= MAX_CAMERAS; n++) {
+    int i = (slot + n + MAX_CAMERAS) % MAX_CAMERAS;
+    if (cameras[i].isValid) return i;
+  }
+  return -1;
+}
+
 void executeWake() {
   // Check if at least one camera is saved
-  if (!camera1.isValid && !camera2.isValid) {
-    showCenteredMessage("No camera", "Saved!", RED);
-    delay(2000);
-    updateDisplay();
+  if (countSavedCameras() == 0) {
+    showMessageToast("No camera", "Saved!", RED, 2000);
     return;
   }
 
-  int wakingCount = 0;
-  if (camera1.isValid) wakingCount++;
-  if (camera2.isValid) wakingCount++;
+  if (wakeInProgress) return; // Already waking everyone
+
+  wakeSlot = nextWakeSlot(-1);
+  wakePass = 0;
+  wakeEndTime = millis() + wakeDuration;
+  wakeInProgress = true;
+  LOGI("Waking %d camera(s) for %lu ms", countSavedCameras(), wakeDuration);
+
+  trace(TRACE_WAKE_START, countSavedCameras());
+  setWakeAdvertising(cameras[wakeSlot].wakePayload);
+  // The first camera's dwell starts once the payload is on air
+  armDeadline(DEADLINE_WAKE_ROTATE, advertisingStartTime() + wakeRotateDwell());
+  showStatusToast("WAKING...", YELLOW, wakeDuration, TOAST_NOTICE);
+}
+
+// Rotate the wake payload and end the wake window. Called from loop().
+void updateWake() {
+  if (!wakeInProgress) return;
+
+  unsigned long now = millis();
+  if ((long)(deadlines[DEADLINE_WAKE_ROTATE].at - now) > 0) return;
 
-  // Wake camera 1 if saved
-  if (camera1.isValid) {
-    showCenteredMessage("Waking 1...", camera1.name, YELLOW);
-    setWakeAdvertising(camera1.wakePayload);
-    delay(3000); // Send wake signal for 3 seconds
+  if ((long)(now - wakeEndTime) >= 0) {
+    wakeInProgress = false;
+    wakeSlot = -1;
+    cancelDeadline(DEADLINE_WAKE_ROTATE);
+    setNormalAdvertising();
+    trace(TRACE_WAKE_END);
+    LOGI("Wake window finished");
+    showStatusToast("WAKE SENT!", BLUE, 1500, TOAST_NOTICE);
+    return;
   }
 
-  // Wake camera 2 if saved
-  if (camera2.isValid) {
-    showCenteredMessage("Waking 2...", camera2.name, YELLOW);
-    setWakeAdvertising(camera2.wakePayload);
-    delay(3000); // Send wake signal for 3 seconds
+  int next = nextWakeSlot(wakeSlot);
+  if (next >= 0 && next <= wakeSlot) wakePass++;  // Wrapped around
+  if (next >= 0 && next != wakeSlot) {
+    wakeSlot = next;
+    rotateWakeAdvertising(cameras[wakeSlot].wakePayload);
   }
+  armDeadline(DEADLINE_WAKE_ROTATE, now + wakeRotateDwell());
+}
 
-  setNormalAdvertising();
+// Smart Wake: wake every saved camera and start each one recording as soon as
+// its own link has settled, instead of waiting for the whole rig. Cameras that
+// come up late get a catch-up start and their lag is reported.
+const unsigned long smartWakeSettleTime = 2000; // Connection stability before starting
+const unsigned long smartWakeTimeout = 30000;   // Give up on cameras that never return
 
-  showCenteredMessage("Wake Signal", "SENT!", BLUE);
-  delay(1500);
-  updateDisplay();
+unsigned long smartWakeFirstStart = 0; // When the first camera was started, 0 if none yet
+
+void startSmartWake() {
+  if (countSavedCameras() == 0) {
+    executeWake(); // Shows the "No camera" message
+    return;
+  }
+
+  LOGI("Smart Wake initiated...");
+  pendingRecordAfterWake = true;
+  wakeRequestTime = millis();
+  smartWakeFirstStart = 0;
+
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    cameras[i].wakeState = cameras[i].isValid ? WAKE_WAITING : WAKE_IDLE;
+  }
+  armDeadline(DEADLINE_SMART_WAKE, wakeRequestTime + smartWakeTimeout);
+
+  executeWake();
+}
+
+void endSmartWake() {
+  pendingRecordAfterWake = false;
+  cancelDeadline(DEADLINE_SMART_WAKE);
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    cameras[i].wakeState = WAKE_IDLE;
+  }
+}
+
+// Advance each camera through the Smart Wake. Called from loop().
+void updateSmartWake() {
+  if (!pendingRecordAfterWake) return;
+
+  unsigned long now = millis();
+  unsigned long nextCheck = wakeRequestTime + smartWakeTimeout;
+  bool changed = false;
+  int waiting = 0;
+  int started = 0;
+
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    CameraInfo* camera = &cameras[i];
+
+    if (camera->wakeState == WAKE_WAITING && camera->connected) {
+      camera->wakeState = WAKE_SETTLING;
+      camera->wakeReadyAt = now + smartWakeSettleTime;
+      LOGI("Smart Wake: Cam %d connected after %lu ms", i + 1, now - wakeRequestTime);
+      changed = true;
+    } else if (camera->wakeState == WAKE_SETTLING && !camera->connected) {
+      camera->wakeState = WAKE_WAITING; // Dropped again - wait for it to come back
+      changed = true;
+    }
+
+    if (camera->wakeState == WAKE_SETTLING && (long)(now - camera->wakeReadyAt) >= 0) {
+      camera->wakeState = WAKE_STARTED;
+      changed = true;
+      if (camera->isRecording) {
+        LOGI("Smart Wake: Cam %d already recording", i + 1);
+      } else {
+        enqueueTx(camera->connId, SHUTTER_CMD, sizeof(SHUTTER_CMD), "SHUTTER (WAKE)", 0, true);
+        if (smartWakeFirstStart == 0) {
+          smartWakeFirstStart = now;
+          LOGI("Smart Wake: Cam %d started first, %lu ms after wake", i + 1, now - wakeRequestTime);
+        } else {
+          LOGI("Smart Wake: Cam %d catch-up start, +%lu ms behind the first", i + 1, now - smartWakeFirstStart);
+        }
+      }
+    }
+
+    if (camera->wakeState == WAKE_SETTLING && (long)(camera->wakeReadyAt - nextCheck) < 0) {
+      nextCheck = camera->wakeReadyAt;
+    }
+    if (camera->wakeState == WAKE_WAITING || camera->wakeState == WAKE_SETTLING) waiting++;
+    if (camera->wakeState == WAKE_STARTED) started++;
+  }
+
+  if (waiting == 0) {
+    LOGI("Smart Wake: all %d cameras started", started);
+    endSmartWake();
+    changed = true;
+  } else if ((long)(now - (wakeRequestTime + smartWakeTimeout)) >= 0) {
+    // Timeout - keep whatever did start, report the rest
+    for (int i = 0; i < MAX_CAMERAS; i++) {
+      if (cameras[i].wakeState == WAKE_WAITING || cameras[i].wakeState == WAKE_SETTLING) {
+        LOGI("Smart Wake: Cam %d did not come back", i + 1);
+      }
+    }
+    LOGI("Smart Wake: Timeout waiting for connections.");
+    endSmartWake();
+    if (started == 0) {
+      showMessageToast("Wake Failed", "Timeout", RED, 2000);
+    }
+    changed = true;
+  } else {
+    armDeadline(DEADLINE_SMART_WAKE, nextCheck);
+  }
+
+  if (changed) updateDisplay();
 }
 
 #endif // COMMANDS_H
\ No newline at end of file
@@ -6,11 +6,41 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <Arduino.h>
+
 // GPIO pin definitions for external button control
 #define SHUTTER_PIN G0   // Pin for Shutter function (#2) - triggers on LOW (to GND)
 #define SLEEP_PIN G26    // Pin for Sleep function (#5) - triggers on HIGH (to 3.3V)
 #define WAKE_PIN G36     // Pin for Wake function (#6) - triggers on HIGH (to 3.3V)
 
+// Built-in buttons (same pins on M5StickC, Plus and Plus2), watched for wake-up edges
+#define BTN_A_PIN 37     // Front button (M5.BtnA)
+#define BTN_B_PIN 39     // Side button (M5.BtnB)
+
+// Target board - chosen at build time so screen layouts are compile-time
+// constants. Picked from the Arduino board definition when possible;
+// otherwise define REMOTE_BOARD yourself (e.g. -DREMOTE_BOARD=BOARD_M5STICKC).
+// The panel M5.begin() finds is checked against it at boot (checkPanelSize()).
+#define BOARD_M5STICKC       0   // 160x80 panel
+#define BOARD_M5STICKC_PLUS  1   // 240x135 panel
+#define BOARD_M5STICKC_PLUS2 2   // 240x135 panel
+
+#ifndef REMOTE_BOARD
+  #if defined(ARDUINO_M5Stick_C) || defined(ARDUINO_M5STACK_STICK_C)
+    #define REMOTE_BOARD BOARD_M5STICKC
+  #elif defined(ARDUINO_M5Stick_C_Plus) || defined(ARDUINO_M5STACK_STICKC_PLUS)
+    #define REMOTE_BOARD BOARD_M5STICKC_PLUS
+  #elif defined(ARDUINO_M5Stick_C_Plus2) || defined(ARDUINO_M5STACK_STICKC_PLUS2)
+    #define REMOTE_BOARD BOARD_M5STICKC_PLUS2
+  #else
+    #warning "Board not recognised - building the M5StickC Plus2 layouts. Define REMOTE_BOARD to pick another."
+    #define REMOTE_BOARD BOARD_M5STICKC_PLUS2
+  #endif
+#endif
+
+// Advertised name - must match the official remote exactly (Ace Pro 2 checks it)
+#define REMOTE_DEVICE_NAME           "Insta360 GPS Remote"
+
 // GPS Remote service UUIDs
 #define GPS_REMOTE_SERVICE_UUID      "0000ce80-0000-1000-8000-00805f9b34fb"
 #define GPS_REMOTE_WRITE_CHAR_UUID   "0000ce81-0000-1000-8000-00805f9b34fb"
@@ -33,6 +63,11 @@ const int numScreens = 7;
 const unsigned long debounceDelay = 200; // 200ms debounce
 const unsigned long startupDelay = 2000; // 2 seconds delay after startup
 
+// Trigger slots for remotes sharing a trigger cable (see triggerslot.h)
+const unsigned long initialGpioSlotWidth = 20; // ms between neighbouring slots
+const unsigned long minGpioSlotWidth = 5;
+const unsigned long maxGpioSlotWidth = 50;
+
 // Command payloads for camera control
 static uint8_t SHUTTER_CMD[] = {0xFC, 0xEF, 0xFE, 0x86, 0x00, 0x03, 0x01, 0x02, 0x00};
 static uint8_t MODE_CMD[] = {0xFC, 0xEF, 0xFE, 0x86, 0x00, 0x03, 0x01, 0x01, 0x00};
@@ -0,0 +1,74 @@
+/*
+ * console.h
+ * Single-character diagnostic commands from the Serial monitor
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <Arduino.h>
+
+#include "capture.h"
+#include "log.h"
+#include "render.h"
+#include "soak.h"
+#include "trace.h"
+
+// Caller-side cost of one log line: the deferred LOGI against the direct
+// Serial.printf it replaced. Formatting and UART time for LOGI are paid later
+// in drainLog(), which is the point.
+void benchmarkLogging() {
+  const int calls = 16;  // Fits in the log queue without drops
+
+  unsigned long start = micros();
+  for (int i = 0; i < calls; i++) {
+    LOGI("Log benchmark %d of %d: %s", i + 1, calls, "deferred");
+  }
+  unsigned long deferred = micros() - start;
+
+  start = micros();
+  for (int i = 0; i < calls; i++) {
+    Serial.printf("Log benchmark %d of %d: %s\n", i + 1, calls, "direct");
+  }
+  unsigned long direct = micros() - start;
+
+  Serial.printf("Log call cost: LOGI %lu us, Serial.printf %lu us (mean of %d)\n",
+                deferred / calls, direct / calls, calls);
+}
+
+// Polled from loop(). loop() sleeps up to maxIdleWait, so a command can take
+// up to a second to be picked up.
+void handleSerialCommands() {
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    switch (c) {
+      case 'T':
+      case 't':
+        dumpTrace();
+        break;
+      case 'B':
+      case 'b':
+        benchmarkLogging();
+        break;
+      case 'C':
+      case 'c':
+        setCaptureEnabled(!captureEnabled);
+        break;
+      case 'S':
+      case 's':
+        toggleSoakReporting();
+        break;
+      case 'R':
+      case 'r':
+        reportTaskStats();
+        break;
+      case '?':
+        Serial.println("Commands: T = dump event trace, B = log call benchmark, C = start/stop session capture, S = soak counters (toggles periodic report), R = task CPU time, render queue and display flush");
+        break;
+      default:
+        break; // Ignore line endings and anything unknown
+    }
+  }
+}
+
+#endif // CONSOLE_H
@@ -0,0 +1,102 @@
+/*
+ * display.h
+ * Off-screen frame buffer with dirty-tile flush to the LCD
+ */
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <M5Unified.h>
+
+// All UI drawing goes through gfx. Normally that is the off-screen canvas and
+// flushDisplay() pushes only the tiles that changed; if the frame buffer
+// can't be allocated it falls back to drawing straight on the panel.
+M5Canvas canvas;
+LovyanGFX* gfx = &M5.Lcd;
+
+// Dirty tracking granularity. 240x240 covers every supported panel/rotation.
+#define TILE_SIZE 16
+#define MAX_TILES_X (240 / TILE_SIZE)
+#define MAX_TILES_Y (240 / TILE_SIZE)
+
+uint32_t tileHash[MAX_TILES_Y][MAX_TILES_X];
+bool forceFullFlush = true;
+
+// Flush statistics (bytes of pixel data sent to the panel)
+uint32_t displayFlushCount = 0;
+uint32_t displayBytesPushed = 0;
+uint32_t displayFullFrameBytes = 0; // What the same flushes cost as full-screen redraws
+
+// (Re)create the frame buffer to match the panel's current rotation
+void setupCanvas() {
+  canvas.deleteSprite();
+  canvas.setColorDepth(16);
+  if (canvas.createSprite(M5.Lcd.width(), M5.Lcd.height())) {
+    gfx = &canvas;
+  } else {
+    Serial.println("Frame buffer allocation failed - drawing directly");
+    gfx = &M5.Lcd;
+  }
+  forceFullFlush = true;
+}
+
+// FNV-1a over one tile of the frame buffer
+uint32_t hashTile(const uint16_t* buf, int stride, int x, int y, int w, int h) {
+  uint32_t hash = 2166136261u;
+  for (int row = 0; row < h; row++) {
+    const uint16_t* p = buf + (y + row) * stride + x;
+    for (int col = 0; col < w; col++) {
+      hash = (hash ^ p[col]) * 16777619u;
+    }
+  }
+  return hash;
+}
+
+// Push the tiles that changed since the last flush, merging horizontal runs
+// of dirty tiles into a single window per run
+void flushDisplay() {
+  if (gfx != &canvas) return; // Drawing went straight to the panel
+
+  const uint16_t* buf = (const uint16_t*)canvas.getBuffer();
+  int width = canvas.width();
+  int height = canvas.height();
+  int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+  int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+  uint32_t bytes = 0;
+
+  for (int ty = 0; ty < tilesY; ty++) {
+    int y = ty * TILE_SIZE;
+    int h = (y + TILE_SIZE > height) ? height - y : TILE_SIZE;
+    int runStart = -1;
+
+    for (int tx = 0; tx <= tilesX; tx++) {
+      bool dirty = false;
+      if (tx < tilesX) {
+        int x = tx * TILE_SIZE;
+        int w = (x + TILE_SIZE > width) ? width - x : TILE_SIZE;
+        uint32_t hash = hashTile(buf, width, x, y, w, h);
+        dirty = forceFullFlush || hash != tileHash[ty][tx];
+        tileHash[ty][tx] = hash;
+      }
+
+      if (dirty && runStart < 0) {
+        runStart = tx;
+      } else if (!dirty && runStart >= 0) {
+        int x = runStart * TILE_SIZE;
+        int w = ((tx * TILE_SIZE > width) ? width : tx * TILE_SIZE) - x;
+        M5.Lcd.setClipRect(x, y, w, h);
+        canvas.pushSprite(&M5.Lcd, 0, 0);
+        bytes += w * h * 2;
+        runStart = -1;
+      }
+    }
+  }
+  M5.Lcd.clearClipRect();
+
+  forceFullFlush = false;
+  displayFlushCount++;
+  displayBytesPushed += bytes;
+  displayFullFrameBytes += width * height * 2;
+}
+
+#endif // DISPLAY_H
@@ -0,0 +1,78 @@
+/*
+ * events.h
+ * Lock-free single-producer/single-consumer event ring between the
+ * Bluedroid callbacks (producer) and loop() (consumer)
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "packets.h"
+
+// Must be a power of two
+#define BLE_EVENT_QUEUE_SIZE 32
+
+enum BleEventType : uint8_t {
+  BLE_EVT_CONNECT = 0,
+  BLE_EVT_DISCONNECT,
+  BLE_EVT_PACKET,      // Decoded notification from a camera
+  BLE_EVT_SCAN_RESULT  // Insta360 camera seen while pairing
+};
+
+// Fixed-size record - filling one never touches the heap
+struct BleEvent {
+  BleEventType type;
+  uint16_t connId;
+  unsigned long time;   // millis() when the callback ran
+  union {
+    struct {
+      uint8_t bda[6];
+    } link;             // CONNECT / DISCONNECT
+    struct {
+      PacketKind kind;
+      uint8_t frameType;
+      uint32_t elapsedSeconds;
+    } packet;           // PACKET
+    struct {
+      char name[30];
+      uint8_t bda[6];
+      uint8_t addrType;
+    } scan;             // SCAN_RESULT
+  };
+};
+
+BleEvent bleEvents[BLE_EVENT_QUEUE_SIZE];
+std::atomic<uint32_t> bleEventHead(0);  // Next slot to read (consumer owns)
+std::atomic<uint32_t> bleEventTail(0);  // Next slot to write (producer owns)
+std::atomic<uint32_t> bleEventsDropped(0);
+
+// Producer side: reserve the next slot, or nullptr if the ring is full.
+// Fill the returned record, then publish it with commitBleEvent().
+BleEvent* reserveBleEvent() {
+  uint32_t tail = bleEventTail.load(std::memory_order_relaxed);
+  uint32_t head = bleEventHead.load(std::memory_order_acquire);
+  if (tail - head >= BLE_EVENT_QUEUE_SIZE) {
+    bleEventsDropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  return &bleEvents[tail & (BLE_EVENT_QUEUE_SIZE - 1)];
+}
+
+void commitBleEvent() {
+  bleEventTail.fetch_add(1, std::memory_order_release);
+}
+
+// Consumer side: copy out the oldest event; false if the ring is empty
+bool popBleEvent(BleEvent* out) {
+  uint32_t head = bleEventHead.load(std::memory_order_relaxed);
+  uint32_t tail = bleEventTail.load(std::memory_order_acquire);
+  if (head == tail) return false;
+  *out = bleEvents[head & (BLE_EVENT_QUEUE_SIZE - 1)];
+  bleEventHead.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+#endif // EVENTS_H
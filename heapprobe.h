@@ -0,0 +1,112 @@
+/*
+ * heapprobe.h
+ * Debug-build allocation counter for the hot paths
+ */
+
+#ifndef HEAPPROBE_H
+#define HEAPPROBE_H
+
+#include <Arduino.h>
+
+// The loop iteration, the BLE callbacks and the display path are meant to run
+// without touching the heap. Build with -DHEAP_PROBE to check: each probed
+// region records how many allocations were made while it ran, and the totals
+// are printed over Serial every heapProbeReportInterval ms.
+//
+// Allocations are counted by wrapping malloc, calloc and realloc at link
+// time (operator new and String go through malloc), so a block that is
+// allocated and freed inside the region still counts. HEAP_PROBE builds must
+// link with
+//   -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+// (compiler.c.elf.extra_flags in platform.local.txt for the Arduino IDE);
+// without it the link fails on __real_malloc. heap_caps_malloc() calls made
+// directly by the BLE stack are not seen. Another task allocating at the same
+// moment shows up too, so treat a non-zero count as "look here", not as proof.
+// Without HEAP_PROBE everything below compiles away.
+
+enum HeapProbeSite {
+  HEAP_SITE_LOOP,
+  HEAP_SITE_BLE_CALLBACK,
+  HEAP_SITE_DISPLAY,
+  HEAP_SITE_COUNT
+};
+
+#ifdef HEAP_PROBE
+
+#include <atomic>
+#include <stddef.h>
+
+std::atomic<uint32_t> heapAllocationCount{0};
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+  return __real_realloc(ptr, size);
+}
+}
+
+struct HeapProbeStats {
+  uint32_t runs;
+  uint32_t allocatingRuns;  // Runs that allocated at all
+  uint32_t allocations;     // Sum over all runs
+};
+
+HeapProbeStats heapProbeStats[HEAP_SITE_COUNT];
+const char* const heapProbeNames[HEAP_SITE_COUNT] = { "loop", "ble_cb", "display" };
+const unsigned long heapProbeReportInterval = 10000;
+unsigned long heapProbeLastReport = 0;
+
+// Records one run of a probed region; construct it at the top of the region
+class HeapProbeScope {
+  public:
+    explicit HeapProbeScope(HeapProbeSite site) : site(site), startCount(heapAllocationCount.load()) {}
+    ~HeapProbeScope() {
+      uint32_t allocations = heapAllocationCount.load() - startCount;
+      HeapProbeStats& stats = heapProbeStats[site];
+      stats.runs++;
+      if (allocations > 0) stats.allocatingRuns++;
+      stats.allocations += allocations;
+    }
+  private:
+    HeapProbeSite site;
+    uint32_t startCount;
+};
+
+#define HEAP_PROBE_SCOPE(site) HeapProbeScope heapProbeScope_(site)
+
+void heapProbeReport() {
+  unsigned long now = millis();
+  if (now - heapProbeLastReport < heapProbeReportInterval) return;
+  heapProbeLastReport = now;
+
+  for (int i = 0; i < HEAP_SITE_COUNT; i++) {
+    const HeapProbeStats& stats = heapProbeStats[i];
+    Serial.printf("Heap probe %-8s runs=%lu allocating=%lu allocations=%lu\n",
+                  heapProbeNames[i], (unsigned long)stats.runs,
+                  (unsigned long)stats.allocatingRuns, (unsigned long)stats.allocations);
+  }
+}
+
+#else
+
+#define HEAP_PROBE_SCOPE(site) do {} while (0)
+
+void heapProbeReport() {}
+
+#endif
+
+#endif // HEAPPROBE_H
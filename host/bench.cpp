@@ -0,0 +1,194 @@
+/*
+ * bench.cpp
+ * Host benchmarks for the decoder, blitter, loop, display and logging paths
+ *
+ *   bench [--quick]
+ *
+ * Wall-clock figures are for the host CPU and only mean anything relative
+ * to each other; counts (bytes, primitives) and simulated latencies carry
+ * over to the device as they are.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "camera_sim.h"
+#include "sketch.h"
+
+namespace {
+
+bool quick = false;
+
+double wallNs() {
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned long percentile(std::vector<unsigned long> values, int p) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  size_t index = (values.size() - 1) * p / 100;
+  return values[index];
+}
+
+void benchDecoder() {
+  static const uint8_t framedTimer[] = {0xFC, 0xEF, 0xFE, 0x10, 0x00, 0x0C, 'R', 'E', 'C', ' ',
+                                        '0', '0', ':', '1', '2', ':', '3', '4'};
+  static const uint8_t framedStatus[] = {0xFC, 0xEF, 0xFE, 0x22, 0x00, 0x04, 0x01, 0x02, 0x03, 0x04};
+  static const uint8_t unframed[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A,
+                                     '1', ':', '2', '3', ':', '4', '5', 0x00};
+  static const uint8_t junk[] = {0xFC, 0xEF, 0xFE, 0x10, 0x00, 0x40, 0x00};
+  const uint8_t* packets[] = {framedTimer, framedStatus, unframed, junk};
+  const size_t lengths[] = {sizeof(framedTimer), sizeof(framedStatus), sizeof(unframed), sizeof(junk)};
+
+  const int iterations = quick ? 100000 : 4000000;
+  uint32_t kinds[3] = {0, 0, 0};
+  double start = wallNs();
+  for (int i = 0; i < iterations; i++) {
+    DecodedPacket packet;
+    kinds[decodeCameraPacket(packets[i & 3], lengths[i & 3], &packet)]++;
+  }
+  double ns = (wallNs() - start) / iterations;
+  printf("decoder: %.1f ns/packet (%.1f M packets/s), mix invalid=%u timer=%u status=%u\n", ns, 1000.0 / ns,
+         kinds[PACKET_INVALID], kinds[PACKET_TIMER], kinds[PACKET_STATUS]);
+}
+
+// drawBitmap() as it was before the run-length blitter: one primitive per
+// set bit
+void drawBitmapPerPixel(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h, uint16_t color,
+                        uint8_t scale) {
+  int16_t byteWidth = (w + 7) / 8;
+  for (int16_t j = 0; j < h; j++) {
+    for (int16_t i = 0; i < w; i++) {
+      if (!(bitmap[j * byteWidth + i / 8] & (0x80 >> (i & 7)))) continue;
+      if (scale == 1) gfx->drawPixel(x + i, y + j, color);
+      else gfx->fillRect(x + i * scale, y + j * scale, scale, scale, color);
+    }
+  }
+}
+
+void benchBlitter() {
+  struct Icon {
+    const char* name;
+    const uint8_t* bits;
+  };
+  const Icon icons[] = {{"bluetooth", bluetooth_icon}, {"shutter", shutter_icon}, {"switch", switch_icon}};
+  const int draws = quick ? 2000 : 200000;
+  for (const Icon& icon : icons) {
+    for (uint8_t scale = 1; scale <= 2; scale++) {
+      uint32_t before = gfx->primitiveCalls;
+      double start = wallNs();
+      for (int n = 0; n < draws; n++) drawBitmap(0, 0, icon.bits, 32, 32, WHITE, scale);
+      double runUs = (wallNs() - start) / draws / 1000;
+      uint32_t runFills = (gfx->primitiveCalls - before) / draws;
+
+      before = gfx->primitiveCalls;
+      start = wallNs();
+      for (int n = 0; n < draws; n++) drawBitmapPerPixel(0, 0, icon.bits, 32, 32, WHITE, scale);
+      double pixelUs = (wallNs() - start) / draws / 1000;
+      uint32_t pixelFills = (gfx->primitiveCalls - before) / draws;
+
+      printf("blitter: %-9s x%u  runs %3u fills %6.2f us/icon, per-pixel %4u fills %6.2f us/icon (%.1fx)\n",
+             icon.name, scale, runFills, runUs, pixelFills, pixelUs, pixelUs / runUs);
+    }
+  }
+}
+
+void benchLogging() {
+  const int batches = quick ? 200 : 20000;
+  const int perBatch = 16;  // Fits the log queue
+  double logNs = 0;
+  double printfNs = 0;
+  for (int b = 0; b < batches; b++) {
+    double start = wallNs();
+    for (int i = 0; i < perBatch; i++) LOGI("Log benchmark %d of %d: %s", i + 1, perBatch, "deferred");
+    logNs += wallNs() - start;
+    drainLog();
+
+    start = wallNs();
+    for (int i = 0; i < perBatch; i++) Serial.printf("Log benchmark %d of %d: %s\n", i + 1, perBatch, "direct");
+    printfNs += wallNs() - start;
+    host::serialClear();
+  }
+  printf("logging: LOGI %.0f ns/call at the call site, Serial.printf %.0f ns/call\n", logNs / (batches * perBatch),
+         printfNs / (batches * perBatch));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+
+  benchDecoder();
+
+  // Two cameras, both saved, reconnecting at boot
+  const uint8_t addrA[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x01};
+  const uint8_t addrB[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x02};
+  SimCamera camA("X5 AAA111", addrA);
+  SimCamera camB("X4 BBB222", addrB);
+  camB.latencyMs = 300;
+  saveCamera(1, camA.name, packAddress(addrA), 0);
+  saveCamera(2, camB.name, packAddress(addrB), 0);
+  host::bootSketch();
+  camA.attach();
+  camB.attach();
+  host::runFor(3000);
+  host::serialClear();
+
+  benchBlitter();
+
+  // Steady recording: timer packets from both cameras, dashboard timer ticking
+  host::at(host::nowMs() + 10, [] { host::pressButton(BTN_A_PIN); });
+  host::at(host::nowMs() + 90, [] { host::releaseButton(BTN_A_PIN); });
+  host::runFor(2000);
+  if (!camA.recording || !camB.recording) host::fail("cameras did not start");
+
+  uint32_t flushes = displayFlushCount;
+  uint32_t pushed = displayBytesPushed;
+  uint32_t fullFrame = displayFullFrameBytes;
+  uint32_t panelBytes = M5.Display.bytesPushed;
+  unsigned long recordMs = quick ? 10000 : 120000;
+  double start = wallNs();
+  uint32_t passes = host::runFor(recordMs);
+  double wall = wallNs() - start;
+  host::serialClear();
+  printf("loop: %u passes in %lu s recording (%.1f/s), %.2f us/pass on this host\n", passes, recordMs / 1000,
+         passes * 1000.0 / recordMs, wall / passes / 1000);
+  printf("display: %u flushes, %u bytes pushed vs %u as full frames (%.1f%%), panel saw %u\n",
+         displayFlushCount - flushes, displayBytesPushed - pushed, displayFullFrameBytes - fullFrame,
+         100.0 * (displayBytesPushed - pushed) / (displayFullFrameBytes - fullFrame),
+         M5.Display.bytesPushed - panelBytes);
+
+  benchLogging();
+
+  // Input to action: release of a short press to the SHUTTER notification.
+  // Compared with a loop that polls the buttons every 50 ms.
+  const int presses = quick ? 10 : 200;
+  uint32_t seed = 12345;
+  std::vector<unsigned long> eventLatency;
+  std::vector<unsigned long> pollLatency;
+  for (int i = 0; i < presses; i++) {
+    seed = seed * 1103515245u + 12345u;
+    unsigned long pressAt = host::nowMs() + 1500 + (seed >> 16) % 50;
+    unsigned long releaseAt = pressAt + 80;
+    host::at(pressAt, [] { host::pressButton(BTN_A_PIN); });
+    host::at(releaseAt, [] { host::releaseButton(BTN_A_PIN); });
+    size_t notesBefore = host::notificationCount();
+    host::runUntil(releaseAt + 1000);
+
+    for (size_t n = notesBefore; n < host::notificationCount(); n++) {
+      const host::Notification& note = host::notification(n);
+      if (note.len == sizeof(SHUTTER_CMD) && memcmp(note.data, SHUTTER_CMD, note.len) == 0) {
+        eventLatency.push_back((unsigned long)(note.us / 1000) - releaseAt);
+        break;
+      }
+    }
+    pollLatency.push_back(50 - releaseAt % 50);
+  }
+  host::serialClear();
+  printf("input->tx (simulated): event-driven p50 %lu ms p99 %lu ms (%zu of %d), 50 ms polling p50 %lu ms p99 %lu ms\n",
+         percentile(eventLatency, 50), percentile(eventLatency, 99), eventLatency.size(), presses,
+         percentile(pollLatency, 50), percentile(pollLatency, 99));
+  return eventLatency.size() == (size_t)presses ? 0 : 1;
+}
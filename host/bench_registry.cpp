@@ -0,0 +1,99 @@
+/*
+ * bench_registry.cpp
+ * Camera registry lookups with every slot saved and connected. Built once
+ * per MAX_CAMERAS value (bench_registry_<n>), so the figures can be lined
+ * up against the slot count.
+ *
+ *   bench_registry_<n> [--quick]
+ *
+ * findCameraByConnId() is a table lookup and should not move with the slot
+ * count; findCameraSlotByAddress() scans the saved slots.
+ */
+
+#include <chrono>
+
+#include "sketch.h"
+
+namespace {
+
+double wallNs() {
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+volatile uintptr_t sink;  // Keeps the lookups from being optimised away
+
+// Average ns per call of lookup(i) for i = 0 .. iterations - 1
+template <typename Lookup>
+double timeLookups(int iterations, Lookup lookup) {
+  uintptr_t acc = 0;
+  double start = wallNs();
+  for (int i = 0; i < iterations; i++) acc += lookup(i);
+  double ns = (wallNs() - start) / iterations;
+  sink = acc;
+  return ns;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  const int iterations = quick ? 200000 : 20000000;
+
+  // Every slot saved and, but for one connId kept free, on a link
+  initCameraRegistry();
+  const int linked = MAX_CAMERAS < MAX_CONN_IDS ? MAX_CAMERAS : MAX_CONN_IDS - 1;
+  const uint16_t freeConnId = MAX_CONN_IDS - 1;
+  uint16_t connIds[MAX_CAMERAS];
+  uint64_t addresses[MAX_CAMERAS];
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    char name[16];
+    snprintf(name, sizeof(name), "X5 CAM%03d", i);
+    addresses[i] = 0x112233445500ull + i;
+    saveCamera(i + 1, name, addresses[i], 0);
+    if (i >= linked) continue;
+    char text[18];
+    formatAddress(addresses[i], text, sizeof(text));
+    connIds[i] = (uint16_t)(linked - 1 - i);
+    setCameraConnected(i, connIds[i], text);
+  }
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    if ((i < linked && findCameraByConnId(connIds[i]) != &cameras[i]) || findCameraSlotByAddress(addresses[i]) != i) {
+      host::fail("slot %d not found", i);
+    }
+  }
+  if (findCameraByConnId(freeConnId)) host::fail("connId %u should be free", freeConnId);
+
+  // Keys come from tables filled at run time, in a scrambled order, so the
+  // compiler cannot hoist a lookup out of the loop
+  const int keyCount = 1024;
+  static uint16_t hitIds[keyCount];
+  static uint16_t freeIds[keyCount];
+  static uint64_t hitAddresses[keyCount];
+  static uint64_t unknownAddresses[keyCount];
+  for (int k = 0; k < keyCount; k++) {
+    int slot = (k * 7 + k / 3) % MAX_CAMERAS;
+    hitIds[k] = connIds[slot % linked];
+    freeIds[k] = freeConnId;
+    hitAddresses[k] = addresses[slot];
+    unknownAddresses[k] = 0x665544332211ull;  // An unknown device scans every slot
+  }
+
+  double byConnId = timeLookups(iterations, [](int i) {
+    return (uintptr_t)findCameraByConnId(hitIds[i & (keyCount - 1)]);
+  });
+  double byConnIdMiss = timeLookups(iterations, [](int i) {
+    return (uintptr_t)findCameraByConnId(freeIds[i & (keyCount - 1)]);
+  });
+  double byAddress = timeLookups(iterations, [](int i) {
+    return (uintptr_t)findCameraSlotByAddress(hitAddresses[i & (keyCount - 1)]);
+  });
+  double byAddressMiss = timeLookups(iterations, [](int i) {
+    return (uintptr_t)findCameraSlotByAddress(unknownAddresses[i & (keyCount - 1)]);
+  });
+
+  host::serialClear();
+  printf("registry: MAX_CAMERAS=%-2d by connId %.1f ns (free id %.1f ns), by address %.1f ns (unknown %.1f ns)\n",
+         MAX_CAMERAS, byConnId, byConnIdMiss, byAddress, byAddressMiss);
+  return 0;
+}
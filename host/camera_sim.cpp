@@ -0,0 +1,180 @@
+/*
+ * camera_sim.cpp
+ * Simulated Insta360 camera
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "camera_sim.h"
+
+namespace {
+
+const uint8_t CMD_SHUTTER = 1;
+const uint8_t CMD_POWER_OFF = 2;
+const uint8_t timerFrameType = 0x10;
+
+// Wake payload position in the remote's iBeacon manufacturer data
+const size_t wakeOffset = 14;
+
+// Inside a scan window the camera catches each of the remote's advertising
+// events, this far apart
+const uint32_t wakeListenStepMs = 20;
+
+}  // namespace
+
+SimCamera::SimCamera(const char* name, const uint8_t bda[6], uint8_t addrType)
+    : name(name), addrType(addrType) {
+  memcpy(this->bda, bda, 6);
+  memset(wakePayload, 0, sizeof(wakePayload));
+  seed = bda[5] * 2654435761u + 1;
+}
+
+void SimCamera::attach() {
+  if (attached) return;
+  attached = true;
+  connectAtUs = autoConnect ? host::nowUs() : UINT64_MAX;
+  host::addSource(this);
+  host::addNotifyListener(onNotify, this);
+}
+
+void SimCamera::detach() {
+  if (!attached) return;
+  attached = false;
+  host::removeSource(this);
+  host::removeNotifyListener(this);
+}
+
+uint32_t SimCamera::jitter() {
+  if (jitterMs == 0) return 0;
+  seed = seed * 1103515245u + 12345u;
+  return (seed >> 16) % (2 * jitterMs + 1);
+}
+
+void SimCamera::onNotify(uint16_t connId, const uint8_t* data, size_t len, void* ctx) {
+  SimCamera* camera = (SimCamera*)ctx;
+  if ((int)connId != camera->connId || len != 9) return;
+  // FC EF FE 86 00 03 01 <a> <b>
+  uint8_t command = 0;
+  if (data[7] == 0x02 && data[8] == 0x00) command = CMD_SHUTTER;
+  if (data[7] == 0x00 && data[8] == 0x03) command = CMD_POWER_OFF;
+  if (!command) return;
+  if (camera->missCommands > 0) {
+    camera->missCommands--;
+    return;
+  }
+
+  camera->lastCommandUs = host::nowUs();
+  if (command == CMD_SHUTTER) camera->shutters++;
+  else camera->powerOffs++;
+  camera->pendingCommand = command;
+  camera->pendingAtUs = host::nowUs() + (uint64_t)camera->latencyMs * 1000;
+}
+
+void SimCamera::dropLink() {
+  if (connId < 0) return;
+  host::disconnect(connId, 0x13);
+  connId = -1;
+  connectAtUs = host::nowUs() + (uint64_t)reconnectMs * 1000;
+}
+
+void SimCamera::powerOff() {
+  if (recording) {
+    recording = false;
+    recordingChangedUs = host::nowUs();
+  }
+  packetAtUs = UINT64_MAX;
+  poweredOff = true;
+  if (connId >= 0) host::disconnect(connId, 0x13);
+  connId = -1;
+  connectAtUs = UINT64_MAX;
+  wakeWindowStartUs = 0;
+  wakeScanAtUs = host::nowUs() + (uint64_t)(wakeScanMs + wakeScanPhaseMs) * 1000;
+}
+
+uint64_t SimCamera::nextEventUs() {
+  // The remote may have dropped the link
+  if (connId >= 0 && !host::linkUp(connId)) {
+    connId = -1;
+    connectAtUs = autoConnect ? host::nowUs() + (uint64_t)reconnectMs * 1000 : UINT64_MAX;
+  }
+  uint64_t next = pendingAtUs;
+  if (connId < 0 && !poweredOff && connectAtUs < next) next = connectAtUs;
+  if (connId >= 0 && recording && packetAtUs < next) next = packetAtUs;
+  if (poweredOff && wakeScanAtUs < next) next = wakeScanAtUs;
+  return next;
+}
+
+void SimCamera::sendTimerPacket(uint64_t now) {
+  uint32_t seconds = (uint32_t)((now - recordingStartUs) / 1000000);
+  uint8_t packet[6 + 12];
+  char clock[13];
+  snprintf(clock, sizeof(clock), "REC %02u:%02u:%02u", seconds / 3600 % 100, seconds / 60 % 60, seconds % 60);
+  packet[0] = 0xFC;
+  packet[1] = 0xEF;
+  packet[2] = 0xFE;
+  packet[3] = timerFrameType;
+  packet[4] = 0;
+  packet[5] = 12;
+  memcpy(packet + 6, clock, 12);
+  host::write(connId, packet, sizeof(packet));
+  timerPackets++;
+}
+
+void SimCamera::fire(uint64_t now) {
+  if (pendingAtUs <= now) {
+    uint8_t command = pendingCommand;
+    pendingAtUs = UINT64_MAX;
+    pendingCommand = 0;
+    if (command == CMD_POWER_OFF) {
+      powerOff();
+    } else if (command == CMD_SHUTTER && !poweredOff) {
+      recording = !recording;
+      recordingChangedUs = now;
+      if (recording) {
+        recordingStartUs = now;
+        packetAtUs = now;  // First timer packet right away
+      } else {
+        packetAtUs = UINT64_MAX;
+      }
+    }
+    return;
+  }
+
+  if (poweredOff) {
+    if (wakeScanAtUs > now) return;
+    size_t len = 0;
+    const uint8_t* data = host::advertisedManufacturerData(&len);
+    if (host::advertising() && len >= wakeOffset + 6 && memcmp(data + wakeOffset, wakePayload, 6) == 0) {
+      poweredOff = false;
+      wakeScanAtUs = UINT64_MAX;
+      wakeWindowStartUs = 0;
+      connectAtUs = now + (uint64_t)latencyMs * 1000;  // Boot time
+    } else if (wakeScanWindowMs == 0) {
+      wakeScanAtUs = now + (uint64_t)wakeScanMs * 1000;
+    } else {
+      // Keep listening to the end of the window, then sleep to the next one
+      if (wakeWindowStartUs == 0) wakeWindowStartUs = now;
+      uint64_t next = now + (uint64_t)wakeListenStepMs * 1000;
+      if (next < wakeWindowStartUs + (uint64_t)wakeScanWindowMs * 1000) {
+        wakeScanAtUs = next;
+      } else {
+        wakeScanAtUs = wakeWindowStartUs + (uint64_t)wakeScanMs * 1000;
+        wakeWindowStartUs = 0;
+      }
+    }
+    return;
+  }
+
+  if (connId < 0) {
+    if (connectAtUs > now) return;
+    connId = host::connect(bda, addrType);
+    if (connId < 0) connectAtUs = now + (uint64_t)reconnectMs * 1000;
+    return;
+  }
+
+  if (recording && packetAtUs <= now) {
+    sendTimerPacket(now);
+    packetAtUs = now + (uint64_t)(periodMs - jitterMs + jitter()) * 1000;
+  }
+}
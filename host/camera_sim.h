@@ -0,0 +1,72 @@
+/*
+ * camera_sim.h
+ * Simulated Insta360 camera on the other end of the fake BLE links
+ */
+
+#ifndef HOST_CAMERA_SIM_H
+#define HOST_CAMERA_SIM_H
+
+#include "host.h"
+
+// Connects whenever the remote advertises (and lets it in), acts on the
+// shutter and power-off commands after `latencyMs`, and while recording
+// sends a framed timer packet every `periodMs` (+- jitterMs). Powered off,
+// it watches the remote's advertising for its wake payload and comes back.
+class SimCamera : public host::Source {
+  public:
+    SimCamera(const char* name, const uint8_t bda[6], uint8_t addrType = 0);
+    ~SimCamera() { detach(); }
+
+    void attach();  // Join the simulation (connecting starts straight away)
+    void detach();
+
+    // Behaviour, set before attach()
+    const char* name;
+    uint8_t bda[6];
+    uint8_t addrType;
+    uint8_t wakePayload[6];
+    uint32_t latencyMs = 150;       // Command to effect
+    uint32_t periodMs = 1000;       // Timer packet cadence
+    uint32_t jitterMs = 0;
+    uint32_t reconnectMs = 400;     // Retry interval while not connected
+    uint32_t wakeScanMs = 170;      // How often an off camera looks for its wake payload
+                                    // (off the 100 ms payload rotation, so it cannot alias)
+    uint32_t wakeScanWindowMs = 0;  // How long each look listens; 0 samples one instant
+    uint32_t wakeScanPhaseMs = 0;   // Extra delay before the first look after power-off
+    bool autoConnect = true;
+    uint32_t missCommands = 0;      // Commands still to lose, as in a collision on air
+
+    // State
+    int connId = -1;
+    bool recording = false;
+    bool poweredOff = false;
+    uint32_t shutters = 0;          // Shutter commands received
+    uint32_t powerOffs = 0;
+    uint32_t timerPackets = 0;
+    uint64_t lastCommandUs = 0;     // When the last command arrived
+    uint64_t recordingChangedUs = 0;
+
+    // Drop the link from the camera side
+    void dropLink();
+    void powerOff();
+
+    uint64_t nextEventUs() override;
+    void fire(uint64_t now) override;
+
+  private:
+    static void onNotify(uint16_t connId, const uint8_t* data, size_t len, void* ctx);
+    void sendTimerPacket(uint64_t now);
+    uint32_t jitter();
+
+    bool attached = false;
+    uint64_t connectAtUs = 0;
+    uint64_t packetAtUs = UINT64_MAX;
+    uint64_t wakeScanAtUs = UINT64_MAX;
+    uint64_t wakeWindowStartUs = 0;     // Current scan window opened, 0 between windows
+    uint64_t pendingAtUs = UINT64_MAX;  // Queued command takes effect
+    uint8_t pendingCommand = 0;
+    uint64_t recordingStartUs = 0;
+    uint32_t seed;
+};
+
+#endif // HOST_CAMERA_SIM_H
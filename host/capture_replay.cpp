@@ -0,0 +1,255 @@
+/*
+ * capture_replay.cpp
+ * Feeds a session capture (console command 'C') back through the firmware and
+ * compares the recording-state changes it derives with the captured ones
+ *
+ *   capture_replay [-v] [--tolerance <ms>] <serial.log>
+ *
+ * The saved cameras from the capture header are written to NVS and the
+ * sketch is booted. Each connect, disconnect and camera write then reaches
+ * the sketch at its captured time through the fake BLE stack, so it takes the
+ * same path through the BLE callbacks and handle*Event() as on the device.
+ * Commands the remote sent are queued again at their captured time, since a
+ * stop we sent changes how quickly the next stop is recognised. The run
+ * passes if the replay starts and stops the same slots in the same order,
+ * each within the tolerance (250 ms by default) of the captured time.
+ *
+ * Only the first capture in the log is replayed. Start the capture before
+ * the cameras connect: the cadence the firmware learned earlier is not in it.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "sketch.h"
+
+namespace {
+
+struct Record {
+  unsigned long time;
+  uint8_t type;
+  uint8_t conn;
+  uint16_t fullLen;
+  std::vector<uint8_t> data;
+};
+
+struct SavedCamera {
+  int slot;
+  std::string address;
+  std::string name;
+};
+
+struct Capture {
+  std::vector<SavedCamera> cameras;
+  std::vector<Record> records;
+  size_t maxData = CAPTURE_MAX_DATA;
+};
+
+bool readVarint(const std::vector<uint8_t>& raw, size_t* pos, uint32_t* value) {
+  *value = 0;
+  for (int shift = 0; *pos < raw.size() && shift < 35; shift += 7) {
+    uint8_t b = raw[(*pos)++];
+    *value |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+// The first CAPTURE BEGIN ... CAPTURE END in `lines`; anything else in the
+// log is ignored, like tools/capture_decode.py does
+Capture parseCapture(std::istream& lines) {
+  Capture capture;
+  bool inside = false;
+  bool done = false;
+  unsigned long time = 0;
+  std::string line;
+  while (!done && std::getline(lines, line)) {
+    while (!line.empty() && isspace((unsigned char)line.back())) line.pop_back();
+    if (line.compare(0, 13, "CAPTURE BEGIN") == 0) {
+      unsigned long begin = 0;
+      unsigned maxData = CAPTURE_MAX_DATA;
+      if (sscanf(line.c_str(), "CAPTURE BEGIN %lu %u", &begin, &maxData) < 1) continue;
+      inside = true;
+      time = begin;
+      capture.maxData = maxData;
+    } else if (!inside) {
+      continue;
+    } else if (line == "CAPTURE END") {
+      done = true;
+    } else if (line.compare(0, 14, "CAPTURE CAMERA") == 0) {
+      int slot;
+      char address[18];
+      int nameAt = 0;
+      if (sscanf(line.c_str(), "CAPTURE CAMERA %d %17s %n", &slot, address, &nameAt) == 2 && nameAt > 0) {
+        capture.cameras.push_back({slot, address, line.substr(nameAt)});
+      }
+    } else if (line.compare(0, 4, "CAP ") == 0) {
+      std::vector<uint8_t> raw;
+      for (size_t i = 4; i + 1 < line.size(); i += 2) {
+        raw.push_back((uint8_t)strtoul(line.substr(i, 2).c_str(), nullptr, 16));
+      }
+      size_t pos = 0;
+      uint32_t dt, fullLen;
+      if (!readVarint(raw, &pos, &dt) || pos + 2 > raw.size()) continue;
+      Record rec;
+      rec.type = raw[pos];
+      rec.conn = raw[pos + 1];
+      pos += 2;
+      if (!readVarint(raw, &pos, &fullLen)) continue;
+      if (raw.size() - pos != std::min<size_t>(fullLen, capture.maxData)) continue;
+      time += dt;
+      rec.time = time;
+      rec.fullLen = (uint16_t)fullLen;
+      rec.data.assign(raw.begin() + pos, raw.end());
+      capture.records.push_back(rec);
+    }
+  }
+  return capture;
+}
+
+// The recording changes in a capture, relative to `origin`
+struct Change {
+  long at;
+  int slot;
+  bool started;
+};
+
+std::vector<Change> recordingChanges(const Capture& capture, unsigned long origin) {
+  std::vector<Change> changes;
+  for (const Record& rec : capture.records) {
+    if (rec.type != CAPTURE_RECORDING || rec.data.empty()) continue;
+    changes.push_back({(long)(rec.time - origin), rec.conn, rec.data[0] != 0});
+  }
+  return changes;
+}
+
+uint8_t* commandPayload(uint8_t id, size_t* len, const char** name) {
+  *len = 9;
+  switch (id) {
+    case TRACE_CMD_SHUTTER: *name = "SHUTTER (REPLAY)"; return SHUTTER_CMD;
+    case TRACE_CMD_MODE: *name = "MODE (REPLAY)"; return MODE_CMD;
+    case TRACE_CMD_SCREEN: *name = "SCREEN (REPLAY)"; return TOGGLE_SCREEN_CMD;
+    case TRACE_CMD_POWER_OFF: *name = "SLEEP (REPLAY)"; return POWER_OFF_CMD;
+    default: return nullptr;
+  }
+}
+
+int connMap[256];  // Captured connId -> the one the replay got, -1 if none
+
+void replay(const Record& rec) {
+  switch (rec.type) {
+    case CAPTURE_CONNECT:
+      if (rec.data.size() == 6) {
+        connMap[rec.conn] = host::connect(rec.data.data(), 0);
+        if (connMap[rec.conn] < 0) printf("  %lu: connect from conn %u refused in replay\n", host::nowMs(), rec.conn);
+      }
+      break;
+    case CAPTURE_DISCONNECT:
+      if (connMap[rec.conn] >= 0 && host::linkUp(connMap[rec.conn])) host::disconnect(connMap[rec.conn]);
+      connMap[rec.conn] = -1;
+      break;
+    case CAPTURE_WRITE:
+      if (connMap[rec.conn] >= 0) host::write(connMap[rec.conn], rec.data.data(), rec.data.size());
+      break;
+    case CAPTURE_TX: {
+      size_t len;
+      const char* name;
+      uint8_t* payload = rec.data.empty() ? nullptr : commandPayload(rec.data[0], &len, &name);
+      if (!payload) break;
+      uint16_t target = rec.conn == 0xFF ? TX_BROADCAST : (uint16_t)connMap[rec.conn];
+      if (target == TX_BROADCAST || connMap[rec.conn] >= 0) {
+        enqueueTx(target, payload, len, name);
+        signalLoop();
+      }
+      break;
+    }
+    default:
+      break;  // Recording changes are the outcome, not input
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool verbose = false;
+  long tolerance = 250;
+  const char* file = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0) verbose = true;
+    else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) tolerance = atol(argv[++i]);
+    else file = argv[i];
+  }
+  if (!file) {
+    fprintf(stderr, "usage: capture_replay [-v] [--tolerance <ms>] <serial.log>\n");
+    return 2;
+  }
+
+  std::ifstream in(file);
+  if (!in) {
+    fprintf(stderr, "%s: cannot open\n", file);
+    return 2;
+  }
+  Capture reference = parseCapture(in);
+  if (reference.records.empty()) {
+    fprintf(stderr, "%s: no capture found (look for CAPTURE BEGIN ... CAPTURE END)\n", file);
+    return 2;
+  }
+  for (const Record& rec : reference.records) {
+    if (rec.fullLen > rec.data.size()) {
+      printf("warning: a %u byte write was captured as %zu bytes, replaying what was kept\n", rec.fullLen,
+             rec.data.size());
+    }
+  }
+
+  for (const SavedCamera& camera : reference.cameras) {
+    uint64_t address;
+    if (!parseAddress(camera.address.c_str(), &address)) {
+      fprintf(stderr, "%s: bad address %s for camera %d\n", file, camera.address.c_str(), camera.slot);
+      return 2;
+    }
+    saveCamera(camera.slot, camera.name.c_str(), address, ADDR_TYPE_UNKNOWN);
+  }
+  host::serialEcho(verbose);
+  // The capture only holds links the controller let through
+  host::setIgnoreAllowList(true);
+  host::bootSketch();
+  host::runFor(1000);
+
+  // Line the captured times up with the replay clock and schedule the input
+  for (int& id : connMap) id = -1;
+  const unsigned long origin = reference.records.front().time;
+  const unsigned long start = host::nowMs() + 100;
+  for (const Record& rec : reference.records) {
+    host::at(start + (rec.time - origin), [&rec] { replay(rec); });
+  }
+  host::runUntil(start - 1);
+  host::serialClear();
+  setCaptureEnabled(true);
+  host::runUntil(start + (reference.records.back().time - origin) + defaultRecordingTimeout + 1000);
+  setCaptureEnabled(false);
+
+  std::string output(host::serialOutput(), host::serialOutputLength());
+  std::istringstream replayLog(output);
+  Capture replayed = parseCapture(replayLog);
+
+  std::vector<Change> expected = recordingChanges(reference, origin);
+  std::vector<Change> got = recordingChanges(replayed, start);
+  int mismatches = 0;
+  printf("Recording changes (ms from the first record, captured vs replayed):\n");
+  for (size_t i = 0; i < expected.size() || i < got.size(); i++) {
+    const Change* a = i < expected.size() ? &expected[i] : nullptr;
+    const Change* b = i < got.size() ? &got[i] : nullptr;
+    bool match = a && b && a->slot == b->slot && a->started == b->started && labs(a->at - b->at) <= tolerance;
+    if (!match) mismatches++;
+    char left[40] = "-";
+    char right[40] = "-";
+    if (a) snprintf(left, sizeof(left), "%7ld camera %d %s", a->at, a->slot + 1, a->started ? "started" : "stopped");
+    if (b) snprintf(right, sizeof(right), "%7ld camera %d %s", b->at, b->slot + 1, b->started ? "started" : "stopped");
+    printf("  %-28s %-28s%s\n", left, right, match ? "" : "  MISMATCH");
+  }
+  printf("%s: %zu records, %zu recording changes, %d mismatched\n", file, reference.records.size(),
+         expected.size(), mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
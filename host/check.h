@@ -0,0 +1,31 @@
+/*
+ * check.h
+ * Assertions for the host tests
+ */
+
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// A failed check prints where and exits non-zero, which is all ctest needs
+#define CHECK(cond)                                                      \
+  do {                                                                   \
+    if (!(cond)) {                                                       \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      exit(1);                                                           \
+    }                                                                    \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                   \
+  do {                                                                   \
+    long long a_ = (long long)(a), b_ = (long long)(b);                  \
+    if (a_ != b_) {                                                      \
+      fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",  \
+              __FILE__, __LINE__, #a, #b, a_, b_);                       \
+      exit(1);                                                           \
+    }                                                                    \
+  } while (0)
+
+#endif // HOST_CHECK_H
@@ -0,0 +1,154 @@
+/*
+ * Arduino.h (host build)
+ * Arduino core stand-in - fake clock, pins, Serial and String
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Time comes from the fake clock in host.h. delay() advances it (and runs
+// whatever the fake BLE stack has scheduled meanwhile) instead of sleeping.
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+#define IRAM_ATTR
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+// M5StickC pin names (pins_arduino.h of the m5stick-c variant)
+static const uint8_t G0 = 0;
+static const uint8_t G26 = 26;
+static const uint8_t G36 = 36;
+static const uint8_t G37 = 37;
+static const uint8_t G39 = 39;
+
+#define digitalPinToInterrupt(p) (p)
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t level);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+#define DEC 10
+#define HEX 16
+
+// Owning string with the parts of the Arduino String API the sketch and the
+// fake BLE library use. Every non-empty String is one operator new[], so the
+// heap accounting in host.h sees it.
+class String {
+  public:
+    String(const char* text = "") { assign(text, text ? strlen(text) : 0); }
+    String(const char* text, unsigned int len) { assign(text, len); }
+    String(const String& other) { assign(other.buf, other.len); }
+    ~String() { delete[] buf; }
+
+    String& operator=(const String& other) {
+      if (this != &other) {
+        delete[] buf;
+        assign(other.buf, other.len);
+      }
+      return *this;
+    }
+
+    unsigned int length() const { return len; }
+    const char* c_str() const { return buf ? buf : ""; }
+    char operator[](unsigned int i) const { return i < len ? buf[i] : 0; }
+    bool operator==(const String& other) const {
+      return len == other.len && memcmp(c_str(), other.c_str(), len) == 0;
+    }
+    bool operator!=(const String& other) const { return !(*this == other); }
+
+  private:
+    void assign(const char* text, unsigned int n) {
+      len = n;
+      buf = nullptr;
+      if (n == 0) return;
+      buf = new char[n + 1];
+      memcpy(buf, text, n);
+      buf[n] = '\0';
+    }
+
+    char* buf;
+    unsigned int len;
+};
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* data, size_t len) {
+      size_t n = 0;
+      while (len--) n += write(*data++);
+      return n;
+    }
+    size_t write(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+
+    size_t print(const char* text) { return write(text); }
+    size_t print(const String& text) { return write(text.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T& value) { return print(value) + println(); }
+    template <typename T>
+    size_t println(const T& value, int format) { return print(value, format) + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+// Output is kept for tests to read back (host::serialOutput()); input is fed
+// with host::serialInput().
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud) { (void)baud; }
+    int available();
+    int read();
+    int availableForWrite();
+    void flush() {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t len) override;
+    using Print::write;
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// Heap figures from the host allocation accounting (see host.h)
+class EspClass {
+  public:
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+};
+
+extern EspClass ESP;
+
+#include "freertos.h"
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,13 @@
+/*
+ * BLE2902.h (host build)
+ * Client Characteristic Configuration descriptor
+ */
+
+#ifndef HOST_BLE2902_H
+#define HOST_BLE2902_H
+
+#include "BLEDevice.h"
+
+class BLE2902 : public BLEDescriptor {};
+
+#endif // HOST_BLE2902_H
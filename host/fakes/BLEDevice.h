@@ -0,0 +1,246 @@
+/*
+ * BLEDevice.h (host build)
+ * The slice of the ESP32 BLE library and Bluedroid API the sketch uses
+ */
+
+#ifndef HOST_BLEDEVICE_H
+#define HOST_BLEDEVICE_H
+
+#include <Arduino.h>
+
+// Links, scan results and camera writes are driven from host.h; the fake
+// calls the sketch's callbacks the way Bluedroid would, and records every
+// notification, advertising change and allow list update.
+
+typedef uint8_t esp_bd_addr_t[6];
+typedef uint8_t esp_gatt_if_t;
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef enum {
+  ESP_GATTS_REG_EVT = 0,
+  ESP_GATTS_WRITE_EVT = 2,
+  ESP_GATTS_CONNECT_EVT = 14,
+  ESP_GATTS_DISCONNECT_EVT = 15
+} esp_gatts_cb_event_t;
+
+typedef enum {
+  BLE_ADDR_TYPE_PUBLIC = 0,
+  BLE_ADDR_TYPE_RANDOM = 1,
+  BLE_ADDR_TYPE_RPA_PUBLIC = 2,
+  BLE_ADDR_TYPE_RPA_RANDOM = 3
+} esp_ble_addr_type_t;
+
+typedef enum {
+  BLE_WL_ADDR_TYPE_PUBLIC = 0,
+  BLE_WL_ADDR_TYPE_RANDOM = 1
+} esp_ble_wl_addr_type_t;
+
+typedef union {
+  struct {
+    uint16_t status;
+    uint16_t app_id;
+  } reg;
+  struct {
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+  } connect;
+  struct {
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+    int reason;
+  } disconnect;
+  struct {
+    uint16_t conn_id;
+    uint32_t trans_id;
+    esp_bd_addr_t bda;
+    uint16_t handle;
+    uint16_t offset;
+    bool need_rsp;
+    bool is_prep;
+    uint16_t len;
+    uint8_t* value;
+  } write;
+} esp_ble_gatts_cb_param_t;
+
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id, uint16_t attr_handle,
+                                      uint16_t value_len, uint8_t* value, bool need_confirm);
+esp_err_t esp_ble_gap_update_whitelist(bool add, esp_bd_addr_t bda, esp_ble_wl_addr_type_t type);
+esp_err_t esp_ble_gap_clear_whitelist();
+
+class BLEUUID {
+  public:
+    BLEUUID(const char* uuid) { (void)uuid; }
+};
+
+class BLEAddress {
+  public:
+    BLEAddress(const uint8_t* bda) { memcpy(_bda, bda, 6); }
+    esp_bd_addr_t* getNative() { return &_bda; }
+    String toString() const;
+
+  private:
+    esp_bd_addr_t _bda;
+};
+
+// Raw advertisement as the scanner reported it
+class BLEAdvertisedDevice {
+  public:
+    uint8_t* getPayload() { return payload; }
+    size_t getPayloadLength() const { return payloadLen; }
+    BLEAddress getAddress() const { return BLEAddress(address); }
+    esp_ble_addr_type_t getAddressType() const { return addressType; }
+
+    uint8_t payload[31];
+    size_t payloadLen = 0;
+    esp_bd_addr_t address;
+    esp_ble_addr_type_t addressType = BLE_ADDR_TYPE_PUBLIC;
+};
+
+class BLEAdvertisedDeviceCallbacks {
+  public:
+    virtual ~BLEAdvertisedDeviceCallbacks() {}
+    virtual void onResult(BLEAdvertisedDevice device) = 0;
+};
+
+class BLEScanResults {};
+
+class BLEScan {
+  public:
+    void setAdvertisedDeviceCallbacks(BLEAdvertisedDeviceCallbacks* callbacks, bool wantDuplicates = false,
+                                      bool shouldParse = true);
+    void setActiveScan(bool active) { (void)active; }
+    void setInterval(uint16_t interval) { (void)interval; }
+    void setWindow(uint16_t window) { (void)window; }
+    bool start(uint32_t duration, void (*done)(BLEScanResults), bool isContinue = false);
+    void stop();
+
+    // Host side
+    BLEAdvertisedDeviceCallbacks* callbacks = nullptr;
+    bool running = false;
+};
+
+class BLEAdvertisementData {
+  public:
+    void setManufacturerData(const String& data);
+    void setName(const String& name);
+    void setCompleteServices(BLEUUID uuid) { (void)uuid; hasService = true; }
+    void setFlags(uint8_t flags) { (void)flags; }
+
+    uint8_t manufacturerData[31];
+    size_t manufacturerDataLen = 0;
+    char name[32] = "";
+    bool hasService = false;
+};
+
+class BLEAdvertising {
+  public:
+    void addServiceUUID(const char* uuid) { (void)uuid; }
+    void setAdvertisementData(BLEAdvertisementData& data) { this->data = data; }
+    void setScanResponse(bool on) { (void)on; }
+    void setMinPreferred(uint16_t interval) { (void)interval; }
+    void setMinInterval(uint16_t interval) { (void)interval; }
+    void setMaxInterval(uint16_t interval) { (void)interval; }
+    void setScanFilter(bool scanRequestAllowListOnly, bool connectAllowListOnly) {
+      (void)scanRequestAllowListOnly;
+      pendingConnectFilter = connectAllowListOnly;
+    }
+    bool start();
+    void stop();
+
+    // Host side
+    BLEAdvertisementData data;
+    bool running = false;
+    bool connectFilter = false;         // Filter in effect on air
+    bool pendingConnectFilter = false;  // Takes effect at the next start()
+    uint32_t starts = 0;
+};
+
+class BLEDescriptor {
+  public:
+    virtual ~BLEDescriptor() {}
+};
+
+class BLECharacteristic;
+
+class BLECharacteristicCallbacks {
+  public:
+    virtual ~BLECharacteristicCallbacks() {}
+    virtual void onWrite(BLECharacteristic* characteristic, esp_ble_gatts_cb_param_t* param) {
+      (void)param;
+      onWrite(characteristic);
+    }
+    virtual void onWrite(BLECharacteristic* characteristic) { (void)characteristic; }
+};
+
+class BLECharacteristic {
+  public:
+    static const uint32_t PROPERTY_READ = 1 << 0;
+    static const uint32_t PROPERTY_WRITE = 1 << 1;
+    static const uint32_t PROPERTY_NOTIFY = 1 << 2;
+    static const uint32_t PROPERTY_WRITE_NR = 1 << 5;
+
+    void setCallbacks(BLECharacteristicCallbacks* callbacks) { this->callbacks = callbacks; }
+    void addDescriptor(BLEDescriptor* descriptor) { (void)descriptor; }
+    void setValue(uint8_t* data, size_t len);
+    // Notifies every connected client (the fake records one broadcast)
+    void notify(bool isNotification = true);
+    uint16_t getHandle() const { return handle; }
+
+    // Host side
+    BLECharacteristicCallbacks* callbacks = nullptr;
+    uint32_t properties = 0;
+    uint16_t handle = 0;
+    uint8_t value[64];
+    size_t valueLen = 0;
+};
+
+class BLEService {
+  public:
+    BLECharacteristic* createCharacteristic(const char* uuid, uint32_t properties);
+    void start() {}
+
+    // Host side
+    BLECharacteristic characteristics[4];
+    int count = 0;
+};
+
+class BLEServer;
+
+class BLEServerCallbacks {
+  public:
+    virtual ~BLEServerCallbacks() {}
+    virtual void onConnect(BLEServer* server) { (void)server; }
+    virtual void onConnect(BLEServer* server, esp_ble_gatts_cb_param_t* param) { (void)server; (void)param; }
+    virtual void onDisconnect(BLEServer* server) { (void)server; }
+    virtual void onDisconnect(BLEServer* server, esp_ble_gatts_cb_param_t* param) { (void)server; (void)param; }
+};
+
+class BLEServer {
+  public:
+    void setCallbacks(BLEServerCallbacks* callbacks) { this->callbacks = callbacks; }
+    BLEService* createService(const char* uuid);
+    uint32_t getConnectedCount();
+    // Asks the stack to drop a link; onDisconnect follows a little later
+    void disconnect(uint16_t connId);
+
+    // Host side
+    BLEServerCallbacks* callbacks = nullptr;
+    BLEService service;
+    bool serviceCreated = false;
+};
+
+class BLEDevice {
+  public:
+    static void init(String name);
+    static BLEServer* createServer();
+    static BLEScan* getScan();
+    static BLEAdvertising* getAdvertising();
+    static void startAdvertising();
+    static void stopAdvertising();
+    static void setCustomGattsHandler(void (*handler)(esp_gatts_cb_event_t, esp_gatt_if_t, esp_ble_gatts_cb_param_t*));
+};
+
+#endif // HOST_BLEDEVICE_H
@@ -0,0 +1,10 @@
+/*
+ * BLEServer.h (host build)
+ */
+
+#ifndef HOST_BLESERVER_H
+#define HOST_BLESERVER_H
+
+#include "BLEDevice.h"
+
+#endif // HOST_BLESERVER_H
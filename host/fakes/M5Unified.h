@@ -0,0 +1,150 @@
+/*
+ * M5Unified.h (host build)
+ * Panel, canvas, buttons and battery for the host build
+ */
+
+#ifndef HOST_M5UNIFIED_H
+#define HOST_M5UNIFIED_H
+
+#include <Arduino.h>
+
+static constexpr uint16_t BLACK = 0x0000;
+static constexpr uint16_t NAVY = 0x000F;
+static constexpr uint16_t DARKGREEN = 0x03E0;
+static constexpr uint16_t PURPLE = 0x780F;
+static constexpr uint16_t DARKGREY = 0x7BEF;
+static constexpr uint16_t BLUE = 0x001F;
+static constexpr uint16_t GREEN = 0x07E0;
+static constexpr uint16_t CYAN = 0x07FF;
+static constexpr uint16_t RED = 0xF800;
+static constexpr uint16_t MAGENTA = 0xF81F;
+static constexpr uint16_t YELLOW = 0xFFE0;
+static constexpr uint16_t ORANGE = 0xFDA0;
+static constexpr uint16_t WHITE = 0xFFFF;
+
+// RGB565 drawing surface. Every primitive really rasterises into `pixels`,
+// so tests can compare what the sketch drew with what reached the panel.
+// Text uses a made-up 5x7 glyph per character in a 6x8 cell - enough for a
+// changed digit to change pixels, not meant to be read.
+class LovyanGFX : public Print {
+  public:
+    virtual ~LovyanGFX() {}
+
+    int32_t width() const { return _width; }
+    int32_t height() const { return _height; }
+
+    void fillScreen(uint32_t color);
+    void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+    void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+    void fillRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t r, uint32_t color);
+    void drawRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t r, uint32_t color);
+    void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color);
+    void drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color);
+    void drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color);
+    void drawPixel(int32_t x, int32_t y, uint32_t color);
+    void fillCircle(int32_t x, int32_t y, int32_t r, uint32_t color);
+    void drawCircle(int32_t x, int32_t y, int32_t r, uint32_t color);
+    uint16_t readPixel(int32_t x, int32_t y) const;
+
+    void setCursor(int32_t x, int32_t y) { _cursorX = x; _cursorY = y; }
+    void setTextColor(uint32_t fg) { _textFg = fg; _textBgOn = false; }
+    void setTextColor(uint32_t fg, uint32_t bg) { _textFg = fg; _textBg = bg; _textBgOn = true; }
+    void setTextSize(float size) { _textSize = size < 1 ? 1 : (int)(size + 0.5f); }
+    size_t write(uint8_t c) override;
+    using Print::write;
+
+    void setClipRect(int32_t x, int32_t y, int32_t w, int32_t h);
+    void clearClipRect();
+
+    // Host side
+    const uint16_t* pixels() const { return _pixels; }
+    uint32_t primitiveCalls = 0;  // Public drawing calls made on this surface
+    uint32_t pixelWrites = 0;     // Pixels those calls touched
+
+  protected:
+    friend class M5Canvas;  // pushSprite() writes into the target surface
+
+    void setSurface(uint16_t* pixels, int32_t width, int32_t height);
+    void hline(int32_t x, int32_t y, int32_t w, uint16_t color);
+    void plot(int32_t x, int32_t y, uint16_t color);
+
+    uint16_t* _pixels = nullptr;
+    int32_t _width = 0;
+    int32_t _height = 0;
+    int32_t _clipX = 0, _clipY = 0, _clipR = 0, _clipB = 0;  // Right/bottom exclusive
+    int32_t _cursorX = 0, _cursorY = 0;
+    uint16_t _textFg = WHITE, _textBg = BLACK;
+    bool _textBgOn = false;
+    int _textSize = 1;
+};
+
+// The LCD. Counts what is pushed to it the way the SPI bus would see it.
+class M5GFX : public LovyanGFX {
+  public:
+    M5GFX();
+    void setRotation(uint_fast8_t rotation);
+    uint8_t getRotation() const { return _rotation; }
+
+    // Host side
+    void setPanelSize(int32_t width, int32_t height);  // Native (rotation 0) size
+    void notePush(uint32_t pixels);
+    uint32_t pushes = 0;       // Windows written
+    uint32_t bytesPushed = 0;  // RGB565 bytes written through them
+
+  private:
+    int32_t _nativeWidth = 135;
+    int32_t _nativeHeight = 240;
+    uint8_t _rotation = 0;
+};
+
+class M5Canvas : public LovyanGFX {
+  public:
+    M5Canvas() {}
+    explicit M5Canvas(LovyanGFX* parent) { (void)parent; }
+    ~M5Canvas() { deleteSprite(); }
+
+    void setColorDepth(int bits) { (void)bits; }  // Always RGB565
+    void* createSprite(int32_t width, int32_t height);
+    void deleteSprite();
+    void* getBuffer() const { return _pixels; }
+    // Copies the sprite into `dst` at (x, y), limited to dst's clip rect
+    void pushSprite(LovyanGFX* dst, int32_t x, int32_t y);
+};
+
+// Level-based buttons read from the pins in M5.update(), like the real ones
+class Button_Class {
+  public:
+    bool isPressed() const { return _pressed; }
+    bool wasPressed() const { return _pressed && !_wasDown; }
+    bool wasReleased() const { return !_pressed && _wasDown; }
+    bool pressedFor(uint32_t ms) const { return _pressed && millis() - _pressedAt >= ms; }
+
+    void update(bool pressed, unsigned long now);  // Host side, from M5.update()
+
+  private:
+    bool _pressed = false;
+    bool _wasDown = false;
+    unsigned long _pressedAt = 0;
+};
+
+class Power_Class {
+  public:
+    int32_t getBatteryLevel() { return level; }
+    int32_t level = 80;  // Host side
+};
+
+class M5Unified {
+  public:
+    void begin() {}
+    void update();
+
+    M5GFX Display;
+    M5GFX& Lcd = Display;
+    Button_Class BtnA;
+    Button_Class BtnB;
+    Power_Class Power;
+};
+
+extern M5Unified M5;
+
+#endif // HOST_M5UNIFIED_H
@@ -0,0 +1,38 @@
+/*
+ * Preferences.h (host build)
+ * In-memory NVS behind the Arduino Preferences API
+ */
+
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+
+// Behaves like NVS where the sketch can tell: a namespace opened read-only
+// must already exist, a read-write open creates it, values keep their type,
+// and a get into a buffer that is too small fails. host.h counts the flash
+// operations (opens, reads, writes, erases) and lists the namespaces.
+class Preferences {
+  public:
+    ~Preferences() { end(); }
+
+    bool begin(const char* name, bool readOnly = false);
+    void end();
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putBytes(const char* key, const void* value, size_t len);
+    size_t getBytes(const char* key, void* buf, size_t maxLen);
+    size_t getBytesLength(const char* key);
+    size_t putString(const char* key, const char* value);
+    size_t getString(const char* key, char* value, size_t maxLen);
+    size_t putBool(const char* key, bool value);
+    bool getBool(const char* key, bool defaultValue = false);
+
+  private:
+    int _handle = -1;
+    bool _readOnly = true;
+};
+
+#endif // HOST_PREFERENCES_H
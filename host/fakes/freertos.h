@@ -0,0 +1,75 @@
+/*
+ * freertos.h (host build)
+ * The FreeRTOS calls the sketch makes, on top of the fake clock
+ */
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <atomic>
+#include <stdint.h>
+
+typedef void* TaskHandle_t;
+typedef void* QueueHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portYIELD_FROM_ISR(...) ((void)0)
+#define tskIDLE_PRIORITY 0
+#define configMAX_PRIORITIES 25
+
+// Spinlock - on the host the "ISR" and "task" sides may be real threads.
+// Inline, so a test built with TSan sees the acquire and release.
+struct portMUX_TYPE {
+  std::atomic<int> locked;
+};
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+inline void hostEnterCritical(portMUX_TYPE* mux) {
+  int expected = 0;
+  while (!mux->locked.compare_exchange_weak(expected, 1, std::memory_order_acquire)) expected = 0;
+}
+inline void hostExitCritical(portMUX_TYPE* mux) { mux->locked.store(0, std::memory_order_release); }
+#define portENTER_CRITICAL(mux) hostEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) hostExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) hostEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux) hostExitCritical(mux)
+
+// The task running setup()/loop() is the one that moves the fake clock:
+// blocking in ulTaskNotifyTake() is where scheduled BLE/input events fire.
+TaskHandle_t xTaskGetCurrentTaskHandle();
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken);
+void vTaskDelay(TickType_t ticks);
+
+// Task creation fails unless a test calls host::enableTasks(), so the sketch
+// renders from loop() (its fallback for a failed xTaskCreatePinnedToCore).
+// With it, each task is a real thread, and queues and mutexes block.
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name, uint32_t stack, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+BaseType_t xPortGetCoreID();
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks);
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+#endif // HOST_FREERTOS_H
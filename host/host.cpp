@@ -0,0 +1,1333 @@
+/*
+ * host.cpp
+ * Implementation of the host fakes and the control API in host.h
+ */
+
+#include <Arduino.h>
+#include <M5Unified.h>
+#include <BLEDevice.h>
+#include <Preferences.h>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "host.h"
+
+// ---------------------------------------------------------------------------
+// Heap accounting
+//
+// Every operator new goes through malloc() with a small header holding the
+// size, so live and peak bytes can be tracked. Allocations the fakes make for
+// their own bookkeeping are flagged and left out, so they don't show up as
+// sketch heap use or drift. Building with --wrap=malloc (heap probe tests)
+// still sees them all, since they are real malloc() calls.
+
+namespace {
+
+const size_t heapHeader = 16;            // Keeps malloc's alignment
+const uint32_t fakeHeapSize = 320 * 1024;
+
+std::atomic<size_t> liveBytes{0};
+std::atomic<size_t> peakBytes{0};
+std::atomic<uint64_t> allocationCount{0};
+thread_local int untrackedDepth = 0;
+
+struct Untracked {
+  Untracked() { untrackedDepth++; }
+  ~Untracked() { untrackedDepth--; }
+};
+
+void* hostAlloc(size_t size, bool nothrow) {
+  char* block = (char*)malloc(size + heapHeader);
+  if (!block) {
+    if (nothrow) return nullptr;
+    throw std::bad_alloc();
+  }
+  bool tracked = untrackedDepth == 0;
+  ((size_t*)block)[0] = size;
+  ((size_t*)block)[1] = tracked;
+  if (tracked) {
+    size_t live = liveBytes += size;
+    size_t peak = peakBytes.load();
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live)) {}
+    allocationCount++;
+  }
+  return block + heapHeader;
+}
+
+void hostFree(void* ptr) {
+  if (!ptr) return;
+  char* block = (char*)ptr - heapHeader;
+  if (((size_t*)block)[1]) liveBytes -= ((size_t*)block)[0];
+  free(block);
+}
+
+}  // namespace
+
+void* operator new(size_t size) { return hostAlloc(size, false); }
+void* operator new[](size_t size) { return hostAlloc(size, false); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return hostAlloc(size, true); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return hostAlloc(size, true); }
+void operator delete(void* ptr) noexcept { hostFree(ptr); }
+void operator delete[](void* ptr) noexcept { hostFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { hostFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { hostFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { hostFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { hostFree(ptr); }
+
+EspClass ESP;
+
+uint32_t EspClass::getHeapSize() { return fakeHeapSize; }
+uint32_t EspClass::getFreeHeap() { return fakeHeapSize - (uint32_t)liveBytes.load(); }
+uint32_t EspClass::getMinFreeHeap() { return fakeHeapSize - (uint32_t)peakBytes.load(); }
+uint32_t EspClass::getMaxAllocHeap() { return getFreeHeap(); }  // No fragmentation model
+
+size_t host::heapLiveBytes() { return liveBytes; }
+size_t host::heapPeakBytes() { return peakBytes; }
+uint64_t host::heapAllocations() { return allocationCount; }
+
+// ---------------------------------------------------------------------------
+// Clock, events and the loop task
+
+namespace {
+
+// Atomic because task threads (host::enableTasks) read the clock too; only
+// the loop task moves it
+std::atomic<uint64_t> clockUs{0};
+uint64_t sleepLimitUs = UINT64_MAX;
+unsigned long delayedMs = 0;
+std::atomic<uint32_t> notifications{0};
+
+const int maxSources = 16;
+host::Source* sources[maxSources];
+int sourceCount = 0;
+
+// Scripted one-offs; equal times keep insertion order
+std::multimap<uint64_t, std::function<void()>>& scripted() {
+  static std::multimap<uint64_t, std::function<void()>> events;
+  return events;
+}
+
+uint64_t nextLinkCloseUs();
+void fireLinkClose(uint64_t now);
+
+}  // namespace
+
+uint64_t host::nowUs() { return clockUs; }
+unsigned long host::nowMs() { return (unsigned long)(clockUs / 1000); }
+
+void host::fail(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  uint64_t now = clockUs;
+  fprintf(stderr, "FAIL at %llu.%03llu ms: ", (unsigned long long)(now / 1000),
+          (unsigned long long)(now % 1000));
+  vfprintf(stderr, format, args);
+  fputc('\n', stderr);
+  va_end(args);
+  exit(1);
+}
+
+void host::addSource(Source* source) {
+  if (sourceCount == maxSources) fail("too many host sources");
+  sources[sourceCount++] = source;
+}
+
+void host::removeSource(Source* source) {
+  for (int i = 0; i < sourceCount; i++) {
+    if (sources[i] != source) continue;
+    sources[i] = sources[--sourceCount];
+    return;
+  }
+}
+
+void host::at(unsigned long ms, std::function<void()> fn) {
+  Untracked untracked;
+  scripted().emplace((uint64_t)ms * 1000, std::move(fn));
+}
+
+void host::setSleepLimitUs(uint64_t us) { sleepLimitUs = us; }
+uint32_t host::pendingNotifications() { return notifications; }
+
+void host::advanceTo(uint64_t target, bool untilNotified) {
+  int firedHere = 0;
+  for (;;) {
+    // Earliest pending event: scripted, a link teardown, or a source
+    uint64_t next = UINT64_MAX;
+    int which = -3;
+    if (!scripted().empty()) {
+      next = scripted().begin()->first;
+      which = -1;
+    }
+    uint64_t close = nextLinkCloseUs();
+    if (close < next) {
+      next = close;
+      which = -2;
+    }
+    for (int i = 0; i < sourceCount; i++) {
+      uint64_t t = sources[i]->nextEventUs();
+      if (t < next) {
+        next = t;
+        which = i;
+      }
+    }
+    if (next > target) break;
+
+    if (next > clockUs) {
+      clockUs = next;
+      firedHere = 0;
+    } else if (++firedHere > 100000) {
+      fail("events keep firing without the clock moving");
+    }
+
+    if (which == -1) {
+      std::function<void()> fn;
+      {
+        Untracked untracked;
+        auto it = scripted().begin();
+        fn = std::move(it->second);
+        scripted().erase(it);
+      }
+      fn();
+    } else if (which == -2) {
+      fireLinkClose(clockUs);
+    } else {
+      sources[which]->fire(clockUs);
+    }
+    if (untilNotified && notifications > 0) return;
+  }
+  if (target > clockUs && target != UINT64_MAX) clockUs = target;
+}
+
+void host::advance(unsigned long ms) { advanceTo(clockUs + (uint64_t)ms * 1000); }
+unsigned long host::blockedMs() { return delayedMs; }
+
+unsigned long millis() { return (unsigned long)(clockUs / 1000); }
+unsigned long micros() { return (unsigned long)clockUs; }
+void delay(unsigned long ms) {
+  delayedMs += ms;
+  host::advance(ms);
+}
+void yield() {}
+
+// ---------------------------------------------------------------------------
+// FreeRTOS
+//
+// Queues and mutexes share one lock and one condition variable; a fake has
+// no need for anything finer. Blocking only happens once host::enableTasks()
+// has given the sketch real task threads - with the loop task alone, a wait
+// that could never end fails instead.
+
+namespace {
+
+struct FakeQueue;
+
+struct FakeTask {
+  UBaseType_t priority;
+  BaseType_t core;
+  FakeQueue* waitingOn;  // Blocked receiving from this queue, else nullptr
+};
+
+FakeTask loopTask{1, 1, nullptr};  // Arduino runs loop() on core 1
+thread_local FakeTask* currentTask = &loopTask;
+
+struct FakeQueue {
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  UBaseType_t head;
+  UBaseType_t count;
+  uint8_t* items;
+};
+
+struct FakeMutex {
+  bool taken;
+  FakeTask* owner;
+};
+
+// Never destroyed: detached task threads may still be waiting on them while
+// the process exits
+struct Rtos {
+  std::mutex lock;
+  std::condition_variable changed;
+  bool tasksEnabled = false;
+  std::vector<FakeTask*> tasks;
+};
+
+Rtos& rtos() {
+  static Rtos* state = [] {
+    Untracked untracked;
+    return new Rtos;
+  }();
+  return *state;
+}
+
+FakeTask* taskFor(TaskHandle_t task) { return task ? (FakeTask*)task : currentTask; }
+
+// Every task thread waits on an empty queue, so nothing is left for them to
+// do until the loop task posts again. Called with the lock held.
+bool tasksIdle() {
+  for (FakeTask* task : rtos().tasks) {
+    if (!task->waitingOn || task->waitingOn->count > 0) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+void host::enableTasks() {
+  std::lock_guard<std::mutex> lock(rtos().lock);
+  rtos().tasksEnabled = true;
+}
+
+void host::waitTasksIdle() {
+  std::unique_lock<std::mutex> lock(rtos().lock);
+  rtos().changed.wait(lock, tasksIdle);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return (TaskHandle_t)currentTask;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  if (notifications == 0) {
+    // The other tasks run in real time; let them finish what the loop task
+    // gave them before its sleep jumps the clock
+    host::waitTasksIdle();
+    uint64_t target = ticks == portMAX_DELAY ? UINT64_MAX : clockUs + (uint64_t)ticks * 1000;
+    if (target > sleepLimitUs) target = sleepLimitUs;
+    if (target < clockUs) target = clockUs;
+    host::advanceTo(target, true);
+  }
+  uint32_t taken = notifications;
+  if (clearOnExit) notifications = 0;
+  else if (taken) notifications--;
+  return taken;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  (void)task;
+  notifications++;
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken) {
+  (void)task;
+  notifications++;
+  if (woken) *woken = pdFALSE;
+}
+
+void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+// Fails unless host::enableTasks() was called, so the sketch renders from
+// loop() (the fallback it already has for a failed xTaskCreatePinnedToCore)
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name, uint32_t stack, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+  (void)stack;
+  Untracked untracked;
+  FakeTask* created = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(rtos().lock);
+    if (rtos().tasksEnabled) {
+      created = new FakeTask{priority, core, nullptr};
+      rtos().tasks.push_back(created);
+    }
+  }
+  if (handle) *handle = created;
+  if (!created) return pdFAIL;
+
+  std::string taskName(name);
+  std::thread([task, arg, created, taskName] {
+    currentTask = created;
+    task(arg);
+    host::fail("task %s returned", taskName.c_str());
+  }).detach();
+  return pdPASS;
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority) {
+  std::lock_guard<std::mutex> lock(rtos().lock);
+  taskFor(task)->priority = priority;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(rtos().lock);
+  return taskFor(task)->priority;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  (void)task;
+  return 0;
+}
+
+BaseType_t xPortGetCoreID() { return currentTask->core; }
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  FakeQueue* queue = new FakeQueue{length, itemSize, 0, 0, new uint8_t[length * itemSize]};
+  return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void* item, TickType_t ticks) {
+  (void)ticks;
+  FakeQueue* queue = (FakeQueue*)handle;
+  std::lock_guard<std::mutex> lock(rtos().lock);
+  if (queue->count == queue->length) return pdFAIL;
+  UBaseType_t slot = (queue->head + queue->count) % queue->length;
+  memcpy(queue->items + slot * queue->itemSize, item, queue->itemSize);
+  queue->count++;
+  rtos().changed.notify_all();
+  return pdPASS;
+}
+
+namespace {
+
+// With the lock held: wait for an item if `ticks` allows and a task thread
+// could post one, then copy out the head
+bool queueFront(std::unique_lock<std::mutex>& lock, FakeQueue* queue, void* item, TickType_t ticks) {
+  if (queue->count == 0 && ticks == portMAX_DELAY && rtos().tasksEnabled) {
+    currentTask->waitingOn = queue;
+    rtos().changed.notify_all();
+    rtos().changed.wait(lock, [queue] { return queue->count > 0; });
+    currentTask->waitingOn = nullptr;
+  }
+  if (queue->count == 0) return false;
+  memcpy(item, queue->items + queue->head * queue->itemSize, queue->itemSize);
+  return true;
+}
+
+}  // namespace
+
+BaseType_t xQueuePeek(QueueHandle_t handle, void* item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(rtos().lock);
+  return queueFront(lock, (FakeQueue*)handle, item, ticks) ? pdPASS : pdFAIL;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void* item, TickType_t ticks) {
+  FakeQueue* queue = (FakeQueue*)handle;
+  std::unique_lock<std::mutex> lock(rtos().lock);
+  if (!queueFront(lock, queue, item, ticks)) return pdFAIL;
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  rtos().changed.notify_all();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle) {
+  std::lock_guard<std::mutex> lock(rtos().lock);
+  return ((FakeQueue*)handle)->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new FakeMutex{false, nullptr}; }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t handle, TickType_t ticks) {
+  FakeMutex* mutex = (FakeMutex*)handle;
+  std::unique_lock<std::mutex> lock(rtos().lock);
+  if (mutex->taken && mutex->owner == currentTask) host::fail("mutex taken twice by one task");
+  if (mutex->taken && ticks == 0) return pdFAIL;
+  // Any other timeout waits it out: the holder gives it back in real time,
+  // not on the fake clock
+  rtos().changed.wait(lock, [mutex] { return !mutex->taken; });
+  mutex->taken = true;
+  mutex->owner = currentTask;
+  return pdPASS;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t handle) {
+  FakeMutex* mutex = (FakeMutex*)handle;
+  std::lock_guard<std::mutex> lock(rtos().lock);
+  if (!mutex->taken || mutex->owner != currentTask) return pdFAIL;
+  mutex->taken = false;
+  mutex->owner = nullptr;
+  rtos().changed.notify_all();
+  return pdPASS;
+}
+
+// ---------------------------------------------------------------------------
+// Pins
+
+namespace {
+
+const int pinCount = 40;
+int pinLevel[pinCount];
+void (*pinHandler[pinCount])(void);
+int pinMode_[pinCount];
+
+struct PinDefaults {
+  PinDefaults() {
+    for (int i = 0; i < pinCount; i++) pinLevel[i] = LOW;
+    pinLevel[0] = HIGH;   // G0 hardware pullup
+    pinLevel[37] = HIGH;  // Buttons are active low
+    pinLevel[39] = HIGH;
+  }
+} pinDefaults;
+
+}  // namespace
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < pinCount) pinMode_[pin] = mode;
+}
+
+int digitalRead(uint8_t pin) { return pin < pinCount ? pinLevel[pin] : LOW; }
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin < pinCount) pinLevel[pin] = level ? HIGH : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+  if (pin >= pinCount) return;
+  pinHandler[pin] = handler;
+  pinMode_[pin] = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < pinCount) pinHandler[pin] = nullptr;
+}
+
+void host::setPin(uint8_t pin, int level) {
+  if (pin >= pinCount) fail("no pin %u", pin);
+  level = level ? HIGH : LOW;
+  int old = pinLevel[pin];
+  pinLevel[pin] = level;
+  if (!pinHandler[pin] || old == level) return;
+  int mode = pinMode_[pin];
+  bool rising = level == HIGH;
+  if (mode == CHANGE || (mode == RISING && rising) || (mode == FALLING && !rising)) pinHandler[pin]();
+}
+
+void host::pressButton(uint8_t pin) { setPin(pin, LOW); }
+void host::releaseButton(uint8_t pin) { setPin(pin, HIGH); }
+
+// ---------------------------------------------------------------------------
+// Serial
+
+HardwareSerial Serial;
+
+namespace {
+
+const size_t serialCapacity = 4 << 20;
+char serialOut[serialCapacity + 1];
+size_t serialOutLen = 0;
+bool serialEchoOn = false;
+int serialTxRoom = 4096;
+
+char serialIn[1024];
+size_t serialInHead = 0;
+size_t serialInLen = 0;
+
+}  // namespace
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+size_t HardwareSerial::write(const uint8_t* data, size_t len) {
+  if (serialEchoOn) fwrite(data, 1, len, stdout);
+  if (serialOutLen + len > serialCapacity) {
+    // Keep the newer half
+    size_t keep = serialCapacity / 2;
+    memmove(serialOut, serialOut + serialOutLen - keep, keep);
+    serialOutLen = keep;
+  }
+  if (len > serialCapacity - serialOutLen) len = serialCapacity - serialOutLen;
+  memcpy(serialOut + serialOutLen, data, len);
+  serialOutLen += len;
+  serialOut[serialOutLen] = '\0';
+  return len;
+}
+
+int HardwareSerial::available() { return (int)(serialInLen - serialInHead); }
+
+int HardwareSerial::read() {
+  if (serialInHead == serialInLen) return -1;
+  return (uint8_t)serialIn[serialInHead++];
+}
+
+int HardwareSerial::availableForWrite() { return serialTxRoom; }
+
+void host::serialInput(const char* text) {
+  if (serialInHead == serialInLen) serialInHead = serialInLen = 0;
+  size_t len = strlen(text);
+  if (serialInLen + len > sizeof(serialIn)) fail("serial input overflow");
+  memcpy(serialIn + serialInLen, text, len);
+  serialInLen += len;
+}
+
+const char* host::serialOutput() { return serialOut; }
+size_t host::serialOutputLength() { return serialOutLen; }
+
+void host::serialClear() {
+  serialOutLen = 0;
+  serialOut[0] = '\0';
+}
+
+void host::serialEcho(bool on) { serialEchoOn = on; }
+void host::setSerialTxRoom(int bytes) { serialTxRoom = bytes; }
+
+// ---------------------------------------------------------------------------
+// Print / String
+
+size_t Print::print(long value, int base) {
+  char buf[24];
+  if (base == HEX) snprintf(buf, sizeof(buf), "%lX", (unsigned long)value);
+  else snprintf(buf, sizeof(buf), "%ld", value);
+  return write(buf);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", value);
+  return write(buf);
+}
+
+size_t Print::print(double value, int digits) {
+  char buf[40];
+  snprintf(buf, sizeof(buf), "%.*f", digits, value);
+  return write(buf);
+}
+
+size_t Print::printf(const char* format, ...) {
+  char buf[512];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (len < 0) return 0;
+  if ((size_t)len >= sizeof(buf)) len = sizeof(buf) - 1;
+  return write((const uint8_t*)buf, len);
+}
+
+// ---------------------------------------------------------------------------
+// Display
+
+M5Unified M5;
+
+namespace {
+
+// Made-up 5x7 glyph bits for a character
+bool glyphBit(uint8_t c, int col, int row) {
+  if (c == ' ') return false;
+  uint32_t h = c * 2654435761u;
+  h ^= h >> 15;
+  h *= 0x2c1b3c6du;
+  h ^= h >> 12;
+  int bit = row * 5 + col;
+  if (bit >= 32) h *= 0x9e3779b1u;
+  return (h >> (bit % 32)) & 1;
+}
+
+}  // namespace
+
+void LovyanGFX::setSurface(uint16_t* pixels, int32_t width, int32_t height) {
+  _pixels = pixels;
+  _width = width;
+  _height = height;
+  clearClipRect();
+}
+
+void LovyanGFX::setClipRect(int32_t x, int32_t y, int32_t w, int32_t h) {
+  _clipX = x < 0 ? 0 : x;
+  _clipY = y < 0 ? 0 : y;
+  _clipR = x + w > _width ? _width : x + w;
+  _clipB = y + h > _height ? _height : y + h;
+}
+
+void LovyanGFX::clearClipRect() {
+  _clipX = _clipY = 0;
+  _clipR = _width;
+  _clipB = _height;
+}
+
+void LovyanGFX::plot(int32_t x, int32_t y, uint16_t color) {
+  if (x < _clipX || x >= _clipR || y < _clipY || y >= _clipB || !_pixels) return;
+  _pixels[y * _width + x] = color;
+  pixelWrites++;
+}
+
+void LovyanGFX::hline(int32_t x, int32_t y, int32_t w, uint16_t color) {
+  if (y < _clipY || y >= _clipB || !_pixels) return;
+  int32_t x0 = x < _clipX ? _clipX : x;
+  int32_t x1 = x + w > _clipR ? _clipR : x + w;
+  for (int32_t i = x0; i < x1; i++) _pixels[y * _width + i] = color;
+  if (x1 > x0) pixelWrites += x1 - x0;
+}
+
+void LovyanGFX::fillScreen(uint32_t color) {
+  primitiveCalls++;
+  for (int32_t y = 0; y < _height; y++) hline(0, y, _width, color);
+}
+
+void LovyanGFX::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+  primitiveCalls++;
+  for (int32_t j = 0; j < h; j++) hline(x, y + j, w, color);
+}
+
+void LovyanGFX::drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+  primitiveCalls++;
+  if (w <= 0 || h <= 0) return;
+  hline(x, y, w, color);
+  hline(x, y + h - 1, w, color);
+  for (int32_t j = 1; j < h - 1; j++) {
+    plot(x, y + j, color);
+    plot(x + w - 1, y + j, color);
+  }
+}
+
+void LovyanGFX::fillRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t r, uint32_t color) {
+  (void)r;
+  fillRect(x, y, w, h, color);
+}
+
+void LovyanGFX::drawRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t r, uint32_t color) {
+  (void)r;
+  drawRect(x, y, w, h, color);
+}
+
+void LovyanGFX::drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color) {
+  primitiveCalls++;
+  hline(x, y, w, color);
+}
+
+void LovyanGFX::drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color) {
+  primitiveCalls++;
+  for (int32_t j = 0; j < h; j++) plot(x, y + j, color);
+}
+
+void LovyanGFX::drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color) {
+  primitiveCalls++;
+  int32_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int32_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int32_t err = dx + dy;
+  for (;;) {
+    plot(x0, y0, color);
+    if (x0 == x1 && y0 == y1) break;
+    int32_t e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+void LovyanGFX::drawPixel(int32_t x, int32_t y, uint32_t color) {
+  primitiveCalls++;
+  plot(x, y, color);
+}
+
+void LovyanGFX::fillCircle(int32_t x, int32_t y, int32_t r, uint32_t color) {
+  primitiveCalls++;
+  for (int32_t dy = -r; dy <= r; dy++) {
+    int32_t half = 0;
+    while ((half + 1) * (half + 1) + dy * dy <= r * r) half++;
+    hline(x - half, y + dy, 2 * half + 1, color);
+  }
+}
+
+void LovyanGFX::drawCircle(int32_t x, int32_t y, int32_t r, uint32_t color) {
+  primitiveCalls++;
+  int32_t dx = r, dy = 0, err = 1 - r;
+  while (dx >= dy) {
+    plot(x + dx, y + dy, color); plot(x + dy, y + dx, color);
+    plot(x - dy, y + dx, color); plot(x - dx, y + dy, color);
+    plot(x - dx, y - dy, color); plot(x - dy, y - dx, color);
+    plot(x + dy, y - dx, color); plot(x + dx, y - dy, color);
+    dy++;
+    if (err < 0) err += 2 * dy + 1;
+    else { dx--; err += 2 * (dy - dx) + 1; }
+  }
+}
+
+uint16_t LovyanGFX::readPixel(int32_t x, int32_t y) const {
+  if (x < 0 || x >= _width || y < 0 || y >= _height || !_pixels) return 0;
+  return _pixels[y * _width + x];
+}
+
+size_t LovyanGFX::write(uint8_t c) {
+  if (c == '\r') return 1;
+  if (c == '\n') {
+    _cursorX = 0;
+    _cursorY += 8 * _textSize;
+    return 1;
+  }
+  primitiveCalls++;
+  int s = _textSize;
+  if (_textBgOn) {
+    for (int j = 0; j < 8 * s; j++) hline(_cursorX, _cursorY + j, 6 * s, _textBg);
+  }
+  for (int row = 0; row < 7; row++) {
+    for (int col = 0; col < 5; col++) {
+      if (!glyphBit(c, col, row)) continue;
+      for (int j = 0; j < s; j++) hline(_cursorX + col * s, _cursorY + row * s + j, s, _textFg);
+    }
+  }
+  _cursorX += 6 * s;
+  return 1;
+}
+
+namespace {
+uint16_t panelPixels[240 * 240];
+}
+
+M5GFX::M5GFX() { setSurface(panelPixels, _nativeWidth, _nativeHeight); }
+
+void M5GFX::setPanelSize(int32_t width, int32_t height) {
+  _nativeWidth = width;
+  _nativeHeight = height;
+  setRotation(_rotation);
+}
+
+void M5GFX::setRotation(uint_fast8_t rotation) {
+  _rotation = rotation & 3;
+  bool swap = _rotation & 1;
+  memset(panelPixels, 0, sizeof(panelPixels));
+  setSurface(panelPixels, swap ? _nativeHeight : _nativeWidth, swap ? _nativeWidth : _nativeHeight);
+}
+
+void M5GFX::notePush(uint32_t pixels) {
+  pushes++;
+  bytesPushed += pixels * 2;
+}
+
+void* M5Canvas::createSprite(int32_t width, int32_t height) {
+  deleteSprite();
+  uint16_t* pixels = new (std::nothrow) uint16_t[width * height];
+  if (!pixels) return nullptr;
+  memset(pixels, 0, width * height * sizeof(uint16_t));
+  setSurface(pixels, width, height);
+  return pixels;
+}
+
+void M5Canvas::deleteSprite() {
+  delete[] _pixels;
+  setSurface(nullptr, 0, 0);
+}
+
+void M5Canvas::pushSprite(LovyanGFX* dst, int32_t x, int32_t y) {
+  if (!_pixels) return;
+  M5GFX* panel = dynamic_cast<M5GFX*>(dst);
+  uint32_t pushed = 0;
+  for (int32_t j = 0; j < _height; j++) {
+    for (int32_t i = 0; i < _width; i++) {
+      int32_t dx = x + i, dy = y + j;
+      if (dx < dst->_clipX || dx >= dst->_clipR || dy < dst->_clipY || dy >= dst->_clipB) continue;
+      dst->_pixels[dy * dst->_width + dx] = _pixels[j * _width + i];
+      pushed++;
+    }
+  }
+  if (panel) panel->notePush(pushed);
+}
+
+void Button_Class::update(bool pressed, unsigned long now) {
+  _wasDown = _pressed;
+  _pressed = pressed;
+  if (pressed && !_wasDown) _pressedAt = now;
+}
+
+void M5Unified::update() {
+  unsigned long now = millis();
+  BtnA.update(digitalRead(37) == LOW, now);
+  BtnB.update(digitalRead(39) == LOW, now);
+}
+
+// ---------------------------------------------------------------------------
+// BLE
+
+namespace {
+
+const esp_gatt_if_t gattsIf = 3;
+const int maxLinks = 9;
+const uint64_t linkCloseUs = 30000;  // Local disconnect to onDisconnect
+
+struct Link {
+  bool up;
+  bool closing;
+  uint64_t closeAt;
+  uint8_t bda[6];
+  uint8_t type;
+};
+
+Link links[maxLinks];
+BLEServer server;
+BLEScan scan;
+BLEAdvertising advertisingState;
+void (*gattsHandler)(esp_gatts_cb_event_t, esp_gatt_if_t, esp_ble_gatts_cb_param_t*) = nullptr;
+uint32_t refused = 0;
+bool ignoreAllowList = false;
+
+struct AllowEntry {
+  uint8_t bda[6];
+  uint8_t type;
+};
+const int allowCapacity = 12;
+AllowEntry allowList[allowCapacity];
+int allowCount = 0;
+uint32_t allowErrors = 0;
+
+const size_t maxNotifications = 1 << 16;
+host::Notification notificationLog[maxNotifications];
+size_t notificationTotal = 0;
+
+struct Listener {
+  host::NotifyListener fn;
+  void* ctx;
+};
+const int maxListeners = 8;
+Listener listeners[maxListeners];
+int listenerCount = 0;
+
+uint64_t nextLinkCloseUs() {
+  uint64_t next = UINT64_MAX;
+  for (int i = 0; i < maxLinks; i++) {
+    if (links[i].closing && links[i].closeAt < next) next = links[i].closeAt;
+  }
+  return next;
+}
+
+void fireLinkClose(uint64_t now) {
+  for (int i = 0; i < maxLinks; i++) {
+    if (links[i].closing && links[i].closeAt <= now) {
+      host::disconnect(i, 0x16);  // Terminated by local host
+      return;
+    }
+  }
+}
+
+bool allowed(const uint8_t* bda, uint8_t type) {
+  for (int i = 0; i < allowCount; i++) {
+    if (memcmp(allowList[i].bda, bda, 6) == 0 && allowList[i].type == (type & 1)) return true;
+  }
+  return false;
+}
+
+// Record and deliver one notification; connId 0xFFFF goes to every link
+void sendNotification(uint16_t connId, const uint8_t* data, size_t len) {
+  host::Notification& note = notificationLog[notificationTotal % maxNotifications];
+  note.us = clockUs;
+  note.connId = connId;
+  note.len = len > sizeof(note.data) ? sizeof(note.data) : len;
+  memcpy(note.data, data, note.len);
+  notificationTotal++;
+
+  for (int id = 0; id < maxLinks; id++) {
+    if (!links[id].up || (connId != 0xFFFF && connId != id)) continue;
+    for (int l = 0; l < listenerCount; l++) listeners[l].fn(id, data, len, listeners[l].ctx);
+  }
+}
+
+}  // namespace
+
+String BLEAddress::toString() const {
+  char text[18];
+  snprintf(text, sizeof(text), "%02x:%02x:%02x:%02x:%02x:%02x", _bda[0], _bda[1], _bda[2], _bda[3], _bda[4],
+           _bda[5]);
+  return String(text);
+}
+
+void BLEScan::setAdvertisedDeviceCallbacks(BLEAdvertisedDeviceCallbacks* callbacks, bool wantDuplicates,
+                                           bool shouldParse) {
+  (void)wantDuplicates;
+  (void)shouldParse;
+  this->callbacks = callbacks;
+}
+
+bool BLEScan::start(uint32_t duration, void (*done)(BLEScanResults), bool isContinue) {
+  (void)duration;
+  (void)done;
+  (void)isContinue;
+  running = true;
+  return true;
+}
+
+void BLEScan::stop() { running = false; }
+
+void BLEAdvertisementData::setManufacturerData(const String& data) {
+  manufacturerDataLen = data.length() > sizeof(manufacturerData) ? sizeof(manufacturerData) : data.length();
+  memcpy(manufacturerData, data.c_str(), manufacturerDataLen);
+}
+
+void BLEAdvertisementData::setName(const String& name) { snprintf(this->name, sizeof(this->name), "%s", name.c_str()); }
+
+bool BLEAdvertising::start() {
+  running = true;
+  connectFilter = pendingConnectFilter;
+  starts++;
+  return true;
+}
+
+void BLEAdvertising::stop() { running = false; }
+
+void BLECharacteristic::setValue(uint8_t* data, size_t len) {
+  valueLen = len > sizeof(value) ? sizeof(value) : len;
+  memcpy(value, data, valueLen);
+}
+
+void BLECharacteristic::notify(bool isNotification) {
+  (void)isNotification;
+  sendNotification(0xFFFF, value, valueLen);
+}
+
+BLECharacteristic* BLEService::createCharacteristic(const char* uuid, uint32_t properties) {
+  (void)uuid;
+  if (count == 4) return nullptr;
+  BLECharacteristic* characteristic = &characteristics[count];
+  characteristic->properties = properties;
+  characteristic->handle = 42 + 2 * count;
+  count++;
+  return characteristic;
+}
+
+BLEService* BLEServer::createService(const char* uuid) {
+  (void)uuid;
+  serviceCreated = true;
+  return &service;
+}
+
+uint32_t BLEServer::getConnectedCount() {
+  uint32_t count = 0;
+  for (int i = 0; i < maxLinks; i++) count += links[i].up;
+  return count;
+}
+
+void BLEServer::disconnect(uint16_t connId) {
+  if (connId >= maxLinks || !links[connId].up || links[connId].closing) return;
+  links[connId].closing = true;
+  links[connId].closeAt = clockUs + linkCloseUs;
+}
+
+void BLEDevice::init(String name) { (void)name; }
+
+BLEServer* BLEDevice::createServer() {
+  if (gattsHandler) {
+    esp_ble_gatts_cb_param_t param;
+    memset(&param, 0, sizeof(param));
+    gattsHandler(ESP_GATTS_REG_EVT, gattsIf, &param);
+  }
+  return &server;
+}
+
+BLEScan* BLEDevice::getScan() { return &scan; }
+BLEAdvertising* BLEDevice::getAdvertising() { return &advertisingState; }
+void BLEDevice::startAdvertising() { advertisingState.start(); }
+void BLEDevice::stopAdvertising() { advertisingState.stop(); }
+
+void BLEDevice::setCustomGattsHandler(void (*handler)(esp_gatts_cb_event_t, esp_gatt_if_t,
+                                                      esp_ble_gatts_cb_param_t*)) {
+  gattsHandler = handler;
+}
+
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id, uint16_t attr_handle,
+                                      uint16_t value_len, uint8_t* value, bool need_confirm) {
+  (void)attr_handle;
+  (void)need_confirm;
+  if (gatts_if != gattsIf || conn_id >= maxLinks || !links[conn_id].up) return ESP_FAIL;
+  sendNotification(conn_id, value, value_len);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_update_whitelist(bool add, esp_bd_addr_t bda, esp_ble_wl_addr_type_t type) {
+  // The controller refuses list changes while a filter policy uses the list
+  if (advertisingState.running && advertisingState.connectFilter) {
+    allowErrors++;
+    return ESP_FAIL;
+  }
+  for (int i = 0; i < allowCount; i++) {
+    if (memcmp(allowList[i].bda, bda, 6) != 0 || allowList[i].type != type) continue;
+    if (!add) allowList[i] = allowList[--allowCount];
+    return ESP_OK;
+  }
+  if (!add) return ESP_OK;
+  if (allowCount == allowCapacity) return ESP_FAIL;
+  memcpy(allowList[allowCount].bda, bda, 6);
+  allowList[allowCount].type = type;
+  allowCount++;
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_clear_whitelist() {
+  if (advertisingState.running && advertisingState.connectFilter) {
+    allowErrors++;
+    return ESP_FAIL;
+  }
+  allowCount = 0;
+  return ESP_OK;
+}
+
+int host::connect(const uint8_t bda[6], uint8_t addrType) {
+  if (!advertisingState.running ||
+      (advertisingState.connectFilter && !ignoreAllowList && !allowed(bda, addrType))) {
+    refused++;
+    return -1;
+  }
+  int id = 0;
+  while (id < maxLinks && (links[id].up || links[id].closing)) id++;
+  if (id == maxLinks) {
+    refused++;
+    return -1;
+  }
+  advertisingState.running = false;  // The controller stops advertising on connect
+
+  Link& link = links[id];
+  link.up = true;
+  link.closing = false;
+  memcpy(link.bda, bda, 6);
+  link.type = addrType;
+
+  esp_ble_gatts_cb_param_t param;
+  memset(&param, 0, sizeof(param));
+  param.connect.conn_id = id;
+  memcpy(param.connect.remote_bda, bda, 6);
+  if (server.callbacks) {
+    server.callbacks->onConnect(&server);
+    server.callbacks->onConnect(&server, &param);
+  }
+  if (gattsHandler) gattsHandler(ESP_GATTS_CONNECT_EVT, gattsIf, &param);
+  return id;
+}
+
+void host::disconnect(uint16_t connId, int reason) {
+  if (connId >= maxLinks || !links[connId].up) return;
+  Link& link = links[connId];
+  link.up = false;
+  link.closing = false;
+
+  esp_ble_gatts_cb_param_t param;
+  memset(&param, 0, sizeof(param));
+  param.disconnect.conn_id = connId;
+  param.disconnect.reason = reason;
+  memcpy(param.disconnect.remote_bda, link.bda, 6);
+  if (server.callbacks) {
+    server.callbacks->onDisconnect(&server);
+    server.callbacks->onDisconnect(&server, &param);
+  }
+  if (gattsHandler) gattsHandler(ESP_GATTS_DISCONNECT_EVT, gattsIf, &param);
+}
+
+bool host::write(uint16_t connId, const uint8_t* data, size_t len) {
+  if (connId >= maxLinks || !links[connId].up) return false;
+  static uint8_t value[512];
+  if (len > sizeof(value)) fail("write of %zu bytes is longer than an ATT value", len);
+  memcpy(value, data, len);
+
+  BLEService& service = server.service;
+  for (int i = 0; i < service.count; i++) {
+    BLECharacteristic& characteristic = service.characteristics[i];
+    if (!characteristic.callbacks || !(characteristic.properties & BLECharacteristic::PROPERTY_WRITE)) continue;
+    esp_ble_gatts_cb_param_t param;
+    memset(&param, 0, sizeof(param));
+    param.write.conn_id = connId;
+    param.write.handle = characteristic.handle;
+    param.write.len = len;
+    param.write.value = value;
+    memcpy(param.write.bda, links[connId].bda, 6);
+    characteristic.callbacks->onWrite(&characteristic, &param);
+    return true;
+  }
+  return false;
+}
+
+void host::advertise(const char* name, const uint8_t bda[6], uint8_t addrType) {
+  if (!scan.running || !scan.callbacks) return;
+  BLEAdvertisedDevice device;
+  size_t nameLen = strlen(name);
+  if (nameLen > sizeof(device.payload) - 5) nameLen = sizeof(device.payload) - 5;
+  uint8_t* p = device.payload;
+  *p++ = 2;      // Flags
+  *p++ = 0x01;
+  *p++ = 0x06;
+  *p++ = nameLen + 1;
+  *p++ = 0x09;   // Complete local name
+  memcpy(p, name, nameLen);
+  device.payloadLen = 5 + nameLen;
+  memcpy(device.address, bda, 6);
+  device.addressType = (esp_ble_addr_type_t)addrType;
+  scan.callbacks->onResult(device);
+}
+
+bool host::linkUp(uint16_t connId) { return connId < maxLinks && links[connId].up; }
+
+int host::linkCount() { return (int)server.getConnectedCount(); }
+uint32_t host::refusedConnects() { return refused; }
+void host::setIgnoreAllowList(bool on) { ignoreAllowList = on; }
+bool host::advertising() { return advertisingState.running; }
+bool host::advertisingFiltered() { return advertisingState.running && advertisingState.connectFilter; }
+
+const uint8_t* host::advertisedManufacturerData(size_t* len) {
+  *len = advertisingState.data.manufacturerDataLen;
+  return advertisingState.data.manufacturerData;
+}
+
+bool host::scanning() { return scan.running; }
+int host::allowListSize() { return allowCount; }
+bool host::onAllowList(const uint8_t bda[6], uint8_t wlType) { return allowed(bda, wlType); }
+uint32_t host::allowListErrors() { return allowErrors; }
+
+size_t host::notificationCount() { return notificationTotal; }
+
+const host::Notification& host::notification(size_t index) {
+  if (index >= notificationTotal || notificationTotal - index > maxNotifications) fail("notification %zu is gone", index);
+  return notificationLog[index % maxNotifications];
+}
+
+void host::addNotifyListener(NotifyListener fn, void* ctx) {
+  if (listenerCount == maxListeners) fail("too many notify listeners");
+  listeners[listenerCount++] = {fn, ctx};
+}
+
+void host::removeNotifyListener(void* ctx) {
+  for (int i = 0; i < listenerCount; i++) {
+    if (listeners[i].ctx != ctx) continue;
+    listeners[i] = listeners[--listenerCount];
+    return;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// NVS
+
+namespace {
+
+enum NvsType : uint8_t { NVS_U8, NVS_STR, NVS_BLOB };
+
+struct NvsEntry {
+  NvsType type;
+  std::vector<uint8_t> bytes;
+};
+
+struct NvsNamespace {
+  std::string name;
+  std::map<std::string, NvsEntry> entries;
+};
+
+std::vector<NvsNamespace>& nvs() {
+  static std::vector<NvsNamespace> namespaces;
+  return namespaces;
+}
+
+host::NvsStats nvsCounters;
+
+NvsEntry* nvsFind(int handle, const char* key, NvsType type) {
+  if (handle < 0 || !key) return nullptr;
+  auto& entries = nvs()[handle].entries;
+  auto it = entries.find(key);
+  if (it == entries.end() || it->second.type != type) return nullptr;
+  return &it->second;
+}
+
+size_t nvsPut(int handle, bool readOnly, const char* key, NvsType type, const void* data, size_t len) {
+  if (handle < 0 || readOnly || !key || strlen(key) > 15) return 0;
+  Untracked untracked;
+  nvsCounters.writes++;
+  NvsEntry& entry = nvs()[handle].entries[key];
+  entry.type = type;
+  entry.bytes.assign((const uint8_t*)data, (const uint8_t*)data + len);
+  return len;
+}
+
+}  // namespace
+
+bool Preferences::begin(const char* name, bool readOnly) {
+  if (_handle >= 0 || !name || strlen(name) > 15) return false;
+  nvsCounters.opens++;
+  Untracked untracked;
+  auto& namespaces = nvs();
+  for (size_t i = 0; i < namespaces.size(); i++) {
+    if (namespaces[i].name != name) continue;
+    _handle = (int)i;
+    _readOnly = readOnly;
+    return true;
+  }
+  if (readOnly) return false;  // NVS_READONLY on a namespace that isn't there
+  namespaces.push_back(NvsNamespace{name, {}});
+  _handle = (int)namespaces.size() - 1;
+  _readOnly = false;
+  return true;
+}
+
+void Preferences::end() { _handle = -1; }
+
+bool Preferences::clear() {
+  if (_handle < 0 || _readOnly) return false;
+  Untracked untracked;
+  nvsCounters.erases++;
+  nvs()[_handle].entries.clear();
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  if (_handle < 0 || _readOnly || !key) return false;
+  Untracked untracked;
+  nvsCounters.erases++;
+  return nvs()[_handle].entries.erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+  if (_handle < 0 || !key) return false;
+  nvsCounters.reads++;
+  Untracked untracked;
+  return nvs()[_handle].entries.count(key) > 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+  return nvsPut(_handle, _readOnly, key, NVS_BLOB, value, len);
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  if (_handle < 0) return 0;
+  nvsCounters.reads++;
+  Untracked untracked;
+  NvsEntry* entry = nvsFind(_handle, key, NVS_BLOB);
+  return entry ? entry->bytes.size() : 0;
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+  if (_handle < 0) return 0;
+  nvsCounters.reads++;
+  Untracked untracked;
+  NvsEntry* entry = nvsFind(_handle, key, NVS_BLOB);
+  if (!entry || !buf || entry->bytes.size() > maxLen) return 0;
+  memcpy(buf, entry->bytes.data(), entry->bytes.size());
+  return entry->bytes.size();
+}
+
+size_t Preferences::putString(const char* key, const char* value) {
+  return nvsPut(_handle, _readOnly, key, NVS_STR, value, strlen(value) + 1);
+}
+
+size_t Preferences::getString(const char* key, char* value, size_t maxLen) {
+  if (_handle < 0) return 0;
+  nvsCounters.reads++;
+  Untracked untracked;
+  NvsEntry* entry = nvsFind(_handle, key, NVS_STR);
+  if (!entry || !value || !maxLen || entry->bytes.size() > maxLen) return 0;
+  memcpy(value, entry->bytes.data(), entry->bytes.size());
+  return entry->bytes.size();
+}
+
+size_t Preferences::putBool(const char* key, bool value) {
+  uint8_t byte = value ? 1 : 0;
+  return nvsPut(_handle, _readOnly, key, NVS_U8, &byte, 1);
+}
+
+bool Preferences::getBool(const char* key, bool defaultValue) {
+  if (_handle < 0) return defaultValue;
+  nvsCounters.reads++;
+  Untracked untracked;
+  NvsEntry* entry = nvsFind(_handle, key, NVS_U8);
+  return entry ? entry->bytes[0] != 0 : defaultValue;
+}
+
+host::NvsStats host::nvsStats() { return nvsCounters; }
+
+bool host::nvsHasNamespace(const char* name) {
+  Untracked untracked;
+  for (const NvsNamespace& ns : nvs()) {
+    if (ns.name == name) return true;
+  }
+  return false;
+}
+
+int host::nvsNamespaceCount() { return (int)nvs().size(); }
+
+void host::nvsErase() {
+  Untracked untracked;
+  nvs().clear();
+}
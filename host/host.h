@@ -0,0 +1,143 @@
+/*
+ * host.h
+ * Test-side control of the host build - clock, pins, BLE links, NVS, heap
+ */
+
+#ifndef HOST_HOST_H
+#define HOST_HOST_H
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+// The sketch runs single-threaded against the fakes in host/fakes. Time only
+// moves when the sketch sleeps (ulTaskNotifyTake, delay) or a test advances
+// it, and whatever would have happened on the other tasks meanwhile - BLE
+// callbacks, trigger pin edges, camera packets - runs at that point, in time
+// order. Runs are therefore exactly repeatable.
+//
+// A test that calls enableTasks() before booting gets the render task on a
+// thread of its own instead. The clock still only moves with the loop task,
+// which lets the other tasks go idle first each time it sleeps.
+
+namespace host {
+
+// ---- Clock and events ----
+
+uint64_t nowUs();
+unsigned long nowMs();
+
+// Move the clock to `us`, firing every event due on the way. With
+// `untilNotified`, stops right after an event that woke the loop task.
+void advanceTo(uint64_t us, bool untilNotified = false);
+void advance(unsigned long ms);
+// Total time the sketch has spent blocked in delay()
+unsigned long blockedMs();
+
+// Something running beside the sketch (a simulated camera, a soak driver).
+// Polled for its next event; never allocates, so it is safe in heap tests.
+class Source {
+  public:
+    virtual ~Source() {}
+    virtual uint64_t nextEventUs() = 0;  // UINT64_MAX for nothing pending
+    virtual void fire(uint64_t now) = 0;
+};
+void addSource(Source* source);
+void removeSource(Source* source);
+
+// One-off scripted event at an absolute time. Allocates - schedule up front.
+void at(unsigned long ms, std::function<void()> fn);
+
+// ulTaskNotifyTake() never sleeps past this; set by the run helpers
+void setSleepLimitUs(uint64_t us);
+// Pending task notifications for the loop task
+uint32_t pendingNotifications();
+
+// xTaskCreatePinnedToCore() starts a real thread from now on
+void enableTasks();
+// Block until every task thread waits on an empty queue
+void waitTasksIdle();
+
+// Print a message and exit(1)
+void fail(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+// ---- Pins ----
+
+// Sets an input level and runs the attached ISR if the edge matches its
+// mode. Pins idle LOW, except G0 and the buttons (37, 39) which idle HIGH.
+void setPin(uint8_t pin, int level);
+void pressButton(uint8_t pin);    // 37 = A, 39 = B
+void releaseButton(uint8_t pin);
+
+// ---- Serial ----
+
+void serialInput(const char* text);
+const char* serialOutput();  // Everything written since serialClear()
+size_t serialOutputLength();
+void serialClear();
+void serialEcho(bool on);    // Copy output to stdout as well
+void setSerialTxRoom(int bytes);
+
+// ---- BLE ----
+
+// A central (camera) connects. Refused (-1) unless advertising is on and,
+// with the connect filter set, the address is on the allow list.
+int connect(const uint8_t bda[6], uint8_t addrType);
+void disconnect(uint16_t connId, int reason = 0x13);
+// Camera writes to the remote's write characteristic
+bool write(uint16_t connId, const uint8_t* data, size_t len);
+// A scan result, delivered if the sketch is scanning
+void advertise(const char* name, const uint8_t bda[6], uint8_t addrType);
+
+bool linkUp(uint16_t connId);
+int linkCount();
+uint32_t refusedConnects();
+void setIgnoreAllowList(bool on);  // Let unknown devices through the filter
+
+bool advertising();
+bool advertisingFiltered();
+const uint8_t* advertisedManufacturerData(size_t* len);
+bool scanning();
+int allowListSize();
+bool onAllowList(const uint8_t bda[6], uint8_t wlType);
+uint32_t allowListErrors();  // Updates the controller would have refused
+
+// Notifications the remote sent: connId is 0xFFFF for notify() to everyone
+struct Notification {
+  uint64_t us;
+  uint16_t connId;
+  uint8_t len;
+  uint8_t data[16];
+};
+size_t notificationCount();
+const Notification& notification(size_t index);
+
+// Called once per receiving link for every notification
+typedef void (*NotifyListener)(uint16_t connId, const uint8_t* data, size_t len, void* ctx);
+void addNotifyListener(NotifyListener fn, void* ctx);
+void removeNotifyListener(void* ctx);
+
+// ---- NVS ----
+
+struct NvsStats {
+  uint32_t opens;
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t erases;
+};
+NvsStats nvsStats();
+bool nvsHasNamespace(const char* name);
+int nvsNamespaceCount();
+void nvsErase();  // Blank flash
+
+// ---- Heap ----
+
+// operator new/delete are replaced to count what the program allocates.
+// ESP.getFreeHeap() is a fixed heap size minus the live bytes.
+size_t heapLiveBytes();
+size_t heapPeakBytes();
+uint64_t heapAllocations();
+
+}  // namespace host
+
+#endif // HOST_HOST_H
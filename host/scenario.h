@@ -0,0 +1,270 @@
+/*
+ * scenario.h
+ * Scripted end-to-end runs of the sketch against simulated cameras
+ */
+
+#ifndef HOST_SCENARIO_H
+#define HOST_SCENARIO_H
+
+#include <string>
+#include <vector>
+
+#include "camera_sim.h"
+#include "sketch.h"
+
+// A scenario is a text file, one statement per line, '#' starts a comment:
+//
+//   camera <id> "<name>" <aa:bb:cc:dd:ee:ff> [random] [saved=<slot>]
+//          [latency=<ms>] [period=<ms>] [jitter=<ms>] [manual]
+//   at <ms> press A|B <hold ms>
+//   at <ms> pin <gpio> <level>
+//   at <ms> serial "<text>"
+//   at <ms> drop|poweroff|mute|connect|scan <camera id>
+//   at <ms> expect recording <camera id> on|off
+//   at <ms> expect connected <camera id> yes|no
+//   at <ms> expect remote recording|connected <count>
+//   at <ms> expect log "<text>"          (anywhere in the output so far)
+//   at <ms> expect saved <slot> <camera id>|none
+//   end <ms>
+//
+// Cameras marked saved=<slot> are written to NVS before boot. The sketch
+// boots at 0 and runs until `end`; the run fails if any expectation does.
+
+class Scenario {
+  public:
+    bool load(const char* path);
+    int run();  // Number of failed expectations (parse errors count as one)
+
+    std::vector<SimCamera*> sims;
+    std::vector<int> cameraIds;
+    unsigned long endMs = 0;
+    int failures = 0;
+    int checks = 0;
+
+  private:
+    struct Step {
+      unsigned long at;
+      std::vector<std::string> args;
+      int line;
+    };
+
+    static std::vector<std::string> tokenize(const std::string& line);
+    SimCamera* camera(const std::string& id, int line);
+    void schedule(const Step& step);
+    void expectFailed(const Step& step, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+    std::vector<Step> steps;
+    std::vector<std::string> names;  // Storage for SimCamera::name
+    std::string path;
+    bool parseError = false;
+};
+
+inline std::vector<std::string> Scenario::tokenize(const std::string& line) {
+  std::vector<std::string> tokens;
+  size_t i = 0;
+  while (i < line.size()) {
+    if (isspace((unsigned char)line[i])) {
+      i++;
+    } else if (line[i] == '#') {
+      break;
+    } else if (line[i] == '"') {
+      size_t end = line.find('"', i + 1);
+      if (end == std::string::npos) end = line.size();
+      tokens.push_back(line.substr(i + 1, end - i - 1));
+      i = end + 1;
+    } else {
+      size_t start = i;
+      while (i < line.size() && !isspace((unsigned char)line[i])) i++;
+      tokens.push_back(line.substr(start, i - start));
+    }
+  }
+  return tokens;
+}
+
+inline bool Scenario::load(const char* file) {
+  path = file;
+  FILE* in = fopen(file, "r");
+  if (!in) {
+    fprintf(stderr, "%s: cannot open\n", file);
+    return false;
+  }
+  names.reserve(64);
+  char buf[512];
+  int lineNo = 0;
+  while (fgets(buf, sizeof(buf), in)) {
+    lineNo++;
+    std::vector<std::string> tokens = tokenize(buf);
+    if (tokens.empty()) continue;
+
+    if (tokens[0] == "camera" && tokens.size() >= 4) {
+      uint64_t address;
+      if (!parseAddress(tokens[3].c_str(), &address)) {
+        fprintf(stderr, "%s:%d: bad address %s\n", file, lineNo, tokens[3].c_str());
+        parseError = true;
+        continue;
+      }
+      uint8_t bda[6];
+      unpackAddress(address, bda);
+      names.push_back(tokens[2]);
+      SimCamera* sim = new SimCamera(names.back().c_str(), bda);
+      size_t nameLen = names.back().size();
+      if (nameLen >= 6) memcpy(sim->wakePayload, names.back().c_str() + nameLen - 6, 6);
+      int saved = 0;
+      for (size_t t = 4; t < tokens.size(); t++) {
+        const std::string& opt = tokens[t];
+        size_t eq = opt.find('=');
+        std::string key = opt.substr(0, eq);
+        unsigned long value = eq == std::string::npos ? 0 : strtoul(opt.c_str() + eq + 1, nullptr, 10);
+        if (key == "random") sim->addrType = BLE_ADDR_TYPE_RANDOM;
+        else if (key == "manual") sim->autoConnect = false;
+        else if (key == "saved") saved = (int)value;
+        else if (key == "latency") sim->latencyMs = value;
+        else if (key == "period") sim->periodMs = value;
+        else if (key == "jitter") sim->jitterMs = value;
+        else {
+          fprintf(stderr, "%s:%d: unknown camera option %s\n", file, lineNo, opt.c_str());
+          parseError = true;
+        }
+      }
+      sims.push_back(sim);
+      cameraIds.push_back(atoi(tokens[1].c_str()));
+      if (saved) {
+        Step step = {0, {"save", std::to_string(saved), tokens[1]}, lineNo};
+        steps.push_back(step);
+      }
+    } else if (tokens[0] == "at" && tokens.size() >= 3) {
+      Step step = {strtoul(tokens[1].c_str(), nullptr, 10), {tokens.begin() + 2, tokens.end()}, lineNo};
+      steps.push_back(step);
+    } else if (tokens[0] == "end" && tokens.size() == 2) {
+      endMs = strtoul(tokens[1].c_str(), nullptr, 10);
+    } else {
+      fprintf(stderr, "%s:%d: cannot parse\n", file, lineNo);
+      parseError = true;
+    }
+  }
+  fclose(in);
+  if (endMs == 0) {
+    fprintf(stderr, "%s: no end time\n", file);
+    parseError = true;
+  }
+  return !parseError;
+}
+
+inline SimCamera* Scenario::camera(const std::string& id, int line) {
+  for (size_t i = 0; i < sims.size(); i++) {
+    if (cameraIds[i] == atoi(id.c_str())) return sims[i];
+  }
+  fprintf(stderr, "%s:%d: no camera %s\n", path.c_str(), line, id.c_str());
+  parseError = true;
+  return nullptr;
+}
+
+inline void Scenario::expectFailed(const Step& step, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "%s:%d: at %lu ms: ", path.c_str(), step.line, step.at);
+  vfprintf(stderr, format, args);
+  fputc('\n', stderr);
+  va_end(args);
+  failures++;
+}
+
+inline void Scenario::schedule(const Step& step) {
+  const std::vector<std::string>& a = step.args;
+  const std::string& verb = a[0];
+
+  if (verb == "press" && a.size() == 3) {
+    uint8_t pin = a[1] == "A" ? BTN_A_PIN : BTN_B_PIN;
+    unsigned long hold = strtoul(a[2].c_str(), nullptr, 10);
+    host::at(step.at, [pin] { host::pressButton(pin); });
+    host::at(step.at + hold, [pin] { host::releaseButton(pin); });
+  } else if (verb == "pin" && a.size() == 3) {
+    uint8_t pin = (uint8_t)atoi(a[1].c_str());
+    int level = atoi(a[2].c_str());
+    host::at(step.at, [pin, level] { host::setPin(pin, level); });
+  } else if (verb == "serial" && a.size() == 2) {
+    std::string text = a[1] + "\n";
+    host::at(step.at, [text] { host::serialInput(text.c_str()); });
+  } else if ((verb == "drop" || verb == "poweroff" || verb == "mute" || verb == "connect" || verb == "scan") &&
+             a.size() == 2) {
+    SimCamera* sim = camera(a[1], step.line);
+    if (!sim) return;
+    host::at(step.at, [sim, verb] {
+      if (verb == "drop") sim->dropLink();
+      else if (verb == "poweroff") sim->powerOff();
+      else if (verb == "mute") sim->periodMs = 3600000;  // Stops the timer packets
+      else if (verb == "connect") sim->connId = host::connect(sim->bda, sim->addrType);
+      else host::advertise(sim->name, sim->bda, sim->addrType);
+    });
+  } else if (verb == "expect" && a.size() >= 3) {
+    const std::string& what = a[1];
+    checks++;
+    if (what == "recording" && a.size() == 4) {
+      SimCamera* sim = camera(a[2], step.line);
+      bool want = a[3] == "on";
+      if (!sim) return;
+      host::at(step.at, [this, step, sim, want] {
+        if (sim->recording != want) expectFailed(step, "camera %s recording is %s", sim->name, sim->recording ? "on" : "off");
+      });
+    } else if (what == "connected" && a.size() == 4) {
+      SimCamera* sim = camera(a[2], step.line);
+      bool want = a[3] == "yes";
+      if (!sim) return;
+      host::at(step.at, [this, step, sim, want] {
+        bool up = sim->connId >= 0 && host::linkUp(sim->connId);
+        if (up != want) expectFailed(step, "camera %s is %sconnected", sim->name, up ? "" : "not ");
+      });
+    } else if (what == "remote" && a.size() == 4) {
+      std::string field = a[2];
+      int want = atoi(a[3].c_str());
+      host::at(step.at, [this, step, field, want] {
+        int got = field == "recording" ? (isRecording ? 1 : 0) : countConnectedCameras();
+        if (got != want) expectFailed(step, "remote %s is %d, expected %d", field.c_str(), got, want);
+      });
+    } else if (what == "log" && a.size() == 3) {
+      std::string text = a[2];
+      host::at(step.at, [this, step, text] {
+        if (!strstr(host::serialOutput(), text.c_str())) expectFailed(step, "no \"%s\" in the log", text.c_str());
+      });
+    } else if (what == "saved" && a.size() == 4) {
+      int slot = atoi(a[2].c_str());
+      SimCamera* sim = a[3] == "none" ? nullptr : camera(a[3], step.line);
+      host::at(step.at, [this, step, slot, sim] {
+        const CameraInfo& saved = ::cameras[slot - 1];
+        bool match = sim ? saved.isValid && saved.address == packAddress(sim->bda) : !saved.isValid;
+        if (!match) expectFailed(step, "slot %d holds %s", slot, saved.isValid ? saved.name : "nothing");
+      });
+    } else {
+      fprintf(stderr, "%s:%d: unknown expectation\n", path.c_str(), step.line);
+      parseError = true;
+    }
+  } else {
+    fprintf(stderr, "%s:%d: unknown step %s\n", path.c_str(), step.line, verb.c_str());
+    parseError = true;
+  }
+}
+
+inline int Scenario::run() {
+  if (parseError) return 1;
+
+  // Cameras the remote already knows
+  for (const Step& step : steps) {
+    if (step.args[0] != "save") continue;
+    SimCamera* sim = camera(step.args[2], step.line);
+    if (sim) saveCamera(atoi(step.args[1].c_str()), sim->name, packAddress(sim->bda), sim->addrType);
+  }
+  host::serialClear();
+
+  for (const Step& step : steps) {
+    if (step.args[0] != "save") schedule(step);
+  }
+  if (parseError) return 1;
+
+  host::bootSketch();
+  for (SimCamera* sim : sims) sim->attach();
+  host::runUntil(endMs);
+  drainLog();
+  return failures;
+}
+
+#endif // HOST_SCENARIO_H
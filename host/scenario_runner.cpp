@@ -0,0 +1,24 @@
+/*
+ * scenario_runner.cpp
+ * Runs one scenario file (see scenario.h) against the sketch
+ *
+ *   scenario_runner [-v] <file.scn>     -v prints the sketch's Serial output
+ */
+
+#include "scenario.h"
+
+int main(int argc, char** argv) {
+  bool verbose = argc > 2 && strcmp(argv[1], "-v") == 0;
+  const char* file = argv[argc - 1];
+  if (argc < 2) {
+    fprintf(stderr, "usage: scenario_runner [-v] <file.scn>\n");
+    return 2;
+  }
+
+  Scenario scenario;
+  if (!scenario.load(file)) return 1;
+  host::serialEcho(verbose);
+  int failures = scenario.run();
+  printf("%s: %d of %d expectations met\n", file, scenario.checks - failures, scenario.checks);
+  return failures == 0 ? 0 : 1;
+}
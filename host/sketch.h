@@ -0,0 +1,48 @@
+/*
+ * sketch.h
+ * The firmware as one translation unit, plus helpers to run it
+ */
+
+#ifndef HOST_SKETCH_H
+#define HOST_SKETCH_H
+
+#include <Arduino.h>
+#include "insta360_m5StickC_remote-main.ino"
+#include "host.h"
+
+namespace host {
+
+// Power on: size the panel for REMOTE_BOARD, then setup()
+inline void bootSketch() {
+  if (REMOTE_BOARD == BOARD_M5STICKC) M5.Display.setPanelSize(80, 160);
+  setup();
+}
+
+// Run loop() until the clock reaches `ms`. loop() only sleeps in
+// waitForEvent(), which is where time moves on; a loop() that keeps
+// returning without sleeping is a busy-wait and fails the run.
+// Returns the number of loop() passes.
+inline uint32_t runUntil(unsigned long ms) {
+  uint32_t passes = 0;
+  setSleepLimitUs((uint64_t)ms * 1000);
+  uint64_t last = nowUs();
+  int spins = 0;
+  while (nowMs() < ms) {
+    loop();
+    passes++;
+    if (nowUs() != last) {
+      last = nowUs();
+      spins = 0;
+    } else if (++spins > 10000) {
+      fail("loop() spins without sleeping");
+    }
+  }
+  setSleepLimitUs(UINT64_MAX);
+  return passes;
+}
+
+inline uint32_t runFor(unsigned long ms) { return runUntil(nowMs() + ms); }
+
+}  // namespace host
+
+#endif // HOST_SKETCH_H
@@ -0,0 +1,130 @@
+/*
+ * test_address.cpp
+ * Camera address packing, parsing and lookup, and the controller's allow
+ * list following the saved cameras through a pairing
+ */
+
+#include "check.h"
+#include "sketch.h"
+
+namespace {
+
+bool parses(const char* text, uint64_t expected) {
+  uint64_t address = 0;
+  return parseAddress(text, &address) && address == expected;
+}
+
+bool rejected(const char* text) {
+  uint64_t address = 0x123456789ABCull;
+  return !parseAddress(text, &address) && address == 0x123456789ABCull;
+}
+
+}  // namespace
+
+int main() {
+  // Pack and unpack are inverse, first byte most significant
+  const uint8_t bda[6] = {0xA4, 0xCF, 0x12, 0x05, 0x9E, 0x01};
+  uint64_t packed = packAddress(bda);
+  CHECK_EQ(packed, 0xA4CF12059E01ull);
+  uint8_t back[6];
+  unpackAddress(packed, back);
+  CHECK(memcmp(back, bda, 6) == 0);
+
+  // Format and parse round-trip, in either case
+  char text[18];
+  formatAddress(packed, text, sizeof(text));
+  CHECK(strcmp(text, "a4:cf:12:05:9e:01") == 0);
+  CHECK(parses(text, packed));
+  CHECK(parses("A4:CF:12:05:9E:01", packed));
+  CHECK(parses("a4:Cf:12:05:9E:01", packed));
+  CHECK(parses("00:00:00:00:00:00", 0));
+  CHECK(parses("ff:ff:ff:ff:ff:ff", 0xFFFFFFFFFFFFull));
+
+  // Exactly two hex digits per byte, colons between, nothing else
+  CHECK(rejected(""));
+  CHECK(rejected(" a4:cf:12:05:9e:01"));
+  CHECK(rejected("a4: cf:12:05:9e:01"));
+  CHECK(rejected(" a:cf:12:05:9e:01"));
+  CHECK(rejected("+a:cf:12:05:9e:01"));
+  CHECK(rejected("-1:cf:12:05:9e:01"));
+  CHECK(rejected("a:cf:12:05:9e:01"));
+  CHECK(rejected("a4c:f:12:05:9e:01"));
+  CHECK(rejected("0x:cf:12:05:9e:01"));
+  CHECK(rejected("a4:cf:12:05:9e:01 "));
+  CHECK(rejected("a4:cf:12:05:9e:01x"));
+  CHECK(rejected("a4:cf:12:05:9e:01:"));
+  CHECK(rejected("a4:cf:12:05:9e:011"));
+  CHECK(rejected("a4:cf:12:05:9e"));
+  CHECK(rejected("a4:cf:12:05:9e:"));
+  CHECK(rejected("a4-cf-12-05-9e-01"));
+  CHECK(rejected("a4:cf:12:05:9e:0g"));
+
+  // Lookup by address: the lowest saved slot wins, cleared slots don't match
+  host::bootSketch();
+  uint64_t other = 0x112233445502ull;
+  saveCamera(1, "X5 AAA111", other, 0);
+  saveCamera(2, "X4 BBB222", packed, 1);
+  CHECK_EQ(findCameraSlotByAddress(packed), 1);
+  CHECK_EQ(findCameraSlotByAddress(other), 0);
+  CHECK_EQ(findCameraSlotByAddress(0x010203040506ull), -1);
+  saveCamera(1, "X4 BBB222", packed, 1);
+  CHECK_EQ(findCameraSlotByAddress(packed), 0);
+  CHECK_EQ(findCameraSlotByAddress(other), -1);
+
+  // Address and address type survive a reload from the settings record
+  saveCamera(1, "X5 AAA111", other, 0);
+  loadAllCameras();
+  CHECK_EQ(cameras[0].address, other);
+  CHECK_EQ(cameras[0].addressType, 0);
+  CHECK_EQ(cameras[1].address, packed);
+  CHECK_EQ(cameras[1].addressType, 1);
+  CHECK_EQ(findCameraSlotByAddress(packed), 1);
+
+  // Outside pairing, advertising only lets the saved cameras in. They were
+  // saved above behind the pairing flow's back, so restart it as pairing does.
+  const uint8_t otherBda[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x02};
+  const uint8_t newBda[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x03};
+  setNormalAdvertising();
+  host::runFor(1000);
+  CHECK(host::advertisingFiltered());
+  CHECK(host::onAllowList(otherBda, BLE_WL_ADDR_TYPE_PUBLIC));
+  CHECK(host::onAllowList(bda, BLE_WL_ADDR_TYPE_RANDOM));
+  CHECK(!host::onAllowList(newBda, BLE_WL_ADDR_TYPE_PUBLIC));
+
+  // Pairing opens advertising to everyone...
+  connectCamera(2);
+  host::runFor(pairingSplashTime + advertisingSettleTime + 100);
+  CHECK(pairingMode);
+  CHECK(host::advertising() && !host::advertisingFiltered());
+
+  // ...and the paired camera replaces slot 2 on the list once it closes
+  host::advertise("X3 CCC333", newBda, BLE_ADDR_TYPE_PUBLIC);
+  CHECK(host::connect(newBda, BLE_ADDR_TYPE_PUBLIC) >= 0);
+  host::runFor(500);
+  CHECK(!pairingMode);
+  CHECK_EQ(findCameraSlotByAddress(packAddress(newBda)), 1);
+  CHECK(host::advertisingFiltered());
+  CHECK(host::onAllowList(newBda, BLE_WL_ADDR_TYPE_PUBLIC));
+  CHECK(host::onAllowList(otherBda, BLE_WL_ADDR_TYPE_PUBLIC));
+  CHECK(!host::onAllowList(bda, BLE_WL_ADDR_TYPE_RANDOM));
+  CHECK(!allowListDirty);
+  CHECK_EQ(host::allowListErrors(), 0u);
+  CHECK_EQ(allowListErrors, 0u);
+
+  // A reload the controller refuses, with the filter in use, is counted and
+  // stays pending until advertising next starts
+  allowListDirty = true;
+  syncAllowList();
+  CHECK_EQ(host::allowListErrors(), 1u);
+  CHECK_EQ(allowListErrors, 1u);
+  CHECK(allowListDirty);
+  setNormalAdvertising();
+  host::runFor(advertisingSettleTime + 10);
+  CHECK(!allowListDirty);
+  CHECK(host::advertisingFiltered());
+  CHECK(host::onAllowList(newBda, BLE_WL_ADDR_TYPE_PUBLIC));
+  CHECK_EQ(host::allowListErrors(), 1u);
+
+  printf("address: ok\n");
+  return 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * test_board.cpp
+ * A 160x80 M5StickC panel under a build for the Plus2 gets the M5StickC
+ * layouts instead of drawing the 240x135 ones off screen
+ */
+
+#include "check.h"
+#include "sketch.h"
+
+static_assert(REMOTE_BOARD == BOARD_M5STICKC_PLUS2, "built for the Plus2");
+
+int main() {
+  M5.Display.setPanelSize(80, 160);
+  setup();
+  host::runFor(1000);  // Log records are written out by loop()
+  CHECK(strstr(host::serialOutput(), "Panel is 160x80, not 240x135 as on the M5StickC Plus2 - using the M5StickC layouts"));
+  CHECK(strstr(host::serialOutput(), "Board: M5StickC\r\n"));
+  CHECK_EQ(layoutBoard, BOARD_M5STICKC);
+  CHECK(layout == &boardLayouts[BOARD_M5STICKC][LAYOUT_HORIZONTAL]);
+  CHECK_EQ(M5.Lcd.width(), 160);
+  CHECK_EQ(gfx->width(), 160);
+  CHECK_EQ(gfx->height(), 80);
+
+  // Turning the layout goes to the portrait layout of the same board
+  saveLayoutPreference(true);
+  applyLayoutRotation();
+  host::runFor(100);
+  CHECK(layout == &boardLayouts[BOARD_M5STICKC][LAYOUT_VERTICAL]);
+  CHECK_EQ(gfx->width(), 80);
+  CHECK_EQ(gfx->height(), 160);
+
+  printf("board: ok\n");
+  return 0;
+}
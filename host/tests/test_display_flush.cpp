@@ -0,0 +1,122 @@
+/*
+ * test_display_flush.cpp
+ * Dirty-tile flush: the panel always ends up matching the frame buffer, and
+ * only the tiles that changed are pushed
+ */
+
+#include "camera_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+namespace {
+
+const uint8_t addr1[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x01};
+
+bool panelMatchesCanvas() {
+  if (M5.Display.width() != canvas.width() || M5.Display.height() != canvas.height()) return false;
+  size_t pixels = (size_t)canvas.width() * canvas.height();
+  return memcmp(M5.Display.pixels(), canvas.getBuffer(), pixels * 2) == 0;
+}
+
+struct FlushResult {
+  uint32_t windows;
+  uint32_t bytes;
+};
+
+// Flush and return what reached the panel, checked against the flush stats
+FlushResult flush() {
+  uint32_t pushes = M5.Display.pushes;
+  uint32_t panelBytes = M5.Display.bytesPushed;
+  uint32_t counted = displayBytesPushed;
+  uint32_t flushes = displayFlushCount;
+  uint32_t fullFrames = displayFullFrameBytes;
+  flushDisplay();
+  CHECK(panelMatchesCanvas());
+  CHECK_EQ(displayFlushCount, flushes + 1);
+  CHECK_EQ(displayFullFrameBytes - fullFrames, (uint32_t)(canvas.width() * canvas.height() * 2));
+  CHECK_EQ(displayBytesPushed - counted, M5.Display.bytesPushed - panelBytes);
+  return {M5.Display.pushes - pushes, M5.Display.bytesPushed - panelBytes};
+}
+
+}  // namespace
+
+int main() {
+  SimCamera cam1("X5 AAA111", addr1);
+  saveCamera(1, cam1.name, packAddress(addr1), 0);
+  host::bootSketch();
+  cam1.attach();
+  host::runFor(3000);
+  CHECK(gfx == &canvas);
+  CHECK(panelMatchesCanvas());
+
+  const int width = canvas.width();
+  const int height = canvas.height();
+  const uint32_t tileBytes = TILE_SIZE * TILE_SIZE * 2;
+
+  // Nothing drawn: nothing pushed
+  FlushResult r = flush();
+  CHECK_EQ(r.windows, 0);
+  CHECK_EQ(r.bytes, 0);
+
+  // One pixel: its tile only
+  canvas.drawPixel(TILE_SIZE + 3, TILE_SIZE + 5, canvas.readPixel(TILE_SIZE + 3, TILE_SIZE + 5) ^ 0xFFFF);
+  r = flush();
+  CHECK_EQ(r.windows, 1);
+  CHECK_EQ(r.bytes, tileBytes);
+
+  // A line across three tiles of one row: merged into a single window
+  canvas.drawFastHLine(2, TILE_SIZE * 2 + 1, TILE_SIZE * 2 + 4, canvas.readPixel(2, TILE_SIZE * 2 + 1) ^ 0xFFFF);
+  r = flush();
+  CHECK_EQ(r.windows, 1);
+  CHECK_EQ(r.bytes, 3 * tileBytes);
+
+  // Two tiles apart in one row, and one in another row: three windows
+  for (int tx : {0, 2}) canvas.drawPixel(tx * TILE_SIZE, 0, canvas.readPixel(tx * TILE_SIZE, 0) ^ 0xFFFF);
+  canvas.drawPixel(0, TILE_SIZE * 3, canvas.readPixel(0, TILE_SIZE * 3) ^ 0xFFFF);
+  r = flush();
+  CHECK_EQ(r.windows, 3);
+  CHECK_EQ(r.bytes, 3 * tileBytes);
+
+  // The bottom-right tile is cut to the panel edge
+  canvas.drawPixel(width - 1, height - 1, canvas.readPixel(width - 1, height - 1) ^ 0xFFFF);
+  r = flush();
+  int edgeW = width - (width - 1) / TILE_SIZE * TILE_SIZE;
+  int edgeH = height - (height - 1) / TILE_SIZE * TILE_SIZE;
+  CHECK_EQ(r.windows, 1);
+  CHECK_EQ(r.bytes, (uint32_t)(edgeW * edgeH * 2));
+
+  // Redrawing the same pixels is not a change
+  canvas.drawPixel(width - 1, height - 1, canvas.readPixel(width - 1, height - 1));
+  CHECK_EQ(flush().bytes, 0);
+
+  // After a rotation or a new frame buffer, everything goes
+  forceFullFlush = true;
+  r = flush();
+  CHECK_EQ(r.bytes, (uint32_t)(width * height * 2));
+  CHECK_EQ(r.windows, (uint32_t)((height + TILE_SIZE - 1) / TILE_SIZE));
+
+  // The recording dashboard: the panel follows every timer update while
+  // only a small share of the frame is sent
+  host::at(host::nowMs() + 10, [] { host::pressButton(BTN_A_PIN); });
+  host::at(host::nowMs() + 90, [] { host::releaseButton(BTN_A_PIN); });
+  host::runFor(1000);
+  CHECK(isRecording);
+  uint32_t pushed = displayBytesPushed;
+  uint32_t fullFrames = displayFullFrameBytes;
+  for (int i = 0; i < 10; i++) {
+    host::runFor(1000);
+    CHECK(panelMatchesCanvas());
+  }
+  CHECK(displayFullFrameBytes > fullFrames);
+  CHECK((displayBytesPushed - pushed) * 10 < displayFullFrameBytes - fullFrames);
+
+  // 'R' reports the same figures
+  host::serialClear();
+  reportTaskStats();
+  CHECK(strstr(host::serialOutput(), "  display "));
+  CHECK(strstr(host::serialOutput(), "as full frames"));
+
+  printf("display flush: ok (%u of %u bytes while recording)\n", displayBytesPushed - pushed,
+         displayFullFrameBytes - fullFrames);
+  return 0;
+}
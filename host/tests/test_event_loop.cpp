@@ -0,0 +1,66 @@
+/*
+ * test_event_loop.cpp
+ * loop() sleeps when idle and reacts to buttons and BLE at the edge
+ */
+
+#include "camera_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+namespace {
+
+const uint8_t addr1[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x01};
+
+// Time of the first notification at or after `from` carrying `command`
+uint64_t notificationUs(size_t from, const uint8_t* command, size_t len) {
+  for (size_t i = from; i < host::notificationCount(); i++) {
+    const host::Notification& note = host::notification(i);
+    if (note.len == len && memcmp(note.data, command, len) == 0) return note.us;
+  }
+  return UINT64_MAX;
+}
+
+}  // namespace
+
+int main() {
+  SimCamera cam1("X5 AAA111", addr1);
+  saveCamera(1, cam1.name, packAddress(addr1), 0);
+  host::bootSketch();
+  cam1.attach();
+  host::runFor(5000);
+  CHECK_EQ(countConnectedCameras(), 1);
+
+  // Idle with a camera connected: one pass per maxIdleWait, not one per 50 ms
+  uint32_t passes = host::runFor(60000);
+  CHECK(passes <= 60000 / maxIdleWait + 5);
+
+  // A short press is acted on at the release edge, not at the next poll
+  unsigned long pressAt = host::nowMs() + 333;
+  unsigned long releaseAt = pressAt + 77;
+  host::at(pressAt, [] { host::pressButton(BTN_A_PIN); });
+  host::at(releaseAt, [] { host::releaseButton(BTN_A_PIN); });
+  size_t notes = host::notificationCount();
+  host::runUntil(releaseAt + 1);
+  CHECK_EQ(notificationUs(notes, SHUTTER_CMD, sizeof(SHUTTER_CMD)), (uint64_t)releaseAt * 1000);
+
+  // The camera's first timer packet (sent as it starts) wakes loop() at once
+  host::runUntil(releaseAt + cam1.latencyMs + 1);
+  CHECK(cam1.recording);
+  CHECK(isRecording);
+  CHECK_EQ(recordingStartTime, releaseAt + cam1.latencyMs);
+
+  // While a button is held loop() re-polls, so a long press fires within one
+  // poll interval of the threshold
+  host::runFor(3000);
+  pressAt = host::nowMs() + 211;
+  host::at(pressAt, [] { host::pressButton(BTN_A_PIN); });
+  host::at(pressAt + 1500, [] { host::releaseButton(BTN_A_PIN); });
+  notes = host::notificationCount();
+  host::runUntil(pressAt + 2000);
+  uint64_t sleepUs = notificationUs(notes, POWER_OFF_CMD, sizeof(POWER_OFF_CMD));
+  CHECK(sleepUs >= (uint64_t)(pressAt + 1000) * 1000);
+  CHECK(sleepUs <= (uint64_t)(pressAt + 1000 + inputPollInterval) * 1000);
+
+  printf("event loop: ok (%u idle passes in 60 s)\n", passes);
+  return 0;
+}
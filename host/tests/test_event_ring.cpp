@@ -0,0 +1,92 @@
+/*
+ * test_event_ring.cpp
+ * BLE event ring with a real producer and consumer thread (built with TSan)
+ */
+
+#include <chrono>
+#include <string.h>
+#include <thread>
+
+#include "check.h"
+#include "events.h"
+
+namespace {
+
+// Every field of an event is derived from its sequence number, so a record
+// read while the producer was still writing it shows up as a mismatch
+void fillEvent(BleEvent* evt, uint32_t seq) {
+  evt->type = BLE_EVT_SCAN_RESULT;
+  evt->connId = (uint16_t)seq;
+  evt->time = seq;
+  for (size_t i = 0; i < sizeof(evt->scan.name); i++) evt->scan.name[i] = (char)(seq * 31 + i);
+  for (int i = 0; i < 6; i++) evt->scan.bda[i] = (uint8_t)(seq >> (i * 4));
+  evt->scan.addrType = (uint8_t)(seq % 4);
+}
+
+bool eventMatches(const BleEvent& evt, uint32_t seq) {
+  BleEvent expected;
+  fillEvent(&expected, seq);
+  return evt.type == expected.type && evt.connId == expected.connId && evt.time == expected.time &&
+         memcmp(evt.scan.name, expected.scan.name, sizeof(expected.scan.name)) == 0 &&
+         memcmp(evt.scan.bda, expected.scan.bda, 6) == 0 && evt.scan.addrType == expected.scan.addrType;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const uint32_t total = argc > 1 ? (uint32_t)atoi(argv[1]) : 200000;
+  uint32_t producerDrops = 0;
+  uint32_t failedReserves = 0;  // Each one counts in bleEventsDropped
+
+  // Producer: like a Bluedroid callback, never waits for the consumer. Odd
+  // sequence numbers (and the last one) are retried until they fit; even
+  // ones are dropped when the ring is full.
+  std::thread producer([&] {
+    for (uint32_t seq = 0; seq < total; seq++) {
+      BleEvent* evt = reserveBleEvent();
+      while (!evt && ((seq & 1) || seq == total - 1)) {
+        failedReserves++;
+        std::this_thread::yield();
+        evt = reserveBleEvent();
+      }
+      if (!evt) {
+        failedReserves++;
+        producerDrops++;
+        continue;
+      }
+      fillEvent(evt, seq);
+      commitBleEvent();
+    }
+  });
+
+  // Consumer: like loop(), drains in order, and now and then falls behind so
+  // the ring fills up
+  uint32_t received = 0;
+  uint32_t torn = 0;
+  uint32_t outOfOrder = 0;
+  int64_t last = -1;
+  for (;;) {
+    BleEvent evt;
+    if (!popBleEvent(&evt)) {
+      if (last == (int64_t)total - 1) break;
+      std::this_thread::yield();
+      continue;
+    }
+    uint32_t seq = (uint32_t)evt.time;
+    if (!eventMatches(evt, seq)) torn++;
+    if ((int64_t)seq <= last) outOfOrder++;
+    last = seq;
+    if (++received % 4096 == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  producer.join();
+
+  CHECK_EQ(torn, 0);
+  CHECK_EQ(outOfOrder, 0);
+  CHECK_EQ(received + producerDrops, total);
+  CHECK_EQ(bleEventsDropped.load(), failedReserves);
+  BleEvent extra;
+  CHECK(!popBleEvent(&extra));
+
+  printf("event ring: %u events, %u received, %u dropped when full\n", total, received, producerDrops);
+  return 0;
+}
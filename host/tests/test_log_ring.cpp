@@ -0,0 +1,104 @@
+/*
+ * test_log_ring.cpp
+ * Log ring with a callback thread logging while loop() drains (built with
+ * TSan)
+ */
+
+#include <atomic>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#include "check.h"
+#include "host.h"
+#include "log.h"
+
+namespace {
+
+// Both numbers and the string derive from the sequence number, so a record
+// read while the producer was still writing it shows up as a mismatch
+uint32_t scramble(uint32_t seq) { return seq * 2654435761u; }
+
+void logSeq(uint32_t seq) {
+  char tag[12];
+  snprintf(tag, sizeof(tag), "t%lu", (unsigned long)(scramble(seq) % 100000));
+  LOGI("seq %lu %lu %s", (unsigned long)seq, (unsigned long)scramble(seq), tag);
+}
+
+// Drain what is queued and tally the lines written
+struct Tally {
+  uint32_t received = 0;
+  uint32_t torn = 0;
+  uint32_t outOfOrder = 0;
+  uint32_t reportedDrops = 0;
+  int64_t last = -1;
+};
+
+void drainAndCheck(Tally& tally) {
+  host::serialClear();
+  drainLog();
+  for (const char* line = host::serialOutput(); *line;) {
+    const char* end = strchr(line, '\n');
+    const char* text = strchr(line, ']');
+    CHECK(end && text);
+    unsigned long seq, scrambled, tag, dropped;
+    if (sscanf(text, "] seq %lu %lu t%lu", &seq, &scrambled, &tag) == 3) {
+      if (scrambled != scramble(seq) || tag != scramble(seq) % 100000) tally.torn++;
+      if ((int64_t)seq <= tally.last) tally.outOfOrder++;
+      tally.last = seq;
+      tally.received++;
+    } else if (sscanf(text, "] Log queue overflow, %lu records dropped", &dropped) == 1) {
+      tally.reportedDrops += dropped;
+    }
+    line = end + 1;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const uint32_t total = argc > 1 ? (uint32_t)atoi(argv[1]) : 50000;
+  std::atomic<bool> done(false);
+
+  // Overfill the queue: what fits comes out, then the count of the rest
+  for (uint32_t seq = 0; seq < LOG_QUEUE_SIZE + 10; seq++) logSeq(seq);
+  Tally burst;
+  drainAndCheck(burst);
+  CHECK_EQ(burst.received, LOG_QUEUE_SIZE);
+  CHECK_EQ(burst.last, LOG_QUEUE_SIZE - 1);
+  CHECK_EQ(burst.reportedDrops, 10);
+  CHECK(!logPending());
+
+  // Producer: like a Bluedroid callback, logs and never waits for loop()
+  std::thread producer([&] {
+    for (uint32_t seq = 0; seq < total; seq++) {
+      logSeq(seq);
+      if (seq % 64 == 0) std::this_thread::yield();
+    }
+    done = true;
+  });
+
+  // Consumer: like loop(), drains whenever it gets round to it, and now and
+  // then falls behind so the ring fills up
+  Tally tally;
+  while (!done || logPending()) {
+    drainAndCheck(tally);
+    if (tally.received % 512 == 0) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    std::this_thread::yield();
+  }
+  producer.join();
+  drainAndCheck(tally);  // The last overflow report
+  drainAndCheck(tally);
+
+  CHECK_EQ(tally.torn, 0);
+  CHECK_EQ(tally.outOfOrder, 0);
+  CHECK(tally.received > 0);
+  // Overflow reports can be dropped too, and then count in the next one
+  CHECK(tally.received + tally.reportedDrops >= total);
+  CHECK(!logPending());
+
+  printf("log ring: %u records, %u drained, %u reported dropped\n", total, tally.received,
+         tally.reportedDrops);
+  return 0;
+}
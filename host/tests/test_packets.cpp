@@ -0,0 +1,158 @@
+/*
+ * test_packets.cpp
+ * Camera packet decoder: a corpus of known packets, then mutations of it
+ * (built with ASan/UBSan, every input in a heap buffer of its exact size)
+ */
+
+#include <string.h>
+#include <vector>
+
+#include "check.h"
+#include "packets.h"
+
+namespace {
+
+struct CorpusEntry {
+  const char* name;
+  std::vector<uint8_t> bytes;
+  PacketKind kind;
+  uint32_t seconds;  // PACKET_TIMER only
+};
+
+std::vector<uint8_t> frame(uint8_t type, const char* text, int lengthAdjust = 0) {
+  size_t len = strlen(text);
+  std::vector<uint8_t> out = {FRAME_MAGIC_0, FRAME_MAGIC_1, FRAME_MAGIC_2, type,
+                              (uint8_t)((len + lengthAdjust) >> 8), (uint8_t)(len + lengthAdjust)};
+  out.insert(out.end(), text, text + len);
+  return out;
+}
+
+std::vector<uint8_t> raw(const char* text, size_t pad = 0) {
+  std::vector<uint8_t> out(pad, 0x01);
+  out.insert(out.end(), text, text + strlen(text));
+  return out;
+}
+
+std::vector<CorpusEntry> corpus() {
+  return {
+      // Framed timer packets as the X-series sends them
+      {"framed mm:ss", frame(0x10, "REC 12:34"), PACKET_TIMER, 12 * 60 + 34},
+      {"framed h:mm:ss", frame(0x10, "REC 1:02:03"), PACKET_TIMER, 3723},
+      {"framed hh:mm:ss", frame(0x10, "REC 00:12:34"), PACKET_TIMER, 754},
+      {"framed 99:59:59", frame(0x10, "99:59:59"), PACKET_TIMER, 99 * 3600 + 59 * 60 + 59},
+      {"clock at the very end", frame(0x10, "xx 0:07"), PACKET_TIMER, 7},
+      // Frames without a clock
+      {"status frame", {0xFC, 0xEF, 0xFE, 0x22, 0x00, 0x04, 0x01, 0x02, 0x03, 0x04}, PACKET_STATUS, 0},
+      {"empty frame", {0xFC, 0xEF, 0xFE, 0x05, 0x00, 0x00}, PACKET_STATUS, 0},
+      {"battery text", frame(0x30, "BAT 87%"), PACKET_STATUS, 0},
+      {"lone colon", frame(0x30, "1:2"), PACKET_STATUS, 0},
+      {"one digit after colon", frame(0x30, "12:3 "), PACKET_STATUS, 0},
+      // Fields after a ':' are minutes/seconds and must be under 60
+      {"seconds 60", frame(0x10, "REC 12:60"), PACKET_STATUS, 0},
+      {"minutes 75", frame(0x10, "REC 1:75:00"), PACKET_STATUS, 0},
+      {"seconds 99 in h:mm:ss", frame(0x10, "REC 1:02:99"), PACKET_STATUS, 0},
+      {"bad clock then good", frame(0x10, "77:88 then 03:04"), PACKET_TIMER, 184},
+      // Declared length disagrees: fall back to the unframed scan
+      {"length short, long clock", frame(0x10, "REC 00:12:34 extra", -6), PACKET_TIMER, 754},
+      {"length long, long clock", frame(0x10, "REC 00:12:34 extra", +40), PACKET_TIMER, 754},
+      {"length wrong, short", frame(0x10, "12:34", +1), PACKET_INVALID, 0},
+      {"length wrong, no clock", frame(0x22, "status only, long enough", -3), PACKET_INVALID, 0},
+      {"header only", {0xFC, 0xEF, 0xFE, 0x10, 0x00}, PACKET_INVALID, 0},
+      {"magic only", {0xFC, 0xEF, 0xFE}, PACKET_INVALID, 0},
+      {"magic prefix", {0xFC, 0xEF}, PACKET_INVALID, 0},
+      {"empty", {}, PACKET_INVALID, 0},
+      // Unframed packets from older firmware
+      {"unframed h:mm:ss", raw("1:23:45", 11), PACKET_TIMER, 5025},
+      {"unframed mm:ss", raw("45:06", 13), PACKET_TIMER, 2706},
+      {"unframed too short", raw("12:34", 4), PACKET_INVALID, 0},
+      {"unframed no clock", raw("no clock in here at all"), PACKET_INVALID, 0},
+      {"unframed out of range", raw("12:61", 13), PACKET_INVALID, 0},
+  };
+}
+
+// Decode from a heap copy of exactly `len` bytes, so ASan catches any read
+// past the end, and check what every decode must satisfy
+PacketKind decodeChecked(const uint8_t* bytes, size_t len, DecodedPacket* packet) {
+  uint8_t* copy = new uint8_t[len ? len : 1];
+  if (len) memcpy(copy, bytes, len);
+  PacketKind kind = decodeCameraPacket(copy, len, packet);
+
+  CHECK(kind == packet->kind);
+  CHECK(kind == PACKET_INVALID || kind == PACKET_TIMER || kind == PACKET_STATUS);
+  if (kind == PACKET_INVALID) {
+    CHECK(packet->payload == nullptr);
+    CHECK_EQ(packet->payloadLen, 0);
+  } else {
+    CHECK(packet->payload >= copy);
+    CHECK(packet->payload + packet->payloadLen <= copy + len);
+  }
+  if (kind == PACKET_TIMER) CHECK(packet->elapsedSeconds <= 99 * 3600 + 59 * 60 + 59);
+  else CHECK_EQ(packet->elapsedSeconds, 0);
+
+  packet->payload = nullptr;  // Points into the copy
+  delete[] copy;
+  return kind;
+}
+
+uint32_t seed = 0x5EED;
+uint32_t nextRandom() {
+  seed = seed * 1103515245u + 12345u;
+  return seed >> 8;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<CorpusEntry> entries = corpus();
+
+  for (const CorpusEntry& entry : entries) {
+    DecodedPacket packet;
+    PacketKind kind = decodeChecked(entry.bytes.data(), entry.bytes.size(), &packet);
+    if (kind != entry.kind || (kind == PACKET_TIMER && packet.elapsedSeconds != entry.seconds)) {
+      fprintf(stderr, "corpus '%s': kind %d seconds %u, expected kind %d seconds %u\n", entry.name, kind,
+              packet.elapsedSeconds, entry.kind, entry.seconds);
+      return 1;
+    }
+  }
+
+  // Mutate corpus entries: flip, replace, insert and delete bytes, splice
+  // two entries, truncate. Only the invariants are checked.
+  const int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+  const uint8_t interesting[] = {0x00, ':', '0', '5', '6', '9', 0xFC, 0xEF, 0xFE, 0xFF};
+  uint32_t kinds[3] = {0, 0, 0};
+  for (int n = 0; n < iterations; n++) {
+    std::vector<uint8_t> input = entries[nextRandom() % entries.size()].bytes;
+    int mutations = 1 + nextRandom() % 4;
+    for (int m = 0; m < mutations; m++) {
+      size_t pos = input.empty() ? 0 : nextRandom() % input.size();
+      switch (nextRandom() % 6) {
+        case 0:
+          if (!input.empty()) input[pos] ^= 1 << (nextRandom() % 8);
+          break;
+        case 1:
+          if (!input.empty()) input[pos] = interesting[nextRandom() % sizeof(interesting)];
+          break;
+        case 2:
+          input.insert(input.begin() + pos, interesting[nextRandom() % sizeof(interesting)]);
+          break;
+        case 3:
+          if (!input.empty()) input.erase(input.begin() + pos);
+          break;
+        case 4: {
+          const std::vector<uint8_t>& other = entries[nextRandom() % entries.size()].bytes;
+          input.insert(input.end(), other.begin(), other.end());
+          break;
+        }
+        default:
+          input.resize(pos);
+          break;
+      }
+    }
+    DecodedPacket packet;
+    kinds[decodeChecked(input.data(), input.size(), &packet)]++;
+  }
+
+  printf("packets: %zu corpus entries ok, %d mutations (invalid %u, timer %u, status %u)\n", entries.size(),
+         iterations, kinds[PACKET_INVALID], kinds[PACKET_TIMER], kinds[PACKET_STATUS]);
+  return 0;
+}
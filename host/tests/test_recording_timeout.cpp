@@ -0,0 +1,107 @@
+/*
+ * test_recording_timeout.cpp
+ * Stop detection from the learned timer-packet cadence, replaying a gap
+ * trace with late packets in it
+ */
+
+#include "camera_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+namespace {
+
+const uint8_t addr1[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x01};
+
+void shortPress() {
+  unsigned long at = host::nowMs() + 10;
+  host::at(at, [] { host::pressButton(BTN_A_PIN); });
+  host::at(at + 80, [] { host::releaseButton(BTN_A_PIN); });
+  host::runUntil(at + 81);
+}
+
+// Inter-arrival times as a camera sends them: 1 s +- 60 ms, and now and then
+// a packet that is held back by a retransmission
+uint32_t traceSeed = 0x7A11;
+uint32_t nextGap() {
+  traceSeed = traceSeed * 1103515245u + 12345u;
+  uint32_t r = traceSeed >> 8;
+  if (r % 40 == 0) return 1500 + r % 300;
+  return 940 + r % 121;
+}
+
+// Let the camera stop on its own (its button, a full card) and time how long
+// the remote takes to notice
+unsigned long stopOnCamera(SimCamera& cam) {
+  cam.recording = false;
+  cam.recordingChangedUs = host::nowUs();
+  unsigned long stoppedAt = host::nowMs();
+  while (cameras[0].isRecording && host::nowMs() < stoppedAt + 10000) host::runFor(10);
+  CHECK(!cameras[0].isRecording);
+  return host::nowMs() - stoppedAt;
+}
+
+// Replay `count` gaps of the trace while recording; returns false on a
+// false stop
+bool replayTrace(SimCamera& cam, int count) {
+  for (int i = 0; i < count; i++) {
+    cam.periodMs = nextGap();
+    uint32_t sent = cam.timerPackets;
+    while (cam.timerPackets == sent) {
+      host::runFor(10);
+      if (!cameras[0].isRecording) return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  SimCamera cam("X5 AAA111", addr1);
+  saveCamera(1, cam.name, packAddress(addr1), 0);
+  host::bootSketch();
+  cam.attach();
+  host::runFor(2000);
+
+  // Nothing learned yet: the fixed timeout
+  shortPress();
+  host::runFor(2000);
+  CHECK(cameras[0].isRecording);
+  CHECK_EQ(recordingTimeout(&cameras[0]), defaultRecordingTimeout);
+  unsigned long unlearned = stopOnCamera(cam);
+  CHECK(unlearned >= defaultRecordingTimeout - 1000);
+  host::serialClear();
+
+  // Learn the cadence from the trace, then keep replaying it: the late
+  // packets stay inside the timeout
+  shortPress();
+  host::runFor(2000);
+  CHECK(cameras[0].isRecording);
+  CHECK(replayTrace(cam, 300));
+  CHECK(cameras[0].timerGapP95 >= 1000);
+  CHECK(!strstr(host::serialOutput(), "recording timeout"));
+  unsigned long timeout = recordingTimeout(&cameras[0]);
+  CHECK(timeout < defaultRecordingTimeout);
+
+  // A stop on the camera is seen within the learned timeout
+  unsigned long learned = stopOnCamera(cam);
+  CHECK(learned <= timeout + cameras[0].timerGapP95);
+  CHECK(learned < unlearned);
+  CHECK(strstr(host::serialOutput(), "Camera 1 recording timeout"));
+
+  // After a stop sent from the remote, one missed packet is enough
+  shortPress();
+  host::runFor(2000);
+  CHECK(replayTrace(cam, 20));
+  cam.periodMs = 1000;
+  unsigned long pressAt = host::nowMs();
+  shortPress();
+  while (cameras[0].isRecording && host::nowMs() < pressAt + 10000) host::runFor(10);
+  CHECK(!cam.recording);
+  unsigned long hinted = host::nowMs() - pressAt;
+  CHECK(hinted < learned);
+
+  printf("recording timeout: ok (stop seen after %lu ms unlearned, %lu ms learned, %lu ms after our own stop)\n",
+         unlearned, learned, hinted);
+  return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * test_registry.cpp
+ * Camera registry with more slots than the two the firmware shipped with
+ * (built with MAX_CAMERAS=4)
+ */
+
+#include "camera_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+static_assert(MAX_CAMERAS == 4, "built with -DMAX_CAMERAS=4");
+
+int main() {
+  const char* names[MAX_CAMERAS] = {"X5 AAA111", "X4 BBB222", "X3 CCC333", "RS DDD444"};
+  SimCamera* sims[MAX_CAMERAS];
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    const uint8_t bda[6] = {0x11, 0x22, 0x33, 0x44, 0x55, (uint8_t)(i + 1)};
+    sims[i] = new SimCamera(names[i], bda);
+    saveCamera(i + 1, names[i], packAddress(bda), 0);
+  }
+  host::bootSketch();
+  for (SimCamera* sim : sims) sim->attach();
+  host::runFor(3000);
+
+  // Every camera is found from its connId, and only from its own
+  CHECK_EQ(countConnectedCameras(), MAX_CAMERAS);
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    CHECK(sims[i]->connId >= 0);
+    CHECK(findCameraByConnId(sims[i]->connId) == &cameras[i]);
+    CHECK_EQ(connIdSlot[sims[i]->connId], i);
+  }
+  CHECK_EQ(checkCameraRegistry(true), 0);
+
+  // Drop and reconnect one in the middle: the old mapping goes, the new one
+  // points at the same slot
+  int oldId = sims[1]->connId;
+  sims[2]->dropLink();
+  sims[1]->dropLink();
+  host::runFor(100);
+  CHECK(findCameraByConnId(oldId) == nullptr);
+  CHECK(!cameras[1].connected);
+  CHECK(!cameras[2].connected);
+  CHECK_EQ(checkCameraRegistry(true), 0);
+  host::runFor(2000);
+  CHECK_EQ(countConnectedCameras(), MAX_CAMERAS);
+  CHECK(findCameraByConnId(sims[1]->connId) == &cameras[1]);
+  CHECK(findCameraByConnId(sims[2]->connId) == &cameras[2]);
+  CHECK_EQ(checkCameraRegistry(true), 0);
+
+  // All of them take part in a start
+  host::at(host::nowMs() + 10, [] { host::pressButton(BTN_A_PIN); });
+  host::at(host::nowMs() + 90, [] { host::releaseButton(BTN_A_PIN); });
+  host::runFor(2000);
+  for (SimCamera* sim : sims) CHECK(sim->recording);
+
+  // IDs beyond the direct table still resolve, through the scan
+  const uint16_t bigId = MAX_CONN_IDS + 3;
+  setCameraConnected(3, bigId, "11:22:33:44:55:04");
+  CHECK(findCameraByConnId(bigId) == &cameras[3]);
+  CHECK(findCameraByConnId(sims[3]->connId) == nullptr);  // Stale mapping dropped
+  CHECK_EQ(clearCameraConnection(bigId), 3);
+  CHECK(findCameraByConnId(bigId) == nullptr);
+  CHECK_EQ(clearCameraConnection(bigId), -1);
+  CHECK_EQ(checkCameraRegistry(true), 0);
+
+  // The same camera saved twice is found in the lowest slot
+  CHECK_EQ(findCameraSlotByAddress(cameras[3].address), 3);
+  saveCamera(4, names[1], cameras[1].address, 0);
+  CHECK_EQ(findCameraSlotByAddress(cameras[1].address), 1);
+
+  printf("registry: ok\n");
+  return 0;
+}
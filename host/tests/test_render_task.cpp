@@ -0,0 +1,117 @@
+/*
+ * test_render_task.cpp
+ * The render task on a thread of its own beside loop(): frames are never
+ * lost, queued frames coalesce, and state frames wait for the control pass
+ * to give up uiStateMutex (built with TSan)
+ */
+
+#include <chrono>
+#include <thread>
+
+#include "camera_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+namespace {
+
+const uint8_t addr1[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x01};
+
+bool panelMatchesCanvas() {
+  if (M5.Display.width() != canvas.width() || M5.Display.height() != canvas.height()) return false;
+  size_t pixels = (size_t)canvas.width() * canvas.height();
+  return memcmp(M5.Display.pixels(), canvas.getBuffer(), pixels * 2) == 0;
+}
+
+// Once the render task is idle, the panel shows the state as it is now:
+// drawing it again pushes nothing
+bool latestFrameShown() {
+  host::waitTasksIdle();
+  if (!panelMatchesCanvas()) return false;
+  uint32_t pushed = displayBytesPushed;
+  RenderRequest req = {};
+  req.kind = RENDER_FRAME;
+  renderNow(req);
+  return displayBytesPushed == pushed;
+}
+
+uint32_t stateFramesDrawn() {
+  return renderStats.requests[RENDER_FRAME] + renderStats.requests[RENDER_TIMER];
+}
+
+void click(uint8_t pin) {
+  host::at(host::nowMs() + 10, [pin] { host::pressButton(pin); });
+  host::at(host::nowMs() + 90, [pin] { host::releaseButton(pin); });
+}
+
+}  // namespace
+
+int main() {
+  SimCamera cam1("X5 AAA111", addr1);
+  saveCamera(1, cam1.name, packAddress(addr1), 0);
+  host::enableTasks();
+  host::bootSketch();
+  cam1.attach();
+  host::runFor(3000);
+  CHECK(renderTaskHandle != nullptr);
+  CHECK(renderQueue != nullptr);
+  CHECK(!strstr(host::serialOutput(), "Render task not started"));
+  CHECK_EQ(countConnectedCameras(), 1);
+  CHECK(latestFrameShown());
+
+  // Recording: loop() posts a timer strip every second and a frame on each
+  // change while the render task draws them on its own thread
+  uint32_t drawn = stateFramesDrawn();
+  click(BTN_A_PIN);
+  host::runFor(1000);
+  CHECK(isRecording);
+  for (int i = 0; i < 10; i++) {
+    host::runFor(1000);
+    CHECK(latestFrameShown());
+  }
+  CHECK(renderStats.requests[RENDER_TIMER] >= 10);
+  CHECK(stateFramesDrawn() > drawn);
+  click(BTN_A_PIN);
+  host::runFor(cam1.latencyMs + 1500);
+  CHECK(!cam1.recording);
+  CHECK(latestFrameShown());
+  CHECK_EQ(renderStats.dropped, 0u);
+
+  // A control pass that posts more than the queue holds. The render task
+  // may take a request off the queue, but it draws no state frame until the
+  // pass hands uiStateMutex back.
+  host::waitTasksIdle();
+  RenderStats before = renderStats;
+  const uint32_t posted = RENDER_QUEUE_DEPTH * 3;
+  beginControlPass();
+  for (uint32_t i = 0; i < posted; i++) postRender(i % 4 == 0 ? RENDER_TIMER : RENDER_FRAME);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CHECK_EQ(stateFramesDrawn(), before.requests[RENDER_FRAME] + before.requests[RENDER_TIMER]);
+  CHECK(renderStats.dropped > before.dropped);
+  CHECK(renderFrameLost);
+  endControlPass();
+
+  // Every request was dropped, skipped for a newer frame or drawn, and the
+  // ones that did not fit cost exactly one more frame once the queue emptied.
+  // How many get drawn depends on when the render task got to the queue.
+  host::waitTasksIdle();
+  CHECK(!renderFrameLost);
+  uint32_t drawnNow = stateFramesDrawn() - before.requests[RENDER_FRAME] - before.requests[RENDER_TIMER];
+  uint32_t coalesced = renderStats.coalesced - before.coalesced;
+  uint32_t dropped = renderStats.dropped - before.dropped;
+  CHECK(coalesced > 0);
+  CHECK_EQ(drawnNow + coalesced + dropped, posted + 1);
+  CHECK(latestFrameShown());
+
+  // loop() and the render task carry on together: screens flipped from the
+  // buttons come out whole and in order
+  for (int i = 0; i < 6; i++) {
+    click(BTN_B_PIN);
+    host::runFor(400);
+    CHECK(latestFrameShown());
+  }
+  CHECK_EQ(renderStats.dropped, before.dropped + dropped);
+
+  printf("render task: ok (%u of %u posted frames dropped, %u coalesced, %u drawn)\n", dropped, posted,
+         coalesced, drawnNow);
+  return 0;
+}
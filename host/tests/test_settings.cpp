@@ -0,0 +1,198 @@
+/*
+ * test_settings.cpp
+ * Settings record: CRC, round trip, rejection of bad records, migration
+ * from the per-camera namespaces and the NVS cost of a boot load (built with
+ * MAX_CAMERAS=6)
+ */
+
+#include "check.h"
+#include "sketch.h"
+
+static_assert(MAX_CAMERAS == 6, "built with -DMAX_CAMERAS=6");
+
+namespace {
+
+void writeLegacyCamera(int cameraNum, const char* name, const char* address) {
+  char namespaceName[12];
+  snprintf(namespaceName, sizeof(namespaceName), "camera%d", cameraNum);
+  Preferences prefs;
+  prefs.begin(namespaceName, false);
+  prefs.putString("name", name);
+  prefs.putString("address", address);
+  prefs.putBytes("wake", name + strlen(name) - 6, 6);
+  prefs.end();
+}
+
+bool namespaceEmpty(const char* name) {
+  Preferences prefs;
+  if (!prefs.begin(name, true)) return true;
+  bool empty = !prefs.isKey("name") && !prefs.isKey("address") && !prefs.isKey("wake") && !prefs.isKey("vert_layout");
+  prefs.end();
+  return empty;
+}
+
+SettingsRecord readRecord() {
+  SettingsRecord record;
+  memset(&record, 0, sizeof(record));
+  Preferences prefs;
+  prefs.begin(SETTINGS_NAMESPACE, true);
+  CHECK_EQ(prefs.getBytes(SETTINGS_KEY, &record, sizeof(record)), sizeof(record));
+  prefs.end();
+  return record;
+}
+
+void writeRecord(const void* record, size_t len) {
+  Preferences prefs;
+  prefs.begin(SETTINGS_NAMESPACE, false);
+  prefs.putBytes(SETTINGS_KEY, record, len);
+  prefs.end();
+}
+
+void reload() {
+  host::serialClear();
+  loadAllCameras();
+}
+
+// NVS operations (opens, gets, puts and erases) fn() costs
+template <typename Fn>
+uint32_t nvsOps(Fn fn) {
+  host::NvsStats before = host::nvsStats();
+  fn();
+  host::NvsStats after = host::nvsStats();
+  return (after.opens - before.opens) + (after.reads - before.reads) + (after.writes - before.writes) +
+         (after.erases - before.erases);
+}
+
+// The boot load before the settings record: a begin/get/end cycle per
+// legacy camera namespace and another for the layout
+void legacyBootLoad() {
+  for (int cameraNum = 1; cameraNum <= LEGACY_CAMERA_SLOTS; cameraNum++) {
+    char namespaceName[12];
+    snprintf(namespaceName, sizeof(namespaceName), "camera%d", cameraNum);
+    char name[30];
+    char address[20];
+    uint8_t wake[6];
+    Preferences prefs;
+    prefs.begin(namespaceName, false);
+    prefs.getString("name", name, sizeof(name));
+    prefs.getString("address", address, sizeof(address));
+    if (prefs.getBytesLength("wake") == 6) prefs.getBytes("wake", wake, 6);
+    prefs.end();
+  }
+  Preferences prefs;
+  prefs.begin("ui_settings", false);
+  prefs.getBool("vert_layout", false);
+  prefs.end();
+}
+
+}  // namespace
+
+int main() {
+  // CRC-32 check value
+  CHECK_EQ(crc32((const uint8_t*)"123456789", 9), 0xCBF43926u);
+
+  // Blank flash: nothing loaded, nothing created
+  reload();
+  CHECK(strstr(host::serialOutput(), "No saved settings"));
+  CHECK_EQ(host::nvsNamespaceCount(), 0);
+  for (int i = 0; i < MAX_CAMERAS; i++) CHECK(!cameras[i].isValid);
+
+  // The two legacy cameras and the layout move into one record; only the
+  // namespaces that were there are touched
+  writeLegacyCamera(1, "X5 AAA111", "a4:cf:12:05:9e:01\r\n");
+  writeLegacyCamera(2, "X4 BBB222", "A4:CF:12:05:9E:02");
+  {
+    Preferences prefs;
+    prefs.begin("ui_settings", false);
+    prefs.putBool("vert_layout", true);
+    prefs.end();
+  }
+  uint32_t legacyOps = nvsOps(legacyBootLoad);
+  reload();
+  CHECK(strstr(host::serialOutput(), "Migrating settings"));
+  CHECK(cameras[0].isValid && cameras[1].isValid);
+  CHECK_EQ(cameras[0].address, 0xA4CF12059E01ull);
+  CHECK_EQ(cameras[1].address, 0xA4CF12059E02ull);
+  CHECK_EQ(cameras[0].addressType, ADDR_TYPE_UNKNOWN);
+  CHECK(memcmp(cameras[1].wakePayload, "BBB222", 6) == 0);
+  for (int i = 2; i < MAX_CAMERAS; i++) CHECK(!cameras[i].isValid);
+  CHECK(isVerticalLayout);
+  CHECK(namespaceEmpty("camera1") && namespaceEmpty("camera2") && namespaceEmpty("ui_settings"));
+  for (int i = 3; i <= MAX_CAMERAS; i++) {
+    char namespaceName[12];
+    snprintf(namespaceName, sizeof(namespaceName), "camera%d", i);
+    CHECK(!host::nvsHasNamespace(namespaceName));
+  }
+  CHECK_EQ(host::nvsNamespaceCount(), 4);  // remote, camera1, camera2, ui_settings
+
+  // The next boot reads the record and migrates nothing, in one open and
+  // one get where the legacy keys took a cycle per namespace
+  host::NvsStats before = host::nvsStats();
+  uint32_t recordOps = nvsOps(reload);
+  CHECK_EQ(host::nvsStats().opens - before.opens, 1u);
+  CHECK_EQ(host::nvsStats().reads - before.reads, 1u);
+  CHECK_EQ(host::nvsStats().writes, before.writes);
+  CHECK(recordOps < legacyOps);
+  CHECK(!strstr(host::serialOutput(), "Migrating"));
+  CHECK(cameras[0].isValid && cameras[1].isValid);
+  CHECK_EQ(cameras[1].address, 0xA4CF12059E02ull);
+  CHECK(isVerticalLayout);
+
+  // Round trip through saveCamera, every slot, with address types
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    char name[16];
+    snprintf(name, sizeof(name), "X5 CAM%03d", i);
+    saveCamera(i + 1, name, 0x112233445500ull + i, (uint8_t)(i % 2));
+  }
+  saveLayoutPreference(false);
+  SettingsRecord saved = readRecord();
+  CHECK_EQ(saved.version, SETTINGS_VERSION);
+  CHECK_EQ(saved.crc, settingsCrc(saved));
+  reload();
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    CHECK(cameras[i].isValid);
+    CHECK_EQ(cameras[i].address, 0x112233445500ull + i);
+    CHECK_EQ(cameras[i].addressType, i % 2);
+  }
+  CHECK(!isVerticalLayout);
+
+  // A flipped bit anywhere before the CRC is caught
+  for (size_t byte = 0; byte < offsetof(SettingsRecord, crc); byte += 7) {
+    SettingsRecord corrupt = saved;
+    ((uint8_t*)&corrupt)[byte] ^= 0x10;
+    CHECK(corrupt.crc != settingsCrc(corrupt));
+  }
+  SettingsRecord corrupt = saved;
+  corrupt.cameras[2].name[1] ^= 0x01;
+  writeRecord(&corrupt, sizeof(corrupt));
+  reload();
+  CHECK(strstr(host::serialOutput(), "Settings CRC mismatch"));
+  CHECK(!cameras[2].isValid);
+
+  // So are another version and another size
+  SettingsRecord other = saved;
+  other.version = SETTINGS_VERSION + 1;
+  other.crc = settingsCrc(other);
+  writeRecord(&other, sizeof(other));
+  reload();
+  CHECK(strstr(host::serialOutput(), "not supported"));
+  CHECK(!cameras[0].isValid);
+  writeRecord(&saved, sizeof(saved) - 4);
+  reload();
+  CHECK(strstr(host::serialOutput(), "not supported"));
+
+  // Migration from one legacy camera with a malformed address creates no
+  // namespaces of its own
+  host::nvsErase();
+  writeLegacyCamera(1, "X5 AAA111", "a4:cf:12:05:9e:01");
+  writeLegacyCamera(2, "X4 BBB222", " a:cf:12:05:9e:02");
+  reload();
+  CHECK(cameras[0].isValid);
+  CHECK(!cameras[1].isValid);
+  CHECK(!isVerticalLayout);
+  CHECK(!host::nvsHasNamespace("ui_settings"));
+  CHECK_EQ(host::nvsNamespaceCount(), 3);  // remote, camera1, camera2
+
+  printf("settings: ok (boot load %u NVS ops, %u with the legacy keys)\n", recordOps, legacyOps);
+  return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * test_smart_wake.cpp
+ * Smart Wake starts each camera as soon as its own link has settled
+ */
+
+#include "camera_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+namespace {
+
+const uint8_t addr1[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x01};
+const uint8_t addr2[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x02};
+
+void shortPress() {
+  unsigned long at = host::nowMs() + 10;
+  host::at(at, [] { host::pressButton(BTN_A_PIN); });
+  host::at(at + 80, [] { host::releaseButton(BTN_A_PIN); });
+  host::runUntil(at + 81);
+}
+
+uint64_t msSince(uint64_t us, unsigned long ms) { return us / 1000 - ms; }
+
+}  // namespace
+
+int main() {
+  SimCamera fast("X5 AAA111", addr1);
+  SimCamera slow("X4 BBB222", addr2);
+  memcpy(fast.wakePayload, "AAA111", 6);
+  memcpy(slow.wakePayload, "BBB222", 6);
+  slow.latencyMs = 4000;  // Slow to boot after it sees its wake payload
+  saveCamera(1, fast.name, packAddress(addr1), 0);
+  saveCamera(2, slow.name, packAddress(addr2), 0);
+  host::bootSketch();
+  fast.attach();
+  slow.attach();
+  host::runFor(5000);
+  CHECK_EQ(countConnectedCameras(), 2);
+
+  fast.powerOff();
+  slow.powerOff();
+  host::runFor(1000);
+  CHECK_EQ(countConnectedCameras(), 0);
+
+  // Short press on the dashboard with nothing connected: Smart Wake
+  unsigned long wakeAt = host::nowMs();
+  shortPress();
+  CHECK(pendingRecordAfterWake);
+  CHECK(cameras[0].wakeState == WAKE_WAITING && cameras[1].wakeState == WAKE_WAITING);
+
+  // The fast camera starts on its own; the dashboard shows the slow one as
+  // still waiting
+  unsigned long slowConnectedAt = 0;
+  while (!slow.recording && host::nowMs() < wakeAt + smartWakeTimeout) {
+    host::runFor(10);
+    if (!slowConnectedAt && cameras[1].connected) slowConnectedAt = host::nowMs();
+    if (fast.recording && !slowConnectedAt) {
+      CHECK(cameras[0].wakeState == WAKE_STARTED);
+      CHECK(cameras[1].wakeState == WAKE_WAITING);
+    }
+  }
+  CHECK(fast.recording);
+  CHECK(slow.recording);
+  uint64_t firstUs = fast.recordingChangedUs;
+
+  // The slow one got a catch-up start once its own link had settled
+  host::runFor(1000);
+  CHECK(!pendingRecordAfterWake);
+  CHECK(cameras[0].wakeState == WAKE_IDLE && cameras[1].wakeState == WAKE_IDLE);
+  CHECK(strstr(host::serialOutput(), "Smart Wake: Cam 1 started first"));
+  CHECK(strstr(host::serialOutput(), "Smart Wake: Cam 2 catch-up start"));
+  CHECK(strstr(host::serialOutput(), "Smart Wake: all 2 cameras started"));
+
+  // Waiting for the whole rig would have started nobody before the slow
+  // camera's link had settled too
+  CHECK(slowConnectedAt != 0);
+  CHECK(firstUs < (uint64_t)slowConnectedAt * 1000);
+  uint64_t allOrNothingUs = (uint64_t)(slowConnectedAt + smartWakeSettleTime + fast.latencyMs) * 1000;
+  printf("smart wake: ok (first camera recording after %llu ms, all-or-nothing %llu ms)\n",
+         (unsigned long long)msSince(firstUs, wakeAt), (unsigned long long)msSince(allOrNothingUs, wakeAt));
+
+  // A camera that never comes back doesn't cost the others their recording
+  fast.powerOff();
+  slow.powerOff();
+  slow.detach();
+  host::runFor(1000);
+  host::serialClear();
+  shortPress();
+  host::runFor(smartWakeTimeout + 1000);
+  CHECK(fast.recording);
+  CHECK(!pendingRecordAfterWake);
+  CHECK(strstr(host::serialOutput(), "Smart Wake: Cam 2 did not come back"));
+  CHECK(!strstr(host::serialOutput(), "Wake Failed"));
+  return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * test_soak.cpp
+ * Randomised connect/disconnect/reconnect churn with saved cameras and an
+ * unknown device: the registry stays consistent and the heap does not drift
+ */
+
+#include "check.h"
+#include "sketch.h"
+
+namespace {
+
+const int deviceCount = 3;  // Two saved cameras and a stranger
+const uint8_t addrs[deviceCount][6] = {
+    {0x11, 0x22, 0x33, 0x44, 0x55, 0x01},
+    {0x11, 0x22, 0x33, 0x44, 0x55, 0x02},
+    {0x66, 0x55, 0x44, 0x33, 0x22, 0x11},
+};
+int links[deviceCount] = {-1, -1, -1};
+uint32_t connectsAccepted[deviceCount];
+uint32_t linksDropped = 0;  // By either side
+
+uint32_t seed = 0x50A4;
+uint32_t nextRandom() {
+  seed = seed * 1103515245u + 12345u;
+  return seed >> 8;
+}
+
+// Links the remote dropped since we last looked
+void reapLinks() {
+  for (int d = 0; d < deviceCount; d++) {
+    if (links[d] >= 0 && !host::linkUp(links[d])) {
+      links[d] = -1;
+      linksDropped++;
+    }
+  }
+}
+
+void connectDevice(int d) {
+  if (links[d] >= 0) return;
+  links[d] = host::connect(addrs[d], 0);
+  if (links[d] >= 0) connectsAccepted[d]++;
+}
+
+void disconnectDevice(int d) {
+  if (links[d] < 0) return;
+  host::disconnect(links[d]);
+  links[d] = -1;
+  linksDropped++;
+}
+
+void sendTimerPacket(int d) {
+  static const uint8_t timer[] = {0xFC, 0xEF, 0xFE, 0x10, 0x00, 0x0C, 'R', 'E', 'C', ' ',
+                                  '0', '0', ':', '0', '0', ':', '0', '1'};
+  if (links[d] >= 0) host::write(links[d], timer, sizeof(timer));
+}
+
+// Everyone gone, and long enough for the soak idle sample
+void settleIdle() {
+  for (int d = 0; d < deviceCount; d++) disconnectDevice(d);
+  host::runFor(soakIdleSettle + 500);
+  reapLinks();
+}
+
+void checkRegistry() {
+  CHECK_EQ(checkCameraRegistry(true), 0);
+  int linked = 0;
+  for (int d = 0; d < 2; d++) {
+    if (links[d] >= 0) linked++;
+  }
+  CHECK_EQ(countConnectedCameras(), linked);
+  CHECK(links[2] < 0 || findCameraByConnId(links[2]) == nullptr);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int cycles = argc > 1 ? atoi(argv[1]) : 20000;
+  saveCamera(1, "X5 AAA111", packAddress(addrs[0]), 0);
+  saveCamera(2, "X4 BBB222", packAddress(addrs[1]), 0);
+  host::setIgnoreAllowList(true);  // Let the stranger reach the callbacks
+  host::bootSketch();
+
+  // Warm up: one of everything, so lazily created state exists before the
+  // baseline is taken
+  for (int d = 0; d < deviceCount; d++) connectDevice(d);
+  host::runFor(500);
+  reapLinks();
+  settleIdle();
+  const size_t baselineLive = host::heapLiveBytes();
+  const uint32_t baselineSamples = soakCounters.idleSamples;
+  CHECK(baselineSamples > 0);
+
+  for (int n = 0; n < cycles; n++) {
+    int d = nextRandom() % deviceCount;
+    switch (nextRandom() % 8) {
+      case 0:
+      case 1:
+      case 2:
+        connectDevice(d);
+        break;
+      case 3:
+      case 4:
+        disconnectDevice(d);
+        break;
+      case 5:  // Drop and come straight back, before loop() has seen the drop
+        disconnectDevice(d);
+        connectDevice(d);
+        break;
+      case 6:
+        sendTimerPacket(d);
+        break;
+      default:
+        if (nextRandom() % 16 == 0) settleIdle();
+        break;
+    }
+    host::runFor(1 + nextRandom() % 300);
+    reapLinks();
+    checkRegistry();
+    if (n % 1000 == 0) host::serialClear();
+  }
+  settleIdle();
+  checkRegistry();
+
+  // Every connect and every drop was seen, and classified
+  const SoakCounters& c = soakCounters;
+  CHECK_EQ(c.registryErrors, 0);
+  CHECK_EQ(c.connects[SOAK_CONNECT_KNOWN], connectsAccepted[0] + connectsAccepted[1]);
+  CHECK_EQ(c.connects[SOAK_CONNECT_REJECTED], connectsAccepted[2]);
+  CHECK_EQ(c.disconnects, linksDropped);
+  CHECK_EQ(c.untrackedDisconnects, connectsAccepted[2]);
+  CHECK(connectsAccepted[2] > 100);
+
+  // No drift: every idle point looks like the first
+  CHECK(c.idleSamples > baselineSamples + 100);
+  CHECK_EQ(host::heapLiveBytes(), baselineLive);
+  CHECK_EQ(soakIdleLast, soakIdleBaseline);
+  CHECK_EQ(soakIdleLowest, soakIdleBaseline);
+
+  host::serialClear();
+  soakReport();
+  CHECK(!strstr(host::serialOutput(), "INCONSISTENT"));
+  CHECK(!strstr(host::serialOutput(), "LEAK?"));
+
+  printf("soak: ok (%d cycles, %u connects, %u drops, %u idle samples, peak heap %zu bytes)\n", cycles,
+         c.connects[0] + c.connects[1] + c.connects[2], c.disconnects, c.idleSamples, host::heapPeakBytes());
+  return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * test_start_skew.cpp
+ * Staggered starts from measured per-camera start latency
+ */
+
+#include "camera_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+namespace {
+
+const uint8_t addr1[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x01};
+const uint8_t addr2[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x02};
+
+// Press A and give the cameras time to act, and the remote time to see a
+// stop (5 s until it has learned the timer cadence)
+void shortPress() {
+  unsigned long at = host::nowMs() + 10;
+  host::at(at, [] { host::pressButton(BTN_A_PIN); });
+  host::at(at + 80, [] { host::releaseButton(BTN_A_PIN); });
+  host::runFor(7000);
+}
+
+// Unicast SHUTTER notifications sent since `from`, in order
+int shutterUnicasts(size_t from, const host::Notification* out[], int max) {
+  int n = 0;
+  for (size_t i = from; i < host::notificationCount() && n < max; i++) {
+    const host::Notification& note = host::notification(i);
+    if (note.connId != 0xFFFF && note.len == sizeof(SHUTTER_CMD) && memcmp(note.data, SHUTTER_CMD, note.len) == 0) {
+      out[n++] = &note;
+    }
+  }
+  return n;
+}
+
+long skewMs(const SimCamera& a, const SimCamera& b) {
+  return (long)((int64_t)(a.recordingChangedUs - b.recordingChangedUs) / 1000);
+}
+
+}  // namespace
+
+int main() {
+  SimCamera fast("X5 AAA111", addr1);
+  SimCamera slow("X4 BBB222", addr2);
+  fast.latencyMs = 150;
+  slow.latencyMs = 600;
+  saveCamera(1, fast.name, packAddress(addr1), 0);
+  saveCamera(2, slow.name, packAddress(addr2), 0);
+  host::bootSketch();
+  fast.attach();
+  slow.attach();
+  host::runFor(2000);
+
+  // Nothing measured yet: one broadcast, so the cameras start 450 ms apart
+  shortPress();
+  CHECK(fast.recording && slow.recording);
+  CHECK_EQ(skewMs(slow, fast), 450);
+  CHECK_EQ(cameras[0].startLatencyMs, 150);
+  CHECK_EQ(cameras[1].startLatencyMs, 600);
+  shortPress();
+  CHECK(!fast.recording && !slow.recording);
+
+  // Measured: the slow camera is sent to first and the fast one 450 ms later
+  size_t notes = host::notificationCount();
+  shortPress();
+  CHECK(fast.recording && slow.recording);
+  const host::Notification* sent[4];
+  CHECK_EQ(shutterUnicasts(notes, sent, 4), 2);
+  CHECK_EQ(sent[0]->connId, slow.connId);
+  CHECK_EQ(sent[1]->connId, fast.connId);
+  CHECK_EQ((sent[1]->us - sent[0]->us) / 1000, 450);
+  CHECK_EQ(skewMs(slow, fast), 0);
+  CHECK(strstr(host::serialOutput(), "Start skew"));
+  shortPress();
+
+  // A much slower camera is held back by at most maxStartStagger
+  slow.latencyMs = 3000;
+  shortPress();
+  shortPress();
+  CHECK(cameras[1].startLatencyMs - cameras[0].startLatencyMs > maxStartStagger);
+  notes = host::notificationCount();
+  shortPress();
+  CHECK_EQ(shutterUnicasts(notes, sent, 4), 2);
+  CHECK_EQ((sent[1]->us - sent[0]->us) / 1000, maxStartStagger);
+
+  printf("start skew: ok\n");
+  return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * test_toast.cpp
+ * Toasts replace each other by priority and expire on DEADLINE_TOAST, while
+ * buttons keep working and no loop() pass blocks
+ */
+
+#include "camera_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+namespace {
+
+const uint8_t addr1[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x01};
+
+void click(uint8_t pin, unsigned long at) {
+  host::at(at, [pin] { host::pressButton(pin); });
+  host::at(at + 80, [pin] { host::releaseButton(pin); });
+}
+
+bool showing(const char* line1) {
+  return toast.active && strcmp(toast.line1, line1) == 0;
+}
+
+}  // namespace
+
+int main() {
+  SimCamera cam1("X5 AAA111", addr1);
+  saveCamera(1, cam1.name, packAddress(addr1), 0);
+  host::bootSketch();
+  cam1.attach();
+  host::runFor(startupDelay + 3000);
+  CHECK_EQ(countConnectedCameras(), 1);
+  CHECK(!toast.active);
+  CHECK(!deadlines[DEADLINE_TOAST].armed);
+
+  unsigned long blocked = host::blockedMs();
+  controlPassMaxUs = 0;
+
+  // A toast of the same or a higher priority replaces the one showing; a
+  // lower one is dropped
+  showStatusToast("SENT!", BLUE, 500);
+  CHECK(showing("SENT!"));
+  showStatusToast("SYNC!", BLUE, 500);
+  CHECK(showing("SYNC!"));
+  showStatusToast("SLEEPING...", PURPLE, 1000, TOAST_NOTICE);
+  CHECK(showing("SLEEPING..."));
+  CHECK_EQ(toast.priority, TOAST_NOTICE);
+  showStatusToast("SENT!", BLUE, 500);
+  CHECK(showing("SLEEPING..."));
+  showMessageToast("Not", "Connected!", RED, 1500);
+  CHECK(showing("Not"));
+  CHECK(toast.message);
+  CHECK_EQ(toast.priority, TOAST_ERROR);
+  CHECK_EQ(strcmp(toast.line2, "Connected!"), 0);
+  showStatusToast("WAKE SENT!", BLUE, 1500, TOAST_NOTICE);
+  CHECK(showing("Not"));
+  showMessageToast("No camera", "Pair first", RED, 2000);
+  CHECK(showing("No camera"));
+
+  // It expires on its own deadline, not at the next idle wake-up
+  unsigned long until = toast.until;
+  CHECK_EQ(until, host::nowMs() + 2000);
+  CHECK(deadlines[DEADLINE_TOAST].armed);
+  CHECK_EQ(deadlines[DEADLINE_TOAST].at, until);
+  host::runUntil(until - 1);
+  CHECK(showing("No camera"));
+  uint32_t frames = renderStats.requests[RENDER_FRAME];
+  host::runUntil(until + 1);
+  CHECK(!toast.active);
+  CHECK(!deadlines[DEADLINE_TOAST].armed);
+  CHECK(renderStats.requests[RENDER_FRAME] > frames);  // Redrawn without it
+
+  // Buttons are handled with a message up, and the command feedback it
+  // outranks stays hidden
+  showMessageToast("Not", "Connected!", RED, 3000);
+  click(BTN_A_PIN, host::nowMs() + 100);
+  host::runFor(cam1.latencyMs + 500);
+  CHECK(cam1.recording);
+  CHECK(isRecording);
+  CHECK(showing("Not"));
+  click(BTN_A_PIN, host::nowMs() + 100);
+  host::runFor(cam1.latencyMs + 500);
+  CHECK(!cam1.recording);
+  host::runFor(3000);
+  CHECK(!toast.active);
+
+  // The wake trigger raises WAKING... and switches advertising; the restart
+  // waits out the controller's settle time on a deadline, not in the pass
+  unsigned long wakeAt = host::nowMs() + 50;
+  host::at(wakeAt, [] { host::setPin(WAKE_PIN, HIGH); });
+  host::at(wakeAt + 50, [] { host::setPin(WAKE_PIN, LOW); });
+  host::runUntil(wakeAt + gpioDelay + 1);
+  CHECK(wakeInProgress);
+  CHECK(showing("WAKING..."));
+  CHECK(deadlines[DEADLINE_ADVERTISING].armed);
+  CHECK(!host::advertising());
+  host::runUntil(wakeAt + gpioDelay + advertisingSettleTime + 1);
+  CHECK(!deadlines[DEADLINE_ADVERTISING].armed);
+  CHECK(host::advertising());
+  CHECK(wakeMode);
+  host::runFor(wakeDuration + 500);
+  CHECK(!wakeInProgress);
+  CHECK(showing("WAKE SENT!"));
+  host::runFor(advertisingSettleTime);
+  CHECK(host::advertising());
+  CHECK(!wakeMode);
+  host::runFor(2000);
+  CHECK(!toast.active);
+
+  // None of that blocked loop()
+  CHECK_EQ(host::blockedMs(), blocked);
+  CHECK(controlPassMaxUs < controlPassBudgetUs);
+  CHECK_EQ(controlPassesOverBudget, 0u);
+
+  printf("toast: ok (longest loop() pass %lu us of a %lu us budget)\n", (unsigned long)controlPassMaxUs,
+         (unsigned long)controlPassBudgetUs);
+  return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * test_trigger_slot.cpp
+ * Adaptive trigger slot width, settled by updateTriggerSlot() from loop()
+ * (built with TRIGGER_SLOT=1)
+ */
+
+#include "camera_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+static_assert(TRIGGER_SLOT == 1, "built with -DTRIGGER_SLOT=1");
+
+namespace {
+
+const uint8_t addr1[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x01};
+
+// Close the shutter trigger shortly and release it 100 ms later; returns
+// when the edge lands
+unsigned long pressShutterTrigger() {
+  unsigned long at = host::nowMs() + 10;
+  host::at(at, [] { host::setPin(SHUTTER_PIN, LOW); });
+  host::at(at + 100, [] { host::setPin(SHUTTER_PIN, HIGH); });
+  return at;
+}
+
+// Stop the camera with a GPIO press and wait until the remote has seen its
+// timer packets stop, so the next press counts as a start again
+void stopAndSettle(SimCamera& cam) {
+  pressShutterTrigger();
+  host::runFor(cam.latencyMs + 100);
+  CHECK(!cam.recording);
+  unsigned long giveUp = host::nowMs() + defaultRecordingTimeout + 1000;
+  while (cameras[0].isRecording && host::nowMs() < giveUp) host::runFor(100);
+  CHECK(!cameras[0].isRecording);
+}
+
+// One GPIO start the camera hears, then the stop that ends it
+void cleanStartStop(SimCamera& cam) {
+  pressShutterTrigger();
+  host::runFor(cam.latencyMs + 1500);
+  CHECK(cam.recording);
+  CHECK(!slotTrigger.pending);
+  stopAndSettle(cam);
+}
+
+}  // namespace
+
+int main() {
+  SimCamera cam1("X5 AAA111", addr1);
+  saveCamera(1, cam1.name, packAddress(addr1), 0);
+  host::bootSketch();
+  cam1.attach();
+  host::runFor(startupDelay + 3000);
+  CHECK_EQ(countConnectedCameras(), 1);
+  CHECK_EQ(gpioSlotWidth, initialGpioSlotWidth);
+  CHECK_EQ(gpioDelay, (int)initialGpioSlotWidth);
+
+  // A start every camera confirms is clean; the stop is not checked
+  cleanStartStop(cam1);
+  CHECK_EQ(slotTriggers, 1u);
+  CHECK_EQ(slotCollisions, 0u);
+  CHECK(!deadlines[DEADLINE_TRIGGER_SLOT].armed);
+
+  // A start the camera never hears is a collision. It settles as the check
+  // window closes, on its own deadline rather than the next idle wake-up.
+  cam1.missCommands = 1;
+  unsigned long edgeAt = pressShutterTrigger();
+  host::runUntil(edgeAt + gpioDelay + 1);
+  CHECK(slotTrigger.pending);
+  unsigned long notedAt = slotTrigger.time;
+  CHECK_EQ(notedAt, edgeAt + gpioDelay);
+  CHECK(deadlines[DEADLINE_TRIGGER_SLOT].armed);
+  unsigned long blocked = host::blockedMs();
+  host::runUntil(notedAt + gpioSlotCheckWindow);
+  CHECK(slotTrigger.pending);
+  host::runUntil(notedAt + gpioSlotCheckWindow + 2);
+  CHECK(!slotTrigger.pending);
+  CHECK(!deadlines[DEADLINE_TRIGGER_SLOT].armed);
+  CHECK_EQ(slotTriggers, 2u);
+  CHECK_EQ(slotCollisions, 1u);
+  CHECK_EQ(gpioSlotWidth, 2 * initialGpioSlotWidth);
+  CHECK_EQ(gpioDelay, (int)(2 * initialGpioSlotWidth));
+  CHECK_EQ(host::blockedMs(), blocked);
+  CHECK(strstr(host::serialOutput(), "GPIO start missed a camera"));
+  CHECK(!cam1.recording);
+
+  // The remote took that press as a start, so the next one stops its timer
+  // and starts the camera, which it then stops again
+  pressShutterTrigger();
+  host::runFor(cam1.latencyMs + 1500);
+  CHECK(cam1.recording);
+  stopAndSettle(cam1);
+  CHECK_EQ(slotCollisions, 1u);
+  CHECK_EQ(slotCleanRun, 1);
+  unsigned long widened = gpioSlotWidth;
+
+  // Clean starts narrow it again one step per gpioSlotShrinkAfter of them
+  for (int i = 2; i < gpioSlotShrinkAfter; i++) cleanStartStop(cam1);
+  CHECK_EQ(gpioSlotWidth, widened);
+  cleanStartStop(cam1);
+  CHECK_EQ(gpioSlotWidth, widened - gpioSlotShrinkStep);
+  CHECK_EQ(gpioDelay, (int)(widened - gpioSlotShrinkStep));
+
+  // Collisions widen it up to maxGpioSlotWidth and no further
+  for (int i = 0; i < 3; i++) {
+    cam1.missCommands = 1;
+    pressShutterTrigger();
+    host::runFor(gpioSlotCheckWindow + 500);
+    pressShutterTrigger();  // Stops the remote's timer, starts the camera
+    host::runFor(cam1.latencyMs + 1500);
+    stopAndSettle(cam1);
+  }
+  CHECK_EQ(slotCollisions, 4u);
+  CHECK_EQ(gpioSlotWidth, maxGpioSlotWidth);
+
+  printf("trigger slot: ok (%lu starts, %lu collisions, width %lu ms)\n", (unsigned long)slotTriggers,
+         (unsigned long)slotCollisions, gpioSlotWidth);
+  return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * test_triggers.cpp
+ * Trigger pin edges are timestamped and debounced in the ISR, and the action
+ * goes out gpioDelay ms after the edge without loop() sleeping through it
+ */
+
+#include "camera_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+namespace {
+
+const uint8_t addr1[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x01};
+
+// Time of the first notification at or after `from` carrying `command`
+uint64_t notificationUs(size_t from, const uint8_t* command, size_t len) {
+  for (size_t i = from; i < host::notificationCount(); i++) {
+    const host::Notification& note = host::notification(i);
+    if (note.len == len && memcmp(note.data, command, len) == 0) return note.us;
+  }
+  return UINT64_MAX;
+}
+
+// A contact closing on `pin` at `at`, bouncing open and shut on the way,
+// and opening again `holdMs` later
+void bouncyPress(uint8_t pin, int activeLevel, unsigned long at, unsigned long holdMs) {
+  int idle = activeLevel == LOW ? HIGH : LOW;
+  host::at(at, [pin, activeLevel] { host::setPin(pin, activeLevel); });
+  host::at(at + 2, [pin, idle] { host::setPin(pin, idle); });
+  host::at(at + 3, [pin, activeLevel] { host::setPin(pin, activeLevel); });
+  host::at(at + holdMs, [pin, idle] { host::setPin(pin, idle); });
+  host::at(at + holdMs + 1, [pin, activeLevel] { host::setPin(pin, activeLevel); });
+  host::at(at + holdMs + 2, [pin, idle] { host::setPin(pin, idle); });
+}
+
+}  // namespace
+
+int main() {
+  SimCamera cam1("X5 AAA111", addr1);
+  saveCamera(1, cam1.name, packAddress(addr1), 0);
+  host::bootSketch();
+  cam1.attach();
+
+  // Edges during the startup delay are dropped, not run late
+  bouncyPress(SHUTTER_PIN, LOW, 500, 80);
+  size_t notes = host::notificationCount();
+  host::runFor(startupDelay + 3000);
+  CHECK_EQ(triggerEdges[TRIGGER_SHUTTER].count, 1u);
+  CHECK_EQ(notificationUs(notes, SHUTTER_CMD, sizeof(SHUTTER_CMD)), UINT64_MAX);
+  CHECK_EQ(countConnectedCameras(), 1);
+
+  // A stagger this remote would get on a shared cable
+  gpioDelay = 37;
+
+  // One accepted edge per press, stamped at the edge itself; the shutter
+  // goes out exactly gpioDelay later and loop() never blocks in delay()
+  unsigned long edgeAt = host::nowMs() + 123;
+  bouncyPress(SHUTTER_PIN, LOW, edgeAt, 90);
+  notes = host::notificationCount();
+  unsigned long blocked = host::blockedMs();
+  host::runUntil(edgeAt + gpioDelay - 1);
+  CHECK(gpioActionPending[TRIGGER_SHUTTER]);
+  CHECK_EQ(notificationUs(notes, SHUTTER_CMD, sizeof(SHUTTER_CMD)), UINT64_MAX);
+  host::runUntil(edgeAt + 500);
+  CHECK_EQ(triggerEdges[TRIGGER_SHUTTER].count, 2u);
+  CHECK_EQ(triggerEdges[TRIGGER_SHUTTER].edgeUs, (uint32_t)(edgeAt * 1000));
+  uint64_t shutterUs = notificationUs(notes, SHUTTER_CMD, sizeof(SHUTTER_CMD));
+  CHECK_EQ(shutterUs, (uint64_t)(edgeAt + gpioDelay) * 1000);
+  CHECK_EQ(notificationUs(notes + 1, SHUTTER_CMD, sizeof(SHUTTER_CMD)), UINT64_MAX);
+  CHECK_EQ(host::blockedMs(), blocked);
+  host::runFor(cam1.latencyMs + 500);
+  CHECK(cam1.recording);
+
+  // A second press after the debounce window stops it again
+  unsigned long stopAt = host::nowMs() + 50;
+  bouncyPress(SHUTTER_PIN, LOW, stopAt, 60);
+  notes = host::notificationCount();
+  host::runUntil(stopAt + 500);
+  CHECK_EQ(triggerEdges[TRIGGER_SHUTTER].count, 3u);
+  CHECK_EQ(notificationUs(notes, SHUTTER_CMD, sizeof(SHUTTER_CMD)), (uint64_t)(stopAt + gpioDelay) * 1000);
+  host::runFor(cam1.latencyMs + 500);
+  CHECK(!cam1.recording);
+
+  // Re-closing inside debounceDelay, even after a clean release, is the
+  // same press
+  unsigned long doubleAt = host::nowMs() + 50;
+  host::at(doubleAt, [] { host::setPin(SHUTTER_PIN, LOW); });
+  host::at(doubleAt + 40, [] { host::setPin(SHUTTER_PIN, HIGH); });
+  host::at(doubleAt + 100, [] { host::setPin(SHUTTER_PIN, LOW); });
+  host::at(doubleAt + 140, [] { host::setPin(SHUTTER_PIN, HIGH); });
+  notes = host::notificationCount();
+  host::runUntil(doubleAt + 1000);
+  CHECK_EQ(triggerEdges[TRIGGER_SHUTTER].count, 4u);
+  CHECK_EQ(notificationUs(notes, SHUTTER_CMD, sizeof(SHUTTER_CMD)), (uint64_t)(doubleAt + gpioDelay) * 1000);
+  CHECK_EQ(notificationUs(notes + 1, SHUTTER_CMD, sizeof(SHUTTER_CMD)), UINT64_MAX);
+  host::runFor(cam1.latencyMs + 500);
+  CHECK(cam1.recording);
+  bouncyPress(SHUTTER_PIN, LOW, host::nowMs() + 10, 60);
+  host::runFor(cam1.latencyMs + 500);
+  CHECK(!cam1.recording);
+
+  CHECK_EQ(host::blockedMs(), blocked);
+
+  // Edges on two pins a few ms apart keep their own deadlines, and the wake
+  // starts on time although advertising restarts only once the radio settles
+  unsigned long sleepAt = host::nowMs() + 77;
+  unsigned long wakeAt = sleepAt + 9;
+  bouncyPress(SLEEP_PIN, HIGH, sleepAt, 50);
+  bouncyPress(WAKE_PIN, HIGH, wakeAt, 50);
+  notes = host::notificationCount();
+  host::runUntil(wakeAt + gpioDelay - 1);
+  CHECK(!wakeInProgress);
+  CHECK_EQ(notificationUs(notes, POWER_OFF_CMD, sizeof(POWER_OFF_CMD)), (uint64_t)(sleepAt + gpioDelay) * 1000);
+  host::runUntil(wakeAt + gpioDelay + 1);
+  CHECK(wakeInProgress);
+  CHECK_EQ(wakeEndTime, wakeAt + gpioDelay + wakeDuration);
+  host::runUntil(wakeAt + 500);
+  CHECK_EQ(triggerEdges[TRIGGER_SLEEP].count, 1u);
+  CHECK_EQ(triggerEdges[TRIGGER_WAKE].count, 1u);
+  CHECK_EQ(triggerEdges[TRIGGER_WAKE].edgeUs, (uint32_t)(wakeAt * 1000));
+  CHECK(!gpioActionPending[TRIGGER_SLEEP] && !gpioActionPending[TRIGGER_WAKE]);
+  CHECK_EQ(host::blockedMs(), blocked);
+
+  printf("triggers: ok (edge to TX %lu ms with gpioDelay %d ms)\n",
+         (unsigned long)(shutterUs / 1000 - edgeAt), gpioDelay);
+  return 0;
+}
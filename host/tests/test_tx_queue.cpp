@@ -0,0 +1,120 @@
+/*
+ * test_tx_queue.cpp
+ * Outgoing commands go through the TX queue without blocking loop()
+ */
+
+#include "camera_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+namespace {
+
+const uint8_t addr1[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x01};
+const uint8_t addr2[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x02};
+
+// Index of the first notification at or after `from` carrying `command`
+size_t findNotification(size_t from, const uint8_t* command, size_t len) {
+  for (size_t i = from; i < host::notificationCount(); i++) {
+    const host::Notification& note = host::notification(i);
+    if (note.len == len && memcmp(note.data, command, len) == 0) return i;
+  }
+  return SIZE_MAX;
+}
+
+}  // namespace
+
+int main() {
+  SimCamera cam1("X5 AAA111", addr1);
+  SimCamera cam2("X4 BBB222", addr2);
+  saveCamera(1, cam1.name, packAddress(addr1), 0);
+  saveCamera(2, cam2.name, packAddress(addr2), 0);
+  host::bootSketch();
+  cam1.attach();
+  cam2.attach();
+  host::runFor(2000);
+  CHECK_EQ(countConnectedCameras(), 2);
+  unsigned long blockedAtStart = host::blockedMs();
+
+  // A broadcast goes out on the pass that queued it
+  size_t notes = host::notificationCount();
+  sendCommand(MODE_CMD, sizeof(MODE_CMD), "MODE");
+  CHECK(!txQueueEmpty());
+  unsigned long queuedAt = millis();
+  host::runFor(10);
+  size_t sent = findNotification(notes, MODE_CMD, sizeof(MODE_CMD));
+  CHECK(sent != SIZE_MAX);
+  CHECK_EQ(host::notification(sent).connId, 0xFFFF);
+  CHECK_EQ(host::notification(sent).us / 1000, queuedAt);
+  CHECK(txQueueEmpty());
+
+  // Staggered unicasts leave at their sendAt, and loop() keeps handling camera
+  // packets while they wait
+  notes = host::notificationCount();
+  queuedAt = millis();
+  CHECK(enqueueTx(cam1.connId, TOGGLE_SCREEN_CMD, sizeof(TOGGLE_SCREEN_CMD), "SCREEN", 0));
+  CHECK(enqueueTx(cam2.connId, TOGGLE_SCREEN_CMD, sizeof(TOGGLE_SCREEN_CMD), "SCREEN", 300));
+  const uint8_t timer[] = {0xFC, 0xEF, 0xFE, 0x10, 0x00, 0x0C, 'R', 'E', 'C', ' ',
+                           '0', '0', ':', '0', '0', ':', '0', '1'};
+  unsigned long writeAt = queuedAt + 100;
+  int cam1Id = cam1.connId;
+  host::at(writeAt, [cam1Id, &timer] { host::write(cam1Id, timer, sizeof(timer)); });
+  host::runFor(500);
+
+  size_t first = findNotification(notes, TOGGLE_SCREEN_CMD, sizeof(TOGGLE_SCREEN_CMD));
+  CHECK(first != SIZE_MAX);
+  CHECK_EQ(host::notification(first).connId, cam1.connId);
+  CHECK_EQ(host::notification(first).us / 1000, queuedAt);
+  size_t second = findNotification(first + 1, TOGGLE_SCREEN_CMD, sizeof(TOGGLE_SCREEN_CMD));
+  CHECK(second != SIZE_MAX);
+  CHECK_EQ(host::notification(second).connId, cam2.connId);
+  CHECK_EQ(host::notification(second).us / 1000, queuedAt + 300);
+  CHECK_EQ(findCameraByConnId(cam1Id)->lastTimerTime, writeAt);
+  CHECK(txQueueEmpty());
+  CHECK(!deadlines[DEADLINE_TX_DUE].armed);
+
+  // A command due now is not held behind a staggered start, but a shutter
+  // for the same camera keeps its place behind it
+  notes = host::notificationCount();
+  queuedAt = millis();
+  CHECK(enqueueTx(cam2.connId, SHUTTER_CMD, sizeof(SHUTTER_CMD), "SHUTTER (START)", 800, true));
+  CHECK(enqueueTx(TX_BROADCAST, MODE_CMD, sizeof(MODE_CMD), "MODE"));
+  CHECK(enqueueTx(cam1.connId, TOGGLE_SCREEN_CMD, sizeof(TOGGLE_SCREEN_CMD), "SCREEN"));
+  CHECK(enqueueTx(TX_BROADCAST, SHUTTER_CMD, sizeof(SHUTTER_CMD), "SHUTTER"));
+  host::runFor(1000);
+  size_t mode = findNotification(notes, MODE_CMD, sizeof(MODE_CMD));
+  size_t screen = findNotification(notes, TOGGLE_SCREEN_CMD, sizeof(TOGGLE_SCREEN_CMD));
+  size_t start = findNotification(notes, SHUTTER_CMD, sizeof(SHUTTER_CMD));
+  size_t toggle = findNotification(start + 1, SHUTTER_CMD, sizeof(SHUTTER_CMD));
+  CHECK(mode != SIZE_MAX && screen != SIZE_MAX && start != SIZE_MAX && toggle != SIZE_MAX);
+  CHECK_EQ(host::notification(mode).us / 1000, queuedAt);
+  CHECK_EQ(host::notification(screen).us / 1000, queuedAt);
+  CHECK_EQ(host::notification(start).us / 1000, queuedAt + 800);
+  CHECK_EQ(host::notification(start).connId, cam2.connId);
+  CHECK(mode < screen && screen < start);
+  CHECK_EQ(host::notification(toggle).connId, 0xFFFF);
+  CHECK_EQ(host::notification(toggle).us / 1000, queuedAt + 800);
+  CHECK(txQueueEmpty());
+
+  // A full queue refuses instead of overwriting the oldest entry
+  int accepted = 0;
+  for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+    if (enqueueTx(cam1.connId, MODE_CMD, sizeof(MODE_CMD), "MODE", 1000)) accepted++;
+  }
+  CHECK_EQ(accepted, TX_QUEUE_SIZE - 1);
+  host::runFor(1500);
+  CHECK(txQueueEmpty());
+
+  // None of it waited in delay()
+  CHECK_EQ(host::blockedMs(), blockedAtStart);
+
+  // With nothing connected a command is not queued at all
+  cam1.powerOff();
+  cam2.powerOff();
+  host::runFor(1000);
+  CHECK_EQ(countConnectedCameras(), 0);
+  sendCommand(SHUTTER_CMD, sizeof(SHUTTER_CMD), "SHUTTER");
+  CHECK(txQueueEmpty());
+
+  printf("tx queue: ok\n");
+  return 0;
+}
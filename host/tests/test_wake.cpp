@@ -0,0 +1,156 @@
+/*
+ * test_wake.cpp
+ * Every saved camera woken in one shared window, swept over 1-6 cameras and
+ * set against the old one-camera-at-a-time wake (built with MAX_CAMERAS=6)
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "camera_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+static_assert(MAX_CAMERAS == 6, "built with -DMAX_CAMERAS=6");
+
+namespace {
+
+const char* names[MAX_CAMERAS] = {"X5 AAA111", "X4 BBB222", "X3 CCC333",
+                                  "RS DDD444", "X5 EEE555", "X4 FFF666"};
+
+enum WakeStrategy { WAKE_ROTATING, WAKE_SEQUENTIAL };
+
+// How an off camera scans for its wake payload: a window every period, at
+// a phase of its own. 500 ms is a multiple of the payload cycle with five
+// cameras on a fixed 100 ms rotation, the case that used to miss one.
+struct ScanProfile {
+  uint32_t periodMs;
+  uint32_t windowMs;
+};
+const ScanProfile scanProfiles[] = {{500, 300}, {640, 200}};
+
+// Step the simulation to `untilMs`, noting when each of the first `count`
+// cameras comes back on a link
+void watch(int count, unsigned long untilMs, unsigned long* wokenAt) {
+  while (host::nowMs() < untilMs) {
+    host::runFor(10);
+    for (int i = 0; i < count; i++) {
+      if (!wokenAt[i] && cameras[i].connected) wokenAt[i] = host::nowMs();
+    }
+  }
+}
+
+// Connect `count` cameras, power them off, wake them with `strategy` and
+// return the ms until the last one is connected again. Needs a freshly
+// booted sketch, so it runs in a process of its own.
+unsigned long wakeAll(int count, WakeStrategy strategy, const ScanProfile& scan) {
+  SimCamera* sims[MAX_CAMERAS];
+  for (int i = 0; i < count; i++) {
+    const uint8_t bda[6] = {0x11, 0x22, 0x33, 0x44, 0x55, (uint8_t)(i + 1)};
+    sims[i] = new SimCamera(names[i], bda);
+    // The camera listens for the last six characters of its name
+    memcpy(sims[i]->wakePayload, names[i] + strlen(names[i]) - 6, 6);
+    sims[i]->wakeScanMs = scan.periodMs;
+    sims[i]->wakeScanWindowMs = scan.windowMs;
+    sims[i]->wakeScanPhaseMs = i * 170 % scan.periodMs;
+    sims[i]->latencyMs = 150 + 100 * i;
+    saveCamera(i + 1, names[i], packAddress(bda), 0);
+  }
+  host::bootSketch();
+  for (int i = 0; i < count; i++) sims[i]->attach();
+  host::runFor(3000);
+  CHECK_EQ(countConnectedCameras(), count);
+
+  // Everyone off
+  for (int i = 0; i < count; i++) sims[i]->powerOff();
+  host::runFor(1000);
+  CHECK_EQ(countConnectedCameras(), 0);
+
+  unsigned long wakeAt = host::nowMs();
+  unsigned long wokenAt[MAX_CAMERAS] = {};
+  if (strategy == WAKE_ROTATING) {
+    // One window wakes them all; woken ones connecting must not stop the
+    // others from seeing their payload
+    executeWake();
+    CHECK(wakeMode);
+    watch(count, wakeAt + wakeDuration + 2000, wokenAt);
+
+    // The window closes with normal advertising again
+    CHECK(!wakeInProgress);
+    CHECK(!wakeMode);
+    CHECK(strstr(host::serialOutput(), "Wake window finished"));
+  } else {
+    // The wake this replaced: each camera's payload on air by itself for
+    // wakeDuration, one camera after the other
+    for (int i = 0; i < count; i++) {
+      setWakeAdvertising(cameras[i].wakePayload);
+      watch(count, host::nowMs() + wakeDuration, wokenAt);
+    }
+    setNormalAdvertising();
+    watch(count, host::nowMs() + 2000, wokenAt);
+  }
+
+  unsigned long allAwake = 0;
+  for (int i = 0; i < count; i++) {
+    CHECK(!sims[i]->poweredOff);
+    CHECK(wokenAt[i] != 0);
+    if (wokenAt[i] - wakeAt > allAwake) allAwake = wokenAt[i] - wakeAt;
+  }
+  CHECK_EQ(countConnectedCameras(), count);
+  return allAwake;
+}
+
+// wakeAll() in a child process, so every run starts from a fresh sketch
+unsigned long wakeAllForked(int count, WakeStrategy strategy, const ScanProfile& scan) {
+  int fds[2];
+  CHECK(pipe(fds) == 0);
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  CHECK(pid >= 0);
+  if (pid == 0) {
+    close(fds[0]);
+    unsigned long ms = wakeAll(count, strategy, scan);
+    CHECK(write(fds[1], &ms, sizeof(ms)) == (ssize_t)sizeof(ms));
+    _exit(0);
+  }
+  close(fds[1]);
+  unsigned long ms = 0;
+  ssize_t got = read(fds[0], &ms, sizeof(ms));
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || got != (ssize_t)sizeof(ms)) {
+    fprintf(stderr, "%d camera(s) scanning %u/%u ms, %s wake failed\n", count, scan.windowMs,
+            scan.periodMs, strategy == WAKE_ROTATING ? "rotating" : "sequential");
+    exit(1);
+  }
+  return ms;
+}
+
+}  // namespace
+
+int main() {
+  unsigned long rotating[MAX_CAMERAS + 1];
+  unsigned long sequential[MAX_CAMERAS + 1];
+  for (const ScanProfile& scan : scanProfiles) {
+    for (int count = 1; count <= MAX_CAMERAS; count++) {
+      rotating[count] = wakeAllForked(count, WAKE_ROTATING, scan);
+      sequential[count] = wakeAllForked(count, WAKE_SEQUENTIAL, scan);
+      printf("wake: %d camera(s) scanning %u/%u ms awake after %5lu ms rotating, %5lu ms one at a time\n",
+             count, scan.windowMs, scan.periodMs, rotating[count], sequential[count]);
+    }
+
+    for (int count = 1; count <= MAX_CAMERAS; count++) {
+      // The shared window wakes everyone inside it, however many there are
+      CHECK(rotating[count] < wakeDuration + 1000);
+      // One at a time, the last camera only gets its turn after the others
+      CHECK(sequential[count] >= (count - 1) * wakeDuration);
+      if (count > 1) CHECK(rotating[count] < sequential[count]);
+    }
+  }
+
+  printf("wake: ok (%d cameras awake after %lu ms, %lu ms one at a time)\n", MAX_CAMERAS,
+         rotating[MAX_CAMERAS], sequential[MAX_CAMERAS]);
+  return 0;
+}
@@ -5,13 +5,15 @@ serialhobbyism.com
 
 Insta360 Remote for M5Stack devices. Tested on original M5StickC and M5StickC Plus2. Should also work on M5StickC Plus.
 
+The board is picked at build time (see REMOTE_BOARD in config.h) - select the matching board in the IDE or define it yourself.
+
 Tested on Insta360 X5. Should work on other X-series models and RS.
 
 Supports "wake" of camera.
 
 Make sure you set REMOTE_IDENTIFIER below. Just select three alphanumeric characters of your choice to prevent interference with multiple remotes.
 
-Make sure you have the other files in the same folder: config.h, icons.h, camera.h, ble_handlers.h, ui.h, and commands.h
+Make sure you have the other files in the same folder: config.h, boot.h, icons.h, packets.h, camera.h, settings.h, scheduler.h, log.h, events.h, layouts.h, display.h, heapprobe.h, trace.h, capture.h, soak.h, render.h, toast.h, ble_handlers.h, ui.h, commands.h, triggerslot.h, and console.h
 */
 
 
@@ -28,6 +30,13 @@ Make sure you have the other files in the same folder: config.h, icons.h, camera
 // Examples: "001", "A01", "XYZ", "Bob", etc.
 const char REMOTE_IDENTIFIER[4] = "A01";  // Maximum 3 characters + null terminator
 
+// Remotes sharing one GPIO trigger cable: give each a different slot (0, 1, 2...)
+// so they send in turn. -1 keeps the delay hashed from REMOTE_IDENTIFIER.
+#ifndef TRIGGER_SLOT
+#define TRIGGER_SLOT -1
+#endif
+const int REMOTE_SLOT = TRIGGER_SLOT;
+
 // Calculate unique GPIO delay based on REMOTE_IDENTIFIER (0-100ms)
 int calculateGPIODelay() {
   int hash = 0;
@@ -50,79 +59,44 @@ unsigned long wakeRequestTime = 0;
 
 // Include all module headers in correct order
 #include "config.h"
+#include "boot.h"
 #include "icons.h"
+#include "packets.h"
 #include "camera.h"
-
-// Forward declarations for cross-dependencies
-void updateDisplay();
-void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color);
-void showBottomStatus(const char* text, uint16_t color);
-void showCenteredMessage(const char* line1, const char* line2, uint16_t color);
-void applyLayoutRotation();
-void setNormalAdvertising();
-void setWakeAdvertising(uint8_t* wakePayload);
-void sendCommand(uint8_t* command, size_t length, const char* commandName);
-void executeShutter();
-void executeSleep();
-void executeWake();
-void executeSwitchMode();
-void executeScreenOff();
-void connectCamera1();
-void connectCamera2();
-void showNotConnectedMessage();
-void showNoCameraMessage();
-void checkGPIOPins();
-
-// Now include the implementation headers
+#include "settings.h"
+#include "scheduler.h"
+#include "log.h"
+#include "events.h"
+#include "layouts.h"
+#include "display.h"
+#include "heapprobe.h"
+#include "trace.h"
+#include "capture.h"
+#include "soak.h"
+#include "render.h"
+#include "toast.h"
 #include "ble_handlers.h"
 #include "ui.h"
 #include "commands.h"
+#include "triggerslot.h"
+#include "console.h"
 
 void setup() {
+  // Power hold and display first - everything else needs M5
   M5.begin();
-  M5.Lcd.setRotation(3);
-  M5.Lcd.fillScreen(BLACK);
-  M5.Lcd.setTextSize(1);
-  detectDeviceAndSetScale();
+  markBootPhase(BOOT_M5_BEGIN);
 
   Serial.begin(115200);
-  Serial.println("M5StickC Insta360 Camera Remote");
-  Serial.print("Remote ID: ");
-  Serial.println(REMOTE_IDENTIFIER);
-
-  // Calculate unique GPIO delay for this remote
-  gpioDelay = calculateGPIODelay();
-  Serial.print("GPIO delay for this remote: ");
-  Serial.print(gpioDelay);
-  Serial.println("ms");
-
-  // Record startup time for GPIO delay
-  startupTime = millis();
+  checkPanelSize();
 
-  // Setup GPIO pins - G0 uses hardware pullup, others use pulldown
-  pinMode(SHUTTER_PIN, INPUT);           // G0 has hardware pullup - trigger on LOW (to GND)
-  pinMode(SLEEP_PIN, INPUT_PULLDOWN);    // G26 for Sleep (#5) - trigger on HIGH (to 3.3V)
-  pinMode(WAKE_PIN, INPUT_PULLDOWN);     // G36 for Wake (#6) - trigger on HIGH (to 3.3V)
-
-  Serial.println("GPIO pins configured:");
-  Serial.println("G0 (Shutter) - INPUT (hardware pullup, trigger on GND)");
-  Serial.println("G26 (Sleep) - INPUT_PULLDOWN (trigger on 3.3V)");
-  Serial.println("G36 (Wake) - INPUT_PULLDOWN (trigger on 3.3V)");
-  Serial.println("GPIO input disabled for 2 seconds after startup...");
-
-  // Load saved cameras
+  // Saved cameras are needed before advertising so reconnects are recognised
   loadAllCameras();
-  
-  // Apply saved layout preference (Orientation)
-  applyLayoutRotation();
+  markBootPhase(BOOT_SETTINGS);
 
-  // Initialize BLE
-  // Use exact name to match official remotes (Ace Pro 2 requires exact match)
-  String deviceName = "Insta360 GPS Remote";
-  
+  // Initialize BLE before any non-essential UI work so cameras can reconnect sooner
   // Set custom handler to capture GATTS_IF for unicast support
   BLEDevice::setCustomGattsHandler(myGattsHandler);
-  BLEDevice::init(deviceName.c_str());
+  BLEDevice::init(REMOTE_DEVICE_NAME);
 
   // Create BLE Scanner for camera detection
   pBLEScan = BLEDevice::getScan();
@@ -130,6 +104,7 @@ void setup() {
   pBLEScan->setActiveScan(true); // Active scan uses more power but gets names
   pBLEScan->setInterval(100);
   pBLEScan->setWindow(99);
+  markBootPhase(BOOT_BLE_INIT);
 
   // Create the BLE Server
   pServer = BLEDevice::createServer();
@@ -153,76 +128,117 @@ void setup() {
 
   // Start the service
   pService->start();
+  markBootPhase(BOOT_GATT);
 
   // Start with normal advertising
   setNormalAdvertising();
+  markBootPhase(BOOT_ADVERTISING);
+
+  Serial.println("M5StickC Insta360 Camera Remote");
+  Serial.print("Board: ");
+  Serial.println(boardNames[layoutBoard]);
+  Serial.print("Remote ID: ");
+  Serial.println(REMOTE_IDENTIFIER);
+
+  // Calculate unique GPIO delay for this remote
+  applyTriggerSlot();
+  Serial.print("GPIO delay for this remote: ");
+  Serial.print(gpioDelay);
+  Serial.print("ms");
+  if (REMOTE_SLOT >= 0) {
+    Serial.printf(" (slot %d, adaptive)", REMOTE_SLOT);
+  }
+  Serial.println();
+
+  // Record startup time for GPIO delay
+  startupTime = millis();
+
+  // Setup GPIO pins - G0 uses hardware pullup, others use pulldown
+  pinMode(SHUTTER_PIN, INPUT);           // G0 has hardware pullup - trigger on LOW (to GND)
+  pinMode(SLEEP_PIN, INPUT_PULLDOWN);    // G26 for Sleep (#5) - trigger on HIGH (to 3.3V)
+  pinMode(WAKE_PIN, INPUT_PULLDOWN);     // G36 for Wake (#6) - trigger on HIGH (to 3.3V)
+
+  Serial.println("GPIO pins configured:");
+  Serial.println("G0 (Shutter) - INPUT (hardware pullup, trigger on GND)");
+  Serial.println("G26 (Sleep) - INPUT_PULLDOWN (trigger on 3.3V)");
+  Serial.println("G36 (Wake) - INPUT_PULLDOWN (trigger on 3.3V)");
+  Serial.println("GPIO input disabled for 2 seconds after startup...");
+
+  // loop() sleeps between events; buttons, trigger pins and BLE callbacks wake it
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  attachInputWakeups();
+  markBootPhase(BOOT_INPUTS);
+
+  // Apply saved layout preference (Orientation)
+  applyLayoutRotation();
 
   Serial.println("Ready!");
   updateDisplay();
+  markBootPhase(BOOT_UI);
+
+  // Drawing moves to its own task on the other core from here on
+  startRenderTask();
+
+  reportBootPhases();
 }
 
 // Flag to track if long press was handled to avoid double-triggering short press
 bool ignoreNextRelease = false;
 
-void loop() {
+// One pass over input, BLE events and timers. Split from loop() so the heap
+// probe covers the work but not the idle wait.
+void runLoopIteration() {
+  HEAP_PROBE_SCOPE(HEAP_SITE_LOOP);
+
   M5.update();
+  traceButtonEdges();
+
+  // Apply connection changes and camera packets reported by the BLE callbacks
+  processBleEvents();
 
-  bool anyConnected = (camera1Connected || camera2Connected) && pServer && (pServer->getConnectedCount() > 0);
+  // Pairing runs alongside everything else and owns the buttons while active
+  bool pairingActive = updatePairing();
+
+  bool anyConnected = (countConnectedCameras() > 0) && pServer && (pServer->getConnectedCount() > 0);
 
   // Check GPIO pins for external button presses
   checkGPIOPins();
 
   // --- Smart Wake & Record Monitoring ---
-  if (pendingRecordAfterWake) {
-      int expected = 0;
-      if (camera1.isValid) expected++;
-      if (camera2.isValid) expected++;
-      
-      int connected = 0;
-      if (camera1Connected) connected++;
-      if (camera2Connected) connected++;
-      
-      // Check if we hit our target
-      if (connected >= expected && expected > 0) {
-          Serial.printf("Smart Wake Trigger: Connected %d / Expected %d\n", connected, expected);
-          Serial.println("Smart Wake: All cameras connected! Starting Record...");
-          pendingRecordAfterWake = false;
-          delay(2000); // Give a moment for connection stability
-          executeShutter();
-          updateDisplay();
-      } 
-      // Check timeout (30s to be safe, wake takes time + connection takes time)
-      else if (millis() - wakeRequestTime > 30000) {
-          Serial.println("Smart Wake: Timeout waiting for connections.");
-          pendingRecordAfterWake = false;
-          showCenteredMessage("Wake Failed", "Timeout", RED);
-          delay(2000);
-          updateDisplay();
-      }
-  }
+  // Start each woken camera once its link settles
+  updateSmartWake();
 
   // --- Recording State Management (Timeout Logic) ---
-  // If a camera hasn't sent a timer packet for > 5.0 seconds, assume it stopped recording.
+  // If a camera's timer packets stop for longer than its usual cadence allows
+  // (recordingTimeout(), 5 s until learned), assume it stopped recording.
   unsigned long now = millis();
   
-  if (camera1Connected && camera1.isRecording) {
-    if (now - camera1.lastTimerTime > 5000) {
-      camera1.isRecording = false;
-      Serial.println("Camera 1 recording timeout -> Stopped");
+  bool actualRecording = false;
+  cancelDeadline(DEADLINE_RECORDING_TIMEOUT);
+
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    CameraInfo* camera = &cameras[i];
+    if (!camera->connected || !camera->isRecording) continue;
+
+    unsigned long timeout = recordingTimeout(camera);
+    if (now - camera->lastTimerTime > timeout) {
+      camera->isRecording = false;
+      camera->stopSentTime = 0;
+      captureRecordingChange(i, false);
+      LOGI("Camera %d recording timeout -> Stopped", i + 1);
       updateDisplay();
+      continue;
     }
-  }
-  
-  if (camera2Connected && camera2.isRecording) {
-    if (now - camera2.lastTimerTime > 5000) {
-      camera2.isRecording = false;
-      Serial.println("Camera 2 recording timeout -> Stopped");
-      updateDisplay();
+
+    // Sync global `isRecording` with actual camera states (OR logic)
+    actualRecording = true;
+
+    // Wake up again when the earliest recording camera would time out
+    unsigned long at = camera->lastTimerTime + timeout + 1;
+    if (!deadlines[DEADLINE_RECORDING_TIMEOUT].armed || (long)(at - deadlines[DEADLINE_RECORDING_TIMEOUT].at) < 0) {
+      armDeadline(DEADLINE_RECORDING_TIMEOUT, at);
     }
   }
-
-  // Sync global `isRecording` with actual camera states (OR logic)
-  bool actualRecording = (camera1Connected && camera1.isRecording) || (camera2Connected && camera2.isRecording);
   
   // Handle state transitions
   if (actualRecording != isRecording) {
@@ -239,9 +255,14 @@ void loop() {
 
   // Update recording timer on screen 0 (Dashboard)
   static unsigned long lastTimerUpdate = 0;
-  if (currentScreen == 0 && isRecording && millis() - lastTimerUpdate > 1000) {
-    lastTimerUpdate = millis();
-    updateDashboardTimer(); // Use optimized redraw
+  if (currentScreen == 0 && isRecording) {
+    if (millis() - lastTimerUpdate >= 1000) {
+      lastTimerUpdate = millis();
+      updateDashboardTimer(); // Use optimized redraw
+    }
+    armDeadline(DEADLINE_TIMER_REDRAW, lastTimerUpdate + 1000);
+  } else {
+    cancelDeadline(DEADLINE_TIMER_REDRAW);
   }
 
   // Handle UI updates requested by BLE callbacks
@@ -252,30 +273,30 @@ void loop() {
   }
 
   // Button B - Navigation
-  if (M5.BtnB.wasReleased()) {
+  if (!pairingActive && M5.BtnB.wasReleased()) {
     if (currentScreen == 0) {
         // Go to Pairing Menu
         currentScreen = 1;
         pairingMenuSelection = 0; // Reset to first option
     } else if (currentScreen == 1) {
-        // Cycle Pairing Menu Options (4 items now)
-        pairingMenuSelection = (pairingMenuSelection + 1) % 4;
+        // Cycle Pairing Menu Options (slots, layout, back)
+        pairingMenuSelection = (pairingMenuSelection + 1) % pairingMenuItems;
     }
     updateDisplay();
   }
 
   // Handle Button A (Long Press = Power On/Off, Short Press = Shutter/Action)
   // Check for Long Press (1000ms) - ONLY on Dashboard
-  if (currentScreen == 0 && M5.BtnA.pressedFor(1000) && !ignoreNextRelease) {
-    Serial.println("Button A Long Press detected!");
+  if (!pairingActive && currentScreen == 0 && M5.BtnA.pressedFor(1000) && !ignoreNextRelease) {
+    LOGI("Button A Long Press detected!");
     ignoreNextRelease = true; // Prevent short press trigger on release
     
     // Logic: If cameras connected -> Sleep. If not -> Wake.
     if (anyConnected) {
       executeSleep();
+      processTxQueue(); // Send now so the purple bar replaces the SENT! feedback
       // Feedback in purple bar
-      showBottomStatus("SLEEPING...", PURPLE);
-      delay(1000);
+      showStatusToast("SLEEPING...", PURPLE, 1000, TOAST_NOTICE);
     } else {
       executeWake();
       // executeWake shows its own UI feedback
@@ -284,7 +305,7 @@ void loop() {
   }
 
   // Check for Short Press (Release)
-  if (M5.BtnA.wasReleased()) {
+  if (!pairingActive && M5.BtnA.wasReleased()) {
     if (ignoreNextRelease) {
       // This was the release of a long press - reset flag and do nothing
       ignoreNextRelease = false;
@@ -293,27 +314,19 @@ void loop() {
       if (currentScreen == 0) {
           // Dashboard: Shutter
           if (!anyConnected) {
-            // SMART WAKE & RECORD
-            Serial.println("Smart Wake initiated...");
-            pendingRecordAfterWake = true;
-            wakeRequestTime = millis();
-            executeWake(); // Blocking call (~6s for two cams)
-            
-            // After wake signal sent, show waiting status
-            showCenteredMessage("Waiting for", "Connection...", YELLOW);
+            // SMART WAKE & RECORD - the dashboard shows each camera's progress
+            startSmartWake();
+            updateDisplay();
           } else {
             executeShutter();
             updateDisplay();
           }
       } else if (currentScreen == 1) {
           // Pairing Menu: Select Option
-          if (pairingMenuSelection == 0) {
-              connectCamera1();
-              currentScreen = 0; // Return to dash after pairing attempt
-          } else if (pairingMenuSelection == 1) {
-              connectCamera2();
-              currentScreen = 0;
-          } else if (pairingMenuSelection == 2) {
+          if (pairingMenuSelection < MAX_CAMERAS) {
+              connectCamera(pairingMenuSelection + 1);
+              currentScreen = 0; // Dashboard comes back when pairing ends
+          } else if (pairingMenuSelection == MAX_CAMERAS) {
               // Toggle Layout
               saveLayoutPreference(!isVerticalLayout);
               applyLayoutRotation(); // Rotate screen immediately
@@ -328,5 +341,46 @@ void loop() {
     }
   }
 
-  delay(50);
+  // Rotate wake payloads / finish the wake window
+  updateWake();
+  // Start advertising again once the controller has settled
+  updateAdvertising();
+
+  // Transmit commands queued by this iteration's input handling
+  processTxQueue();
+
+  // Print inter-camera start skew once the last start has been observed
+  reportStartSkew();
+  // Widen or narrow the trigger slot once the last GPIO start has settled
+  updateTriggerSlot();
+
+  // Dismiss the current toast once it has been up long enough
+  updateToast();
+
+  // Keep polling briefly while a button is held so debounce and long press still resolve
+  if (M5.BtnA.isPressed() || M5.BtnB.isPressed()) {
+    armDeadline(DEADLINE_INPUT_POLL, millis() + inputPollInterval);
+  } else {
+    cancelDeadline(DEADLINE_INPUT_POLL);
+  }
+}
+
+void loop() {
+  beginControlPass();
+  runLoopIteration();
+
+  // Diagnostic commands typed into the Serial monitor
+  handleSerialCommands();
+
+  // Write out queued log and capture records while there is nothing else to do
+  drainLog();
+  drainCapture();
+
+  // Periodic allocation report (debug builds with HEAP_PROBE only)
+  heapProbeReport();
+  soakPoll();
+  endControlPass();
+
+  // Sleep until a button/pin edge, a BLE callback or the next deadline
+  waitForEvent();
 }
@@ -0,0 +1,120 @@
+/*
+ * layouts.h
+ * Compile-time screen layouts per board and rotation
+ */
+
+#ifndef LAYOUTS_H
+#define LAYOUTS_H
+
+#include <Arduino.h>
+
+#include "camera.h"
+#include "config.h"
+
+struct ScreenLayout {
+  int16_t width, height;
+  uint8_t rotation;      // M5.Lcd.setRotation() value
+  uint8_t textSize;      // Dashboard names, status bar and timer
+  uint8_t msgTextSize;   // Full-screen messages and the pairing screens
+  int16_t camRadius;     // Dashboard status circle (before per-cell clamping)
+  int16_t iconX, iconY;  // 32x32 icon on the pairing screens
+  int16_t iconLine1Y;    // First text row under the icon
+  int16_t iconLine2Y;    // Second text row under the icon
+};
+
+enum LayoutOrientation {
+  LAYOUT_HORIZONTAL = 0, // Landscape, Button B at right
+  LAYOUT_VERTICAL = 1    // Portrait, Button B at bottom
+};
+
+// [board][orientation], indexed by the BOARD_* values in config.h
+constexpr ScreenLayout boardLayouts[3][2] = {
+  { // M5StickC
+    { 160,  80, 3, 1, 1, 10,  64, 12,  48,  65 },
+    {  80, 160, 0, 1, 1, 10,  24, 40,  85, 105 },
+  },
+  { // M5StickC Plus
+    { 240, 135, 3, 2, 2, 15, 104, 20,  65,  95 },
+    { 135, 240, 0, 2, 1, 15,  51, 50, 100, 120 },
+  },
+  { // M5StickC Plus2
+    { 240, 135, 3, 2, 2, 15, 104, 20,  65,  95 },
+    { 135, 240, 0, 2, 1, 15,  51, 50, 100, 120 },
+  },
+};
+
+constexpr const char* boardNames[3] = { "M5StickC", "M5StickC Plus", "M5StickC Plus2" };
+
+// --- Compile-time checks that every element stays on screen ---
+
+const int bottomBarHeight = 25;
+const int iconSize = 32;
+const int longestMessageChars = 13; // "Connection...", "PAIRING CAM 1", "LAYOUT: HORIZ"
+const int placeholderChars = 5;     // "EMPTY" (never has a record dot)
+const int shortNameChars = 3;       // "X5", "Ace", "ONE" + record dot
+const int recordDotWidth = 11;      // 6px gap + 5px radius
+
+constexpr int charWidth(int textSize) { return 6 * textSize; }
+constexpr int charHeight(int textSize) { return 8 * textSize; }
+constexpr int minInt(int a, int b) { return a < b ? a : b; }
+constexpr int maxInt(int a, int b) { return a > b ? a : b; }
+
+// Widest thing a dashboard cell has to hold at a given text size
+constexpr int cellContentWidth(int textSize) {
+  return maxInt(placeholderChars * charWidth(textSize), shortNameChars * charWidth(textSize) + recordDotWidth);
+}
+
+// Names drop to text size 1 when the cells get too narrow for the layout's size
+constexpr int dashboardTextSize(const ScreenLayout& l, int cellWidth) {
+  return cellContentWidth(l.textSize) <= cellWidth ? l.textSize : 1;
+}
+
+// Icon, the two rows under it and the longest fixed message
+constexpr bool screensFit(const ScreenLayout& l) {
+  return l.iconX >= 0 && l.iconX + iconSize <= l.width &&
+         l.iconY >= 0 && l.iconY + iconSize <= l.iconLine1Y &&
+         l.iconLine1Y + charHeight(l.msgTextSize) <= l.iconLine2Y &&
+         l.iconLine2Y + charHeight(l.msgTextSize) <= l.height &&
+         longestMessageChars * charWidth(l.msgTextSize) <= l.width &&
+         longestMessageChars * charWidth(l.textSize > 1 ? 1 : l.textSize) <= l.width; // Pairing menu
+}
+
+// Dashboard cell geometry, shared by drawDashboard() and the checks below
+constexpr int horizontalCellWidth(const ScreenLayout& l, int cams) { return l.width / cams; }
+constexpr int verticalCellHeight(const ScreenLayout& l, int cams) { return l.height / cams; }
+constexpr int verticalCircleOffset(const ScreenLayout& l, int cams) { return minInt(10, verticalCellHeight(l, cams) / 4); }
+constexpr int verticalTextOffset(const ScreenLayout& l, int cams) { return minInt(15, verticalCellHeight(l, cams) / 5); }
+// The bottom cell sits higher to leave room for the timer bar
+constexpr int verticalLastLift(const ScreenLayout& l, int cams) { return cams > 1 ? minInt(10, verticalCellHeight(l, cams) / 8) : 0; }
+constexpr int horizontalRadius(const ScreenLayout& l, int cams) { return minInt(l.camRadius, horizontalCellWidth(l, cams) / 4); }
+constexpr int verticalRadius(const ScreenLayout& l, int cams) { return minInt(l.camRadius, verticalCellHeight(l, cams) / 5); }
+
+// Side-by-side cells: circle above the name, name + record dot within the cell
+constexpr bool horizontalDashboardFits(const ScreenLayout& l, int cams) {
+  return l.height / 2 - 25 - horizontalRadius(l, cams) >= 0 &&
+         l.height / 2 + charHeight(l.textSize) <= l.height - bottomBarHeight &&
+         cellContentWidth(dashboardTextSize(l, horizontalCellWidth(l, cams))) <= horizontalCellWidth(l, cams);
+}
+
+// Stacked cells: first circle below the top edge, last name above the bottom
+constexpr bool verticalDashboardFits(const ScreenLayout& l, int cams) {
+  return verticalCellHeight(l, cams) / 2 - verticalCircleOffset(l, cams) - verticalRadius(l, cams) >= 0 &&
+         (cams - 1) * verticalCellHeight(l, cams) + verticalCellHeight(l, cams) / 2 - verticalLastLift(l, cams) +
+             verticalTextOffset(l, cams) + charHeight(l.textSize) <= l.height &&
+         cellContentWidth(dashboardTextSize(l, l.width)) <= l.width;
+}
+
+static_assert(screensFit(boardLayouts[BOARD_M5STICKC][LAYOUT_HORIZONTAL]), "M5StickC landscape layout off screen");
+static_assert(screensFit(boardLayouts[BOARD_M5STICKC][LAYOUT_VERTICAL]), "M5StickC portrait layout off screen");
+static_assert(screensFit(boardLayouts[BOARD_M5STICKC_PLUS][LAYOUT_HORIZONTAL]), "M5StickC Plus landscape layout off screen");
+static_assert(screensFit(boardLayouts[BOARD_M5STICKC_PLUS][LAYOUT_VERTICAL]), "M5StickC Plus portrait layout off screen");
+static_assert(screensFit(boardLayouts[BOARD_M5STICKC_PLUS2][LAYOUT_HORIZONTAL]), "M5StickC Plus2 landscape layout off screen");
+static_assert(screensFit(boardLayouts[BOARD_M5STICKC_PLUS2][LAYOUT_VERTICAL]), "M5StickC Plus2 portrait layout off screen");
+
+// The dashboard depends on MAX_CAMERAS, so only the board being built is checked
+static_assert(horizontalDashboardFits(boardLayouts[REMOTE_BOARD][LAYOUT_HORIZONTAL], MAX_CAMERAS),
+              "Horizontal dashboard does not fit MAX_CAMERAS cells on this board");
+static_assert(verticalDashboardFits(boardLayouts[REMOTE_BOARD][LAYOUT_VERTICAL], MAX_CAMERAS),
+              "Vertical dashboard does not fit MAX_CAMERAS cells on this board");
+
+#endif // LAYOUTS_H
@@ -0,0 +1,237 @@
+/*
+ * log.h
+ * Levelled logging with deferred formatting
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+#include <type_traits>
+
+#include "scheduler.h"
+
+// LOGE/LOGW/LOGI/LOGD(fmt, ...) replace direct Serial prints on the busy
+// paths. Levels above LOG_LEVEL compile to nothing. An enabled call only
+// copies the format pointer and its arguments into a ring; drainLog() does
+// the formatting and writes to Serial from loop() when it would otherwise be
+// idle, never blocking on a full UART buffer.
+//
+// Arguments are captured as 32-bit integers (char/short/int/long, pointers)
+// or, for %s, as a copy of up to LOG_STR_LEN-1 characters. No floats or
+// 64-bit values. At most LOG_MAX_ARGS arguments, LOG_MAX_STRS of them strings.
+//
+// With LOG_BINARY defined, records go out as binary frames keyed by a hash of
+// the format string instead of text; tools/log_decode.py turns them back into
+// text using the format strings found in the sketch sources.
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Must be a power of two
+#define LOG_QUEUE_SIZE 32
+#define LOG_MAX_ARGS 6
+#define LOG_MAX_STRS 2
+#define LOG_STR_LEN 24
+#define LOG_NO_STR 0xFF
+
+struct LogRecord {
+  const char* fmt;
+  uint32_t id;                // FNV-1a of fmt, computed at compile time
+  uint32_t time;              // millis() when logged
+  uint8_t level;
+  uint8_t argc;
+  uint8_t strMask;            // Bit n set: args[n] indexes strs (LOG_NO_STR if out of room)
+  uint32_t args[LOG_MAX_ARGS];
+  char strs[LOG_MAX_STRS][LOG_STR_LEN];
+};
+
+LogRecord logQueue[LOG_QUEUE_SIZE];
+uint32_t logHead = 0;         // Next record to drain (read by loop(), moved under logMux)
+uint32_t logTail = 0;         // Next record to fill (under logMux)
+uint32_t logDropped = 0;
+portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+
+// 32-bit FNV-1a, usable in constant expressions
+constexpr uint32_t logHash(const char* s, uint32_t h = 2166136261u) {
+  return *s ? logHash(s + 1, (h ^ (uint8_t)*s) * 16777619u) : h;
+}
+
+// Argument capture - integers and pointers by value, C strings by copy
+inline void logCapture(LogRecord& rec, const char* s) {
+  if (rec.argc >= LOG_MAX_ARGS) return;
+  uint8_t n = 0;
+  for (int i = 0; i < rec.argc; i++) {
+    if (rec.strMask & (1 << i)) n++;
+  }
+  if (n < LOG_MAX_STRS) snprintf(rec.strs[n], LOG_STR_LEN, "%s", s ? s : "(null)");
+  rec.strMask |= 1 << rec.argc;
+  rec.args[rec.argc++] = n < LOG_MAX_STRS ? n : LOG_NO_STR;
+}
+inline void logCapture(LogRecord& rec, char* s) { logCapture(rec, (const char*)s); }
+
+template <typename T>
+inline void logCapture(LogRecord& rec, T value) {
+  static_assert(sizeof(T) <= sizeof(uintptr_t), "LOGx arguments must fit in 32 bits (no 64-bit values)");
+  if (rec.argc >= LOG_MAX_ARGS) return;
+  rec.args[rec.argc++] = (uint32_t)(uintptr_t)value;
+}
+
+inline void logCaptureAll(LogRecord&) {}
+
+template <typename T, typename... Rest>
+inline void logCaptureAll(LogRecord& rec, T first, Rest... rest) {
+  logCapture(rec, first);
+  logCaptureAll(rec, rest...);
+}
+
+// Reserve a record, fill it and publish it. Safe from loop() and callbacks.
+template <typename... Args>
+void logPush(uint8_t level, const char* fmt, uint32_t id, Args... args) {
+  LogRecord rec;
+  rec.fmt = fmt;
+  rec.id = id;
+  rec.time = millis();
+  rec.level = level;
+  rec.argc = 0;
+  rec.strMask = 0;
+  logCaptureAll(rec, args...);
+
+  portENTER_CRITICAL(&logMux);
+  if (logTail - logHead >= LOG_QUEUE_SIZE) {
+    logDropped++;
+  } else {
+    logQueue[logTail & (LOG_QUEUE_SIZE - 1)] = rec;
+    logTail++;
+  }
+  portEXIT_CRITICAL(&logMux);
+}
+
+#define LOG_AT(level, fmt, ...) \
+  logPush(level, fmt, std::integral_constant<uint32_t, logHash(fmt)>::value, ##__VA_ARGS__)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOGE(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define LOGE(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOGW(fmt, ...) LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define LOGW(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOGI(fmt, ...) LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define LOGI(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOGD(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define LOGD(fmt, ...) do {} while (0)
+#endif
+
+bool logPending() {
+  portENTER_CRITICAL(&logMux);
+  bool pending = logHead != logTail;
+  portEXIT_CRITICAL(&logMux);
+  return pending;
+}
+
+// String for a %s argument captured in this record
+const char* logArgString(const LogRecord& rec, int i) {
+  return rec.args[i] == LOG_NO_STR ? "?" : rec.strs[rec.args[i]];
+}
+
+#ifdef LOG_BINARY
+
+// Frame: A5 5A | id u32 | time u32 | level u8 | argc u8 | args, all
+// little-endian. Each argument is a u32, or for %s a length byte followed by
+// the characters.
+size_t encodeLogRecord(const LogRecord& rec, uint8_t* out) {
+  size_t n = 0;
+  out[n++] = 0xA5;
+  out[n++] = 0x5A;
+  memcpy(out + n, &rec.id, 4);
+  n += 4;
+  memcpy(out + n, &rec.time, 4);
+  n += 4;
+  out[n++] = rec.level;
+  out[n++] = rec.argc;
+  for (int i = 0; i < rec.argc; i++) {
+    if (rec.strMask & (1 << i)) {
+      const char* s = logArgString(rec, i);
+      uint8_t len = strlen(s);
+      out[n++] = len;
+      memcpy(out + n, s, len);
+      n += len;
+    } else {
+      memcpy(out + n, &rec.args[i], 4);
+      n += 4;
+    }
+  }
+  return n;
+}
+
+#else
+
+const char logLevelChars[] = "-EWID";
+
+size_t encodeLogRecord(const LogRecord& rec, uint8_t* out) {
+  uintptr_t a[LOG_MAX_ARGS] = {0};
+  for (int i = 0; i < rec.argc; i++) {
+    a[i] = (rec.strMask & (1 << i)) ? (uintptr_t)logArgString(rec, i) : rec.args[i];
+  }
+  char* text = (char*)out;
+  int n = snprintf(text, 160, "[%c %lu] ", logLevelChars[rec.level], (unsigned long)rec.time);
+  n += snprintf(text + n, 160 - n, rec.fmt, a[0], a[1], a[2], a[3], a[4], a[5]);
+  if (n > 158) n = 158;
+  if (n > 0 && text[n - 1] != '\n') text[n++] = '\n';
+  return n;
+}
+
+#endif
+
+// How soon to retry when the UART TX buffer was full
+const unsigned long logRetryInterval = 5;
+
+// Write queued records while the UART has room. Called from loop() before it
+// sleeps; returns without blocking once the TX buffer is full. Dropped
+// records are reported once the queue has room for the report.
+void drainLog() {
+  uint8_t buffer[160];
+
+  for (;;) {
+    while (logPending()) {
+      const LogRecord& rec = logQueue[logHead & (LOG_QUEUE_SIZE - 1)];
+      size_t len = encodeLogRecord(rec, buffer);
+      if (Serial.availableForWrite() < (int)len) {
+        armDeadline(DEADLINE_LOG_DRAIN, millis() + logRetryInterval); // UART busy - retry shortly
+        return;
+      }
+      Serial.write(buffer, len);
+      // Free the slot under the lock, so a producer on the other core sees the
+      // record read before it writes there
+      portENTER_CRITICAL(&logMux);
+      logHead++;
+      portEXIT_CRITICAL(&logMux);
+    }
+
+    portENTER_CRITICAL(&logMux);
+    uint32_t dropped = logDropped;
+    logDropped = 0;
+    portEXIT_CRITICAL(&logMux);
+    if (!dropped) break;
+    LOGW("Log queue overflow, %lu records dropped", (unsigned long)dropped);
+  }
+  cancelDeadline(DEADLINE_LOG_DRAIN);
+}
+
+#endif // LOG_H
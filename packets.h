@@ -0,0 +1,137 @@
+/*
+ * packets.h
+ * In-place decoder for camera notification packets
+ */
+
+#ifndef PACKETS_H
+#define PACKETS_H
+
+#include <Arduino.h>
+
+// Frame layout shared with the command payloads in config.h:
+//   FC EF FE | type | length (2 bytes, big endian) | payload[length]
+#define FRAME_HEADER_LEN 6
+#define FRAME_MAGIC_0 0xFC
+#define FRAME_MAGIC_1 0xEF
+#define FRAME_MAGIC_2 0xFE
+
+// Unframed timer packets (older firmware) are at least this long
+#define MIN_TIMER_PACKET_LEN 18
+
+enum PacketKind {
+  PACKET_INVALID = 0, // Bad header/length or nothing recognisable
+  PACKET_TIMER,       // Carries a recording clock ("MM:SS" / "H:MM:SS")
+  PACKET_STATUS       // Well-formed frame without a clock
+};
+
+// Result of decoding one notification. `payload` points into the caller's
+// buffer - nothing is copied.
+struct DecodedPacket {
+  PacketKind kind;
+  uint8_t type;            // Frame type byte, 0 for unframed timer packets
+  const uint8_t* payload;
+  uint16_t payloadLen;
+  uint32_t elapsedSeconds; // PACKET_TIMER only
+};
+
+// Latest decoded state per camera
+struct CameraStatus {
+  uint32_t elapsedSeconds; // Recording time from the last timer packet
+  uint8_t lastStatusType;  // Type byte of the last non-timer frame
+  uint32_t timerPackets;
+  uint32_t statusPackets;
+  uint32_t rejectedPackets;
+};
+
+static inline bool isDigitByte(uint8_t c) {
+  return c >= '0' && c <= '9';
+}
+
+// Find an ASCII clock in the buffer and convert it to seconds. Accepts
+// "MM:SS" and "H:MM:SS"/"HH:MM:SS"; fields after a ':' must be two digits
+// below 60, otherwise the candidate is skipped.
+bool parseClock(const uint8_t* data, size_t len, uint32_t* seconds) {
+  for (size_t i = 0; i < len; i++) {
+    if (!isDigitByte(data[i])) continue;
+
+    // Leading field: 1-2 digits
+    uint32_t value = data[i] - '0';
+    size_t pos = i + 1;
+    if (pos < len && isDigitByte(data[pos])) {
+      value = value * 10 + (data[pos] - '0');
+      pos++;
+    }
+
+    // One or two ":NN" fields
+    int fields = 0;
+    bool inRange = true;
+    while (fields < 2 && pos + 2 < len &&
+           data[pos] == ':' && isDigitByte(data[pos + 1]) && isDigitByte(data[pos + 2])) {
+      uint32_t field = (data[pos + 1] - '0') * 10 + (data[pos + 2] - '0');
+      pos += 3;
+      if (field >= 60) {
+        inRange = false;
+        break;
+      }
+      value = value * 60 + field;
+      fields++;
+    }
+
+    if (inRange && fields > 0) {
+      *seconds = value;
+      return true;
+    }
+    i = pos - 1; // Skip the digits we just consumed
+  }
+  return false;
+}
+
+// Decode one notification in place
+PacketKind decodeCameraPacket(const uint8_t* data, size_t len, DecodedPacket* out) {
+  out->kind = PACKET_INVALID;
+  out->type = 0;
+  out->payload = nullptr;
+  out->payloadLen = 0;
+  out->elapsedSeconds = 0;
+
+  if (len >= 3 && data[0] == FRAME_MAGIC_0 && data[1] == FRAME_MAGIC_1 && data[2] == FRAME_MAGIC_2) {
+    // Framed packet - header and declared length must agree with what arrived
+    uint16_t payloadLen = len >= FRAME_HEADER_LEN ? ((uint16_t)data[4] << 8) | data[5] : 0;
+    if (len >= FRAME_HEADER_LEN && (size_t)FRAME_HEADER_LEN + payloadLen == len) {
+      out->type = data[3];
+      out->payload = data + FRAME_HEADER_LEN;
+      out->payloadLen = payloadLen;
+      out->kind = parseClock(out->payload, payloadLen, &out->elapsedSeconds) ? PACKET_TIMER : PACKET_STATUS;
+      return out->kind;
+    }
+    // A split or merged notification - treat it like an unframed packet, so
+    // a clock in it still counts
+  }
+
+  // Unframed - only a long packet with a well-formed clock counts as a timer
+  if (len >= MIN_TIMER_PACKET_LEN && parseClock(data, len, &out->elapsedSeconds)) {
+    out->payload = data;
+    out->payloadLen = len;
+    out->kind = PACKET_TIMER;
+  }
+  return out->kind;
+}
+
+// Fold a decoded packet into a camera's status
+void applyPacketToStatus(CameraStatus* status, const DecodedPacket* packet) {
+  switch (packet->kind) {
+    case PACKET_TIMER:
+      status->elapsedSeconds = packet->elapsedSeconds;
+      status->timerPackets++;
+      break;
+    case PACKET_STATUS:
+      status->lastStatusType = packet->type;
+      status->statusPackets++;
+      break;
+    default:
+      status->rejectedPackets++;
+      break;
+  }
+}
+
+#endif // PACKETS_H
@@ -0,0 +1,240 @@
+/*
+ * render.h
+ * Display render task - drawing and panel flushes off the control loop
+ */
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "display.h"
+#include "log.h"
+#include "trace.h"
+
+// loop() is the control task: BLE events, buttons, shutter sync and timeouts.
+// It never touches the panel. Redraws are posted as RenderRequests to a queue
+// served by a lower-priority render task pinned to the other core, which draws
+// into the frame buffer and pushes the changed tiles over SPI.
+//
+// Frames drawn from shared state (cameras[], the screens, the recording timer)
+// take uiStateMutex. The control task holds it for a whole loop() pass and
+// releases it while it sleeps, so a frame never shows a half-finished pass.
+// The SPI flush runs after the mutex is released. Requests that carry their
+// own text (the pairing screen) don't take it.
+//
+// The 'R' console command prints busy time per task, the longest loop() pass,
+// the queue depth and how much of each frame the tile flush sent.
+
+enum RenderKind : uint8_t {
+  RENDER_FRAME = 0,  // Full screen from state
+  RENDER_TIMER,      // Dashboard timer strip only
+  RENDER_PAIRING,    // Pairing screen with one line of text
+  RENDER_ROTATE,     // Apply the layout's rotation and rebuild the frame buffer
+  RENDER_KIND_COUNT
+};
+
+#define RENDER_QUEUE_DEPTH 8
+#define RENDER_TEXT_LEN 24
+
+struct RenderRequest {
+  RenderKind kind;
+  uint16_t color;
+  char text[RENDER_TEXT_LEN];  // RENDER_PAIRING line
+};
+
+struct RenderStats {
+  uint32_t requests[RENDER_KIND_COUNT];
+  uint32_t coalesced;       // Frames skipped because a newer one was queued
+  uint32_t dropped;         // Queue full (a dropped frame is redrawn later)
+  UBaseType_t maxDepth;
+  uint32_t busyUs;          // Render task drawing and flushing
+  uint32_t stateWaitUs;     // ... of which waiting for uiStateMutex
+  uint32_t stateWaitMaxUs;
+};
+
+QueueHandle_t renderQueue = nullptr;
+SemaphoreHandle_t uiStateMutex = nullptr;
+TaskHandle_t renderTaskHandle = nullptr;
+std::atomic<bool> renderFrameLost(false);  // A frame request didn't fit in the queue
+
+RenderStats renderStats;
+uint32_t controlBusyUs = 0;             // loop() time outside waitForEvent()
+uint32_t controlPassStart = 0;
+uint32_t controlPassMaxUs = 0;
+uint32_t controlPassesOverBudget = 0;
+unsigned long taskStatsSince = 0;
+// Display flush counters at the last report. They keep counting (the render
+// task reads them for its trace), so the report prints the difference.
+uint32_t flushesAtReport = 0;
+uint32_t bytesPushedAtReport = 0;
+uint32_t fullFrameBytesAtReport = 0;
+BaseType_t controlCore = 0;
+BaseType_t renderCore = 0;
+
+const uint32_t renderTaskStack = 6144;
+const UBaseType_t renderTaskPriority = tskIDLE_PRIORITY + 1;
+// Above the render task so control wins if both end up on one core
+const UBaseType_t controlTaskPriority = tskIDLE_PRIORITY + 2;
+// A loop() pass longer than this holds up buttons and BLE events and is
+// logged. No pass waits on purpose: even the advertising settle time
+// (advertisingSettleTime, 100 ms) is a deadline, so the budget sits below it.
+const uint32_t controlPassBudgetUs = 50000;
+
+// Draws one request into gfx without flushing (ui.h)
+void drawRenderRequest(const RenderRequest& req);
+
+bool renderNeedsState(RenderKind kind) {
+  return kind == RENDER_FRAME || kind == RENDER_TIMER;
+}
+
+// Draw and flush one request. On the render task, or inline before it starts.
+void renderNow(const RenderRequest& req) {
+  uint32_t start = micros();
+  trace(TRACE_REDRAW_START, req.kind);
+  uint32_t bytesBefore = displayBytesPushed;
+
+  bool locked = renderTaskHandle && renderNeedsState(req.kind);
+  if (locked) {
+    xSemaphoreTake(uiStateMutex, portMAX_DELAY);
+    uint32_t waited = micros() - start;
+    renderStats.stateWaitUs += waited;
+    if (waited > renderStats.stateWaitMaxUs) renderStats.stateWaitMaxUs = waited;
+  }
+  drawRenderRequest(req);
+  if (locked) xSemaphoreGive(uiStateMutex);
+
+  // Only the regions that differ from the last frame reach the panel
+  flushDisplay();
+  trace(TRACE_REDRAW_END, req.kind, (displayBytesPushed - bytesBefore) / 64);
+  renderStats.requests[req.kind]++;
+  renderStats.busyUs += micros() - start;
+}
+
+void postRender(RenderKind kind, const char* text = nullptr, uint16_t color = 0) {
+  RenderRequest req;
+  req.kind = kind;
+  req.color = color;
+  snprintf(req.text, RENDER_TEXT_LEN, "%s", text ? text : "");
+
+  if (!renderQueue) {
+    renderNow(req); // No render task (setup() or task creation failed)
+    return;
+  }
+  if (xQueueSend(renderQueue, &req, 0) != pdPASS) {
+    renderStats.dropped++;
+    if (renderNeedsState(kind)) renderFrameLost = true;
+    return;
+  }
+  UBaseType_t depth = uxQueueMessagesWaiting(renderQueue);
+  if (depth > renderStats.maxDepth) renderStats.maxDepth = depth;
+}
+
+// Gets the queue as its argument: renderQueue is only set once the task runs
+void renderTask(void* arg) {
+  QueueHandle_t queue = (QueueHandle_t)arg;
+  RenderRequest req;
+  RenderRequest next;
+  for (;;) {
+    xQueueReceive(queue, &req, portMAX_DELAY);
+
+    // A queued full frame supersedes this one
+    if (renderNeedsState(req.kind) && xQueuePeek(queue, &next, 0) == pdPASS && next.kind == RENDER_FRAME) {
+      renderStats.coalesced++;
+      continue;
+    }
+    renderNow(req);
+
+    if (renderFrameLost && uxQueueMessagesWaiting(queue) == 0) {
+      renderFrameLost = false;
+      req.kind = RENDER_FRAME;
+      renderNow(req);
+    }
+  }
+}
+
+// Called at the end of setup(), once the first frame is on the panel
+void startRenderTask() {
+  controlCore = xPortGetCoreID();
+#ifdef CONFIG_FREERTOS_UNICORE
+  renderCore = controlCore;
+#else
+  renderCore = controlCore == 0 ? 1 : 0;
+#endif
+
+  uiStateMutex = xSemaphoreCreateMutex();
+  QueueHandle_t queue = xQueueCreate(RENDER_QUEUE_DEPTH, sizeof(RenderRequest));
+  if (!uiStateMutex || !queue ||
+      xTaskCreatePinnedToCore(renderTask, "render", renderTaskStack, queue,
+                              renderTaskPriority, &renderTaskHandle, renderCore) != pdPASS) {
+    renderTaskHandle = nullptr;
+    Serial.println("Render task not started - drawing from loop()");
+    return;
+  }
+  vTaskPrioritySet(nullptr, controlTaskPriority);
+  renderQueue = queue; // Requests go to the task from here on
+  taskStatsSince = millis();
+}
+
+// loop() brackets each pass with these; the render task draws state in between
+void beginControlPass() {
+  if (uiStateMutex) xSemaphoreTake(uiStateMutex, portMAX_DELAY);
+  controlPassStart = micros();
+}
+
+void endControlPass() {
+  uint32_t pass = micros() - controlPassStart;
+  controlBusyUs += pass;
+  if (pass > controlPassMaxUs) controlPassMaxUs = pass;
+  if (pass > controlPassBudgetUs) {
+    controlPassesOverBudget++;
+    LOGW("Loop pass took %lu ms (budget %lu ms)", (unsigned long)(pass / 1000),
+         (unsigned long)(controlPassBudgetUs / 1000));
+  }
+  if (uiStateMutex) xSemaphoreGive(uiStateMutex);
+}
+
+// Busy share per task since the last report, then reset
+void reportTaskStats() {
+  unsigned long elapsed = millis() - taskStatsSince;
+  if (elapsed == 0) elapsed = 1;
+  const RenderStats& s = renderStats;
+
+  Serial.printf("Tasks over %lu ms:\n", elapsed);
+  Serial.printf("  control core %d prio %u busy %lu ms (%lu%%), longest pass %lu us, %lu over %lu ms budget\n",
+                (int)controlCore, (unsigned)uxTaskPriorityGet(nullptr), (unsigned long)(controlBusyUs / 1000),
+                (unsigned long)(controlBusyUs / 10 / elapsed), (unsigned long)controlPassMaxUs,
+                (unsigned long)controlPassesOverBudget, (unsigned long)(controlPassBudgetUs / 1000));
+  if (!renderTaskHandle) {
+    Serial.println("  render task not running");
+  } else {
+    Serial.printf("  render  core %d prio %u busy %lu ms (%lu%%), state wait %lu ms (max %lu us), stack free %u\n",
+                  (int)renderCore, (unsigned)renderTaskPriority, (unsigned long)(s.busyUs / 1000),
+                  (unsigned long)(s.busyUs / 10 / elapsed), (unsigned long)(s.stateWaitUs / 1000),
+                  (unsigned long)s.stateWaitMaxUs, (unsigned)uxTaskGetStackHighWaterMark(renderTaskHandle));
+    Serial.printf("  queue depth %u now, max %u of %d, %lu coalesced, %lu dropped\n",
+                  (unsigned)uxQueueMessagesWaiting(renderQueue), (unsigned)s.maxDepth, RENDER_QUEUE_DEPTH,
+                  (unsigned long)s.coalesced, (unsigned long)s.dropped);
+  }
+  Serial.printf("  renders frame=%lu timer=%lu pairing=%lu rotate=%lu\n",
+                (unsigned long)s.requests[RENDER_FRAME], (unsigned long)s.requests[RENDER_TIMER],
+                (unsigned long)s.requests[RENDER_PAIRING], (unsigned long)s.requests[RENDER_ROTATE]);
+  uint32_t flushes = displayFlushCount - flushesAtReport;
+  uint32_t pushed = displayBytesPushed - bytesPushedAtReport;
+  uint32_t fullFrames = displayFullFrameBytes - fullFrameBytesAtReport;
+  Serial.printf("  display %lu flushes, %lu KB pushed of %lu KB as full frames (%lu%%)\n", (unsigned long)flushes,
+                (unsigned long)(pushed / 1024), (unsigned long)(fullFrames / 1024),
+                (unsigned long)(fullFrames ? (uint64_t)pushed * 100 / fullFrames : 0));
+
+  memset(&renderStats, 0, sizeof(renderStats));
+  controlBusyUs = 0;
+  controlPassMaxUs = 0;
+  controlPassesOverBudget = 0;
+  flushesAtReport = displayFlushCount;
+  bytesPushedAtReport = displayBytesPushed;
+  fullFrameBytesAtReport = displayFullFrameBytes;
+  taskStatsSince = millis();
+}
+
+#endif // RENDER_H
@@ -0,0 +1,156 @@
+/*
+ * scheduler.h
+ * Event wake-ups and deadline timers for the main loop
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+#include "config.h"
+
+// loop() sleeps until one of these fires or something signals it
+enum DeadlineId {
+  DEADLINE_RECORDING_TIMEOUT = 0, // Earliest camera timer-packet timeout
+  DEADLINE_TIMER_REDRAW,          // 1s dashboard recording timer refresh
+  DEADLINE_SMART_WAKE,            // Next Smart Wake start / 30s timeout
+  DEADLINE_TOAST,                 // Current toast expiry
+  DEADLINE_INPUT_POLL,            // Fast re-poll while a button is held
+  DEADLINE_TX_DUE,                // Next staggered command in the TX queue
+  DEADLINE_WAKE_ROTATE,           // Next wake payload swap / end of the wake window
+  DEADLINE_LOG_DRAIN,             // Retry writing queued log records
+  DEADLINE_GPIO_ACTION,           // Trigger pin action after this remote's gpioDelay
+  DEADLINE_PAIRING,               // End of the current pairing phase
+  DEADLINE_TRIGGER_SLOT,          // End of a GPIO start's slot check window
+  DEADLINE_ADVERTISING,           // Advertising restart once the controller has settled
+  DEADLINE_COUNT
+};
+
+struct Deadline {
+  bool armed;
+  unsigned long at;
+};
+
+Deadline deadlines[DEADLINE_COUNT];
+
+// Longest loop() will sleep with nothing scheduled
+const unsigned long maxIdleWait = 1000;
+// Re-poll interval while a button is down (debounce and long press detection)
+const unsigned long inputPollInterval = 10;
+
+// Task running setup()/loop(), captured in setup() so callbacks can wake it
+TaskHandle_t loopTaskHandle = nullptr;
+
+// Wake loop() from a BLE callback or another task
+void signalLoop() {
+  if (loopTaskHandle) {
+    xTaskNotifyGive(loopTaskHandle);
+  }
+}
+
+// Wake loop() from a GPIO interrupt
+void IRAM_ATTR signalLoopFromISR() {
+  if (loopTaskHandle) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(loopTaskHandle, &woken);
+    if (woken) {
+      portYIELD_FROM_ISR();
+    }
+  }
+}
+
+// External trigger pins. The ISR timestamps each active edge and debounces
+// from those timestamps, so a trigger is neither late by a loop pass nor
+// missed while loop() is busy; checkGPIOPins() turns the edges into actions.
+enum TriggerId {
+  TRIGGER_SHUTTER = 0,  // G0, active LOW
+  TRIGGER_SLEEP,        // G26, active HIGH
+  TRIGGER_WAKE,         // G36, active HIGH
+  TRIGGER_COUNT
+};
+
+struct TriggerEdge {
+  volatile uint32_t edgeUs;   // micros() of the last accepted active edge
+  volatile uint32_t count;    // Active edges accepted so far
+  volatile bool released;     // Pin seen inactive since that edge
+};
+
+TriggerEdge triggerEdges[TRIGGER_COUNT];
+portMUX_TYPE triggerMux = portMUX_INITIALIZER_UNLOCKED;  // edgeUs and count change together
+const uint8_t triggerPins[TRIGGER_COUNT] = { SHUTTER_PIN, SLEEP_PIN, WAKE_PIN };
+const uint8_t triggerActiveLevel[TRIGGER_COUNT] = { LOW, HIGH, HIGH };
+
+void IRAM_ATTR captureTriggerEdge(int id) {
+  uint32_t now = micros();
+  bool active = digitalRead(triggerPins[id]) == triggerActiveLevel[id];
+  TriggerEdge& edge = triggerEdges[id];
+  bool accepted = false;
+
+  portENTER_CRITICAL_ISR(&triggerMux);
+  if (!active) {
+    edge.released = true;
+  } else if (edge.released && (edge.count == 0 || now - edge.edgeUs >= debounceDelay * 1000)) {
+    // Contact bounce: re-triggers only count once released and debounceDelay has passed
+    edge.edgeUs = now;
+    edge.released = false;
+    edge.count++;
+    accepted = true;
+  }
+  portEXIT_CRITICAL_ISR(&triggerMux);
+
+  if (accepted) signalLoopFromISR();
+}
+
+// Copy a trigger's edge count and time together, so an edge landing in
+// between cannot pair the new count with the old time
+void readTriggerEdge(int id, uint32_t* count, uint32_t* edgeUs) {
+  portENTER_CRITICAL(&triggerMux);
+  *count = triggerEdges[id].count;
+  *edgeUs = triggerEdges[id].edgeUs;
+  portEXIT_CRITICAL(&triggerMux);
+}
+
+void IRAM_ATTR shutterTriggerISR() { captureTriggerEdge(TRIGGER_SHUTTER); }
+void IRAM_ATTR sleepTriggerISR() { captureTriggerEdge(TRIGGER_SLEEP); }
+void IRAM_ATTR wakeTriggerISR() { captureTriggerEdge(TRIGGER_WAKE); }
+
+void armDeadline(DeadlineId id, unsigned long at) {
+  deadlines[id].armed = true;
+  deadlines[id].at = at;
+}
+
+void cancelDeadline(DeadlineId id) {
+  deadlines[id].armed = false;
+}
+
+// Watch the button and trigger pins so an edge wakes loop() immediately
+void attachInputWakeups() {
+  for (int i = 0; i < TRIGGER_COUNT; i++) {
+    triggerEdges[i].released = digitalRead(triggerPins[i]) != triggerActiveLevel[i];
+  }
+  attachInterrupt(digitalPinToInterrupt(BTN_A_PIN), signalLoopFromISR, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(BTN_B_PIN), signalLoopFromISR, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(SHUTTER_PIN), shutterTriggerISR, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(SLEEP_PIN), sleepTriggerISR, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(WAKE_PIN), wakeTriggerISR, CHANGE);
+}
+
+// Block until signalled or the earliest armed deadline is due
+void waitForEvent() {
+  unsigned long now = millis();
+  unsigned long wait = maxIdleWait;
+
+  for (int i = 0; i < DEADLINE_COUNT; i++) {
+    if (!deadlines[i].armed) continue;
+    long remaining = (long)(deadlines[i].at - now);
+    if (remaining <= 0) return; // Already due - run loop() again now
+    if ((unsigned long)remaining < wait) {
+      wait = remaining;
+    }
+  }
+
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+}
+
+#endif // SCHEDULER_H
@@ -0,0 +1,296 @@
+/*
+ * settings.h
+ * Persistent settings - one versioned, CRC-checked record in NVS
+ */
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <Arduino.h>
+#include "Preferences.h"
+
+#include "camera.h"
+
+// Everything we persist lives in a single blob ("remote"/"settings"), read
+// with one NVS call at boot and rewritten whole on every change. NVS writes a
+// blob as a new entry before retiring the old one, so a reset mid-save leaves
+// the previous record intact. Older firmware kept one namespace per camera
+// plus "ui_settings"; those are migrated on first boot and then erased.
+
+#define SETTINGS_NAMESPACE "remote"
+#define SETTINGS_KEY "settings"
+#define SETTINGS_VERSION 1
+
+// Stored slots. Fixed so the record size doesn't change with MAX_CAMERAS.
+#define SETTINGS_SLOTS 6
+
+// Older firmware had two cameras, in namespaces "camera1" and "camera2"
+#define LEGACY_CAMERA_SLOTS 2
+
+struct StoredCamera {
+  char name[30];
+  uint8_t address[6];     // BD_ADDR as Bluedroid reports it
+  uint8_t addressType;    // BLE_ADDR_TYPE_*, or ADDR_TYPE_UNKNOWN
+  uint8_t wakePayload[6];
+  uint8_t valid;
+};
+
+struct SettingsRecord {
+  uint8_t version;
+  uint8_t flags;          // SETTINGS_FLAG_*
+  uint8_t reserved[2];
+  StoredCamera cameras[SETTINGS_SLOTS];
+  uint32_t crc;           // CRC-32 of every byte before this field
+};
+
+#define SETTINGS_FLAG_VERTICAL_LAYOUT 0x01
+
+static_assert(MAX_CAMERAS <= SETTINGS_SLOTS, "Settings record holds at most SETTINGS_SLOTS cameras");
+
+Preferences preferences;
+
+// Standard CRC-32 (reflected, polynomial 0xEDB88320), bitwise - the record is
+// only a few hundred bytes and is checked once per boot.
+uint32_t crc32(const uint8_t* data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+uint32_t settingsCrc(const SettingsRecord& record) {
+  return crc32((const uint8_t*)&record, offsetof(SettingsRecord, crc));
+}
+
+// Strip leading/trailing whitespace without leaving the buffer
+void trimInPlace(char* text) {
+  char* start = text;
+  while (*start && isspace((unsigned char)*start)) start++;
+  size_t len = strlen(start);
+  while (len > 0 && isspace((unsigned char)start[len - 1])) len--;
+  memmove(text, start, len);
+  text[len] = '\0';
+}
+
+// Reset the runtime fields of a slot that was just loaded or saved
+void resetCameraRuntime(CameraInfo* camera) {
+  camera->batteryLevel = -1;
+  camera->isRecording = false;
+  camera->lastTimerTime = 0;
+}
+
+// Write cameras[] and the UI settings as one record
+void saveSettings() {
+  SettingsRecord record;
+  memset(&record, 0, sizeof(record));
+  record.version = SETTINGS_VERSION;
+  if (isVerticalLayout) record.flags |= SETTINGS_FLAG_VERTICAL_LAYOUT;
+
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    StoredCamera* stored = &record.cameras[i];
+    if (!cameras[i].isValid) continue;
+    snprintf(stored->name, sizeof(stored->name), "%s", cameras[i].name);
+    unpackAddress(cameras[i].address, stored->address);
+    stored->addressType = cameras[i].addressType;
+    memcpy(stored->wakePayload, cameras[i].wakePayload, 6);
+    stored->valid = 1;
+  }
+  record.crc = settingsCrc(record);
+
+  preferences.begin(SETTINGS_NAMESPACE, false);
+  size_t written = preferences.putBytes(SETTINGS_KEY, &record, sizeof(record));
+  preferences.end();
+
+  if (written != sizeof(record)) {
+    Serial.println("Settings save FAILED");
+  }
+}
+
+// Read the settings record into cameras[]. Returns false if it is missing,
+// the wrong size or version, or fails its CRC.
+bool loadSettings() {
+  SettingsRecord record;
+  preferences.begin(SETTINGS_NAMESPACE, true);
+  size_t len = preferences.getBytes(SETTINGS_KEY, &record, sizeof(record));
+  preferences.end();
+  if (len == 0) return false;
+
+  if (record.version != SETTINGS_VERSION || len != sizeof(SettingsRecord)) {
+    Serial.printf("Settings version %d (%u bytes) not supported - ignoring it\n", record.version, (unsigned)len);
+    return false;
+  }
+
+  if (record.crc != settingsCrc(record)) {
+    Serial.println("Settings CRC mismatch - ignoring record");
+    return false;
+  }
+
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    const StoredCamera* saved = &record.cameras[i];
+    CameraInfo* camera = &cameras[i];
+    camera->isValid = saved->valid && saved->name[0] != '\0';
+    if (!camera->isValid) continue;
+    snprintf(camera->name, sizeof(camera->name), "%.*s", (int)sizeof(saved->name), saved->name);
+    camera->address = packAddress(saved->address);
+    camera->addressType = saved->addressType;
+    memcpy(camera->wakePayload, saved->wakePayload, 6);
+    resetCameraRuntime(camera);
+  }
+  isVerticalLayout = (record.flags & SETTINGS_FLAG_VERTICAL_LAYOUT) != 0;
+  return true;
+}
+
+// Read one camera from the pre-record per-camera namespace
+void loadLegacyCamera(int cameraNum, CameraInfo* camera) {
+  char namespaceName[12];
+  snprintf(namespaceName, sizeof(namespaceName), "camera%d", cameraNum);
+
+  char address[20] = "";
+  camera->name[0] = '\0';
+
+  preferences.begin(namespaceName, true);
+  preferences.getString("name", camera->name, 30);
+  preferences.getString("address", address, sizeof(address));
+  trimInPlace(address);
+
+  if (preferences.getBytes("wake", camera->wakePayload, 6) == 6) {
+    camera->isValid = (strlen(camera->name) > 0) && parseAddress(address, &camera->address);
+    camera->addressType = ADDR_TYPE_UNKNOWN;
+    resetCameraRuntime(camera);
+  } else {
+    camera->isValid = false;
+  }
+  preferences.end();
+}
+
+// Erase an old namespace if it is there. A read-write open would create it.
+void clearLegacyNamespace(const char* name) {
+  if (!preferences.begin(name, true)) return;
+  preferences.end();
+  preferences.begin(name, false);
+  preferences.clear();
+  preferences.end();
+}
+
+// Pull settings out of the old namespaces, store them as a record and erase
+// the old keys. Returns false if there was nothing to migrate.
+bool migrateLegacySettings() {
+  bool found = false;
+  for (int i = 0; i < LEGACY_CAMERA_SLOTS && i < MAX_CAMERAS; i++) {
+    loadLegacyCamera(i + 1, &cameras[i]);
+    if (cameras[i].isValid) found = true;
+  }
+
+  preferences.begin("ui_settings", true);
+  if (preferences.isKey("vert_layout")) found = true;
+  isVerticalLayout = preferences.getBool("vert_layout", false);
+  preferences.end();
+
+  if (!found) return false;
+
+  Serial.println("Migrating settings to a single record");
+  saveSettings();
+
+  char namespaceName[12];
+  for (int i = 0; i < LEGACY_CAMERA_SLOTS; i++) {
+    snprintf(namespaceName, sizeof(namespaceName), "camera%d", i + 1);
+    clearLegacyNamespace(namespaceName);
+  }
+  clearLegacyNamespace("ui_settings");
+  return true;
+}
+
+void saveLayoutPreference(bool vertical) {
+  isVerticalLayout = vertical;
+  saveSettings();
+  Serial.print("Layout saved: ");
+  Serial.println(vertical ? "Vertical" : "Horizontal");
+}
+
+void loadAllCameras() {
+  Serial.println("=== Loading all cameras ===");
+  initCameraRegistry();
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    cameras[i].isValid = false;
+  }
+
+  if (!loadSettings() && !migrateLegacySettings()) {
+    Serial.println("No saved settings - starting fresh");
+    isVerticalLayout = false;
+  }
+
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    CameraInfo* camera = &cameras[i];
+    Serial.printf("Camera %d: ", i + 1);
+    if (!camera->isValid) {
+      Serial.println("empty");
+      continue;
+    }
+    char address[18];
+    formatAddress(camera->address, address, sizeof(address));
+    Serial.printf("%s @ %s, wake ", camera->name, address);
+    for (int b = 0; b < 6; b++) {
+      Serial.printf("%02X ", camera->wakePayload[b]);
+    }
+    Serial.println();
+  }
+  Serial.print("Loaded Layout: ");
+  Serial.println(isVerticalLayout ? "Vertical" : "Horizontal");
+
+  Serial.println("=== Camera loading complete ===");
+}
+
+void saveCamera(int cameraNum, const char* cameraName, uint64_t cameraAddress, uint8_t addressType) {
+  if (cameraNum < 1 || cameraNum > MAX_CAMERAS) return;
+  CameraInfo* camera = &cameras[cameraNum - 1];
+
+  Serial.print("Saving camera ");
+  Serial.print(cameraNum);
+  Serial.print(": ");
+  Serial.print(cameraName);
+  Serial.print(" @ ");
+  char addressText[18];
+  formatAddress(cameraAddress, addressText, sizeof(addressText));
+  Serial.println(addressText);
+
+  // Extract wake payload from camera name (last 6 characters)
+  size_t nameLen = strlen(cameraName);
+  if (nameLen >= 6) {
+    const char* nameEnd = cameraName + nameLen - 6;
+    Serial.print("Wake payload suffix: ");
+    Serial.println(nameEnd);
+
+    // Convert to ASCII bytes
+    for (int i = 0; i < 6; i++) {
+      camera->wakePayload[i] = (uint8_t)nameEnd[i];
+    }
+
+    // Save camera info
+    snprintf(camera->name, 30, "%s", cameraName);
+    camera->address = cameraAddress;
+    camera->addressType = addressType;
+    camera->isValid = true;
+    resetCameraRuntime(camera);
+
+    saveSettings();
+    allowListDirty = true;
+
+    Serial.print("Wake payload bytes: ");
+    for (int i = 0; i < 6; i++) {
+      Serial.printf("%02X ", camera->wakePayload[i]);
+    }
+    Serial.println();
+    Serial.print("Camera ");
+    Serial.print(cameraNum);
+    Serial.println(" saved successfully");
+  } else {
+    Serial.println("Camera name too short for valid wake payload");
+    camera->isValid = false;
+  }
+}
+
+#endif // SETTINGS_H
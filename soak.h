@@ -0,0 +1,164 @@
+/*
+ * soak.h
+ * Connect/disconnect churn counters, heap drift and registry checks
+ */
+
+#ifndef SOAK_H
+#define SOAK_H
+
+#include <Arduino.h>
+
+#include "camera.h"
+#include "log.h"
+
+// The remote runs all day while cameras drop in and out of range, so every
+// link event is counted and the camera registry (cameras[] and connIdSlot[])
+// is checked for consistency after each one. The heap is sampled whenever no
+// camera has been connected for soakIdleSettle ms: every such idle point
+// should look the same, so a free heap that keeps falling between them is a
+// leak in the connect/disconnect path, not load.
+//
+// The 'S' console command prints the counters and toggles a report every
+// soakReportInterval ms, for leaving a remote on a bench with cameras cycling.
+
+enum SoakConnectKind {
+  SOAK_CONNECT_KNOWN,     // Saved camera reconnecting
+  SOAK_CONNECT_PAIRED,    // Camera saved by this connection
+  SOAK_CONNECT_REJECTED   // Unknown device or failed pairing, dropped
+};
+
+struct SoakCounters {
+  uint32_t connects[3];          // By SoakConnectKind
+  uint32_t disconnects;
+  uint32_t untrackedDisconnects; // Links we never mapped to a slot (rejected devices)
+  uint32_t registryErrors;       // Failed checks after a link event
+  uint32_t idleSamples;
+};
+
+SoakCounters soakCounters;
+uint32_t soakIdleBaseline = 0;   // Free heap at the first idle point
+uint32_t soakIdleLast = 0;       // ... and at the latest one
+uint32_t soakIdleLowest = 0;
+bool soakIdleSampled = false;    // This idle period has been sampled
+unsigned long soakLastLinkEvent = 0;
+bool soakReporting = false;
+unsigned long soakLastReport = 0;
+
+const unsigned long soakIdleSettle = 2000;      // Let the stack release link buffers first
+const unsigned long soakReportInterval = 60000;
+const uint32_t soakDriftLimit = 4096;           // Idle free heap drop that counts as a leak
+
+// Every connected camera owns its connId mapping and every mapping points
+// back at a connected camera. Returns the number of violations.
+int checkCameraRegistry(bool verbose) {
+  int errors = 0;
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    const CameraInfo& camera = cameras[i];
+    if (!camera.connected) {
+      if (camera.connId != NO_CONN_ID) {
+        if (verbose) LOGE("Registry: slot %d disconnected but holds connId %u", i + 1, camera.connId);
+        errors++;
+      }
+      continue;
+    }
+    if (camera.connId < MAX_CONN_IDS && connIdSlot[camera.connId] != i) {
+      if (verbose) LOGE("Registry: slot %d connId %u maps to slot %u", i + 1, camera.connId, connIdSlot[camera.connId]);
+      errors++;
+    }
+    for (int j = i + 1; j < MAX_CAMERAS; j++) {
+      if (cameras[j].connected && cameras[j].connId == camera.connId) {
+        if (verbose) LOGE("Registry: slots %d and %d share connId %u", i + 1, j + 1, camera.connId);
+        errors++;
+      }
+    }
+  }
+  for (int id = 0; id < MAX_CONN_IDS; id++) {
+    uint8_t slot = connIdSlot[id];
+    if (slot == NO_SLOT) continue;
+    if (slot >= MAX_CAMERAS || !cameras[slot].connected || cameras[slot].connId != id) {
+      if (verbose) LOGE("Registry: stale mapping connId %d -> slot %u", id, slot);
+      errors++;
+    }
+  }
+  return errors;
+}
+
+void soakNoteLinkEvent() {
+  soakLastLinkEvent = millis();
+  soakIdleSampled = false;
+  if (checkCameraRegistry(true) > 0) soakCounters.registryErrors++;
+}
+
+void soakNoteConnect(SoakConnectKind kind) {
+  soakCounters.connects[kind]++;
+  soakNoteLinkEvent();
+}
+
+void soakNoteDisconnect(bool tracked) {
+  soakCounters.disconnects++;
+  if (!tracked) soakCounters.untrackedDisconnects++;
+  soakNoteLinkEvent();
+}
+
+// Largest free block as a share of free heap, 0 = unfragmented
+int heapFragmentation(uint32_t freeHeap, uint32_t largest) {
+  return freeHeap ? 100 - (int)((uint64_t)largest * 100 / freeHeap) : 0;
+}
+
+void soakReport() {
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t largest = ESP.getMaxAllocHeap();
+  const SoakCounters& c = soakCounters;
+
+  Serial.printf("Soak: connects known=%lu paired=%lu rejected=%lu disconnects=%lu (untracked %lu) registry_errors=%lu%s\n",
+                (unsigned long)c.connects[SOAK_CONNECT_KNOWN], (unsigned long)c.connects[SOAK_CONNECT_PAIRED],
+                (unsigned long)c.connects[SOAK_CONNECT_REJECTED], (unsigned long)c.disconnects,
+                (unsigned long)c.untrackedDisconnects, (unsigned long)c.registryErrors,
+                checkCameraRegistry(false) ? " INCONSISTENT NOW" : "");
+  Serial.printf("Soak: heap free=%lu min=%lu largest=%lu frag=%d%%\n",
+                (unsigned long)freeHeap, (unsigned long)ESP.getMinFreeHeap(),
+                (unsigned long)largest, heapFragmentation(freeHeap, largest));
+  if (c.idleSamples > 0) {
+    int32_t drift = (int32_t)soakIdleBaseline - (int32_t)soakIdleLast;
+    Serial.printf("Soak: idle heap first=%lu last=%lu lowest=%lu drift=%ld over %lu samples%s\n",
+                  (unsigned long)soakIdleBaseline, (unsigned long)soakIdleLast,
+                  (unsigned long)soakIdleLowest, (long)drift, (unsigned long)c.idleSamples,
+                  drift > (int32_t)soakDriftLimit ? " LEAK?" : "");
+  }
+}
+
+// Called from loop(): takes the idle heap sample and the periodic report
+void soakPoll() {
+  unsigned long now = millis();
+
+  if (!soakIdleSampled && now - soakLastLinkEvent >= soakIdleSettle) {
+    bool anyConnected = false;
+    for (int i = 0; i < MAX_CAMERAS; i++) {
+      if (cameras[i].connected) anyConnected = true;
+    }
+    if (!anyConnected) {
+      soakIdleLast = ESP.getFreeHeap();
+      if (soakCounters.idleSamples == 0) {
+        soakIdleBaseline = soakIdleLast;
+        soakIdleLowest = soakIdleLast;
+      }
+      if (soakIdleLast < soakIdleLowest) soakIdleLowest = soakIdleLast;
+      soakCounters.idleSamples++;
+    }
+    soakIdleSampled = true; // Connected: wait for the next link event instead
+  }
+
+  if (soakReporting && now - soakLastReport >= soakReportInterval) {
+    soakLastReport = now;
+    soakReport();
+  }
+}
+
+void toggleSoakReporting() {
+  soakReporting = !soakReporting;
+  soakLastReport = millis();
+  soakReport();
+  Serial.printf("Soak report every %lu s %s\n", soakReportInterval / 1000, soakReporting ? "on" : "off");
+}
+
+#endif // SOAK_H
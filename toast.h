@@ -0,0 +1,77 @@
+/*
+ * toast.h
+ * Timed messages over the current screen, dismissed by deadline
+ */
+
+#ifndef TOAST_H
+#define TOAST_H
+
+#include <Arduino.h>
+
+#include "log.h"
+
+// Posts a redraw of the current screen (ui.h)
+void updateDisplay();
+
+// One toast is up at a time. A new one replaces it unless the one showing has
+// a higher priority. Every frame draws the toast from this state (ui.h) and
+// updateToast() dismisses it when it expires, so input and BLE events keep
+// being handled while a message is on screen.
+enum ToastPriority : uint8_t {
+  TOAST_INFO = 0,   // Command feedback ("SENT!", "SYNC!")
+  TOAST_NOTICE,     // State changes ("WAKING...", "SLEEPING...")
+  TOAST_ERROR       // Something the user has to act on
+};
+
+#define TOAST_TEXT_LEN 16
+
+struct Toast {
+  bool active;
+  bool message;             // Centred box; otherwise the bottom status bar
+  ToastPriority priority;
+  uint16_t color;
+  unsigned long until;
+  char line1[TOAST_TEXT_LEN];
+  char line2[TOAST_TEXT_LEN];
+};
+
+Toast toast;
+
+void showToast(bool message, ToastPriority priority, const char* line1, const char* line2,
+               uint16_t color, unsigned long durationMs) {
+  if (toast.active && priority < toast.priority) {
+    LOGD("Toast '%s' hidden by a higher priority one", line1);
+    return;
+  }
+  toast.active = true;
+  toast.message = message;
+  toast.priority = priority;
+  toast.color = color;
+  toast.until = millis() + durationMs;
+  snprintf(toast.line1, sizeof(toast.line1), "%s", line1 ? line1 : "");
+  snprintf(toast.line2, sizeof(toast.line2), "%s", line2 ? line2 : "");
+  armDeadline(DEADLINE_TOAST, toast.until);
+  updateDisplay();
+}
+
+// Bottom status bar ("SENT!", "WAKING...")
+void showStatusToast(const char* text, uint16_t color, unsigned long durationMs, ToastPriority priority = TOAST_INFO) {
+  showToast(false, priority, text, nullptr, color, durationMs);
+}
+
+// Two-line message box in the middle of the screen
+void showMessageToast(const char* line1, const char* line2, uint16_t color, unsigned long durationMs,
+                      ToastPriority priority = TOAST_ERROR) {
+  showToast(true, priority, line1, line2, color, durationMs);
+}
+
+// Called from loop(); redraws without the toast once it has expired
+void updateToast() {
+  if (toast.active && (long)(millis() - toast.until) >= 0) {
+    toast.active = false;
+    cancelDeadline(DEADLINE_TOAST);
+    updateDisplay();
+  }
+}
+
+#endif // TOAST_H
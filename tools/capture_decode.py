@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+"""Decode a session capture written by the remote (Serial command 'C').
+
+Usage:
+    capture_decode.py serial.log
+    capture_decode.py serial.log --reference known_good.log
+
+Everything outside CAPTURE BEGIN / CAPTURE END is ignored, so a raw Serial
+monitor log works as-is. Writes longer than the capture kept are shown with
+their full length and marked as truncated. Prints a timeline of the camera traffic and how long
+the firmware took to notice each recording start and stop. With --reference,
+the same figures are computed for a second capture (for example one taken
+with the previous firmware against the same cameras) and printed side by side.
+"""
+
+import argparse
+import statistics
+import sys
+
+TYPES = {1: "CONNECT", 2: "DISCONNECT", 3: "WRITE", 4: "RECORDING", 5: "TX"}
+COMMANDS = {0: "other", 1: "shutter", 2: "mode", 3: "screen", 4: "power_off"}
+BROADCAST = 0xFF
+FRAME_MAGIC = bytes([0xFC, 0xEF, 0xFE])
+START_WINDOW_MS = 5000        # Matches maxStartLatency on the device
+
+
+def read_varint(raw, pos):
+    """LEB128 varint at raw[pos:]; returns (value, next pos), or None if cut off."""
+    value, shift = 0, 0
+    while pos < len(raw):
+        value |= (raw[pos] & 0x7F) << shift
+        shift += 7
+        pos += 1
+        if not raw[pos - 1] & 0x80:
+            return value, pos
+    return None
+
+
+def read_records(lines, cameras=None):
+    """Yield (time_ms, type, conn, data, full_len) for every capture in the log.
+
+    Saved cameras listed in the capture header are added to `cameras`
+    (slot -> (address, name)) if a dict is given.
+    """
+    time_ms = None
+    max_data = 64
+    for line in lines:
+        line = line.strip()
+        if line.startswith("CAPTURE BEGIN"):
+            parts = line.split()
+            time_ms = int(parts[2]) if len(parts) > 2 else 0
+            max_data = int(parts[3]) if len(parts) > 3 else 64
+        elif line.startswith("CAPTURE CAMERA"):
+            parts = line.split(None, 4)
+            if cameras is not None and len(parts) == 5:
+                cameras[int(parts[2])] = (parts[3], parts[4])
+        elif line == "CAPTURE END":
+            time_ms = None
+        elif line.startswith("CAPTURE DROPPED"):
+            print(f"warning: {line}", file=sys.stderr)
+        elif time_ms is not None and line.startswith("CAP "):
+            try:
+                raw = bytes.fromhex(line[4:])
+            except ValueError:
+                continue
+            head = read_varint(raw, 0)
+            if head is None or head[1] + 2 > len(raw):
+                continue
+            dt, pos = head
+            kind, conn = raw[pos], raw[pos + 1]
+            size = read_varint(raw, pos + 2)
+            if size is None or size[1] + min(size[0], max_data) != len(raw):
+                continue
+            full_len, pos = size
+            time_ms += dt
+            yield time_ms, TYPES.get(kind, str(kind)), conn, raw[pos:], full_len
+
+
+def describe_write(data, full_len):
+    cut = f" (first {len(data)} of {full_len} bytes)" if full_len > len(data) else ""
+    if data[:3] == FRAME_MAGIC and len(data) >= 6:
+        length = (data[4] << 8) | data[5]
+        text = "".join(chr(b) if 32 <= b < 127 else "." for b in data[6:6 + length])
+        return f"frame type=0x{data[3]:02x} len={length} '{text}'{cut}"
+    text = "".join(chr(b) if 32 <= b < 127 else "." for b in data)
+    return f"raw {full_len} bytes '{text}'{cut}"
+
+
+def describe(kind, conn, data, full_len):
+    if kind == "CONNECT":
+        return f"conn={conn} addr={':'.join(f'{b:02x}' for b in data)}"
+    if kind == "DISCONNECT":
+        return f"conn={conn}"
+    if kind == "WRITE":
+        return f"conn={conn} {describe_write(data, full_len)}"
+    if kind == "RECORDING":
+        return f"slot={conn} {'started' if data and data[0] else 'stopped'}"
+    if kind == "TX":
+        target = "broadcast" if conn == BROADCAST else f"conn={conn}"
+        return f"{COMMANDS.get(data[0], data[0]) if data else '?'} {target}"
+    return data.hex()
+
+
+def transitions(records):
+    """Latency figures for the recording state machine, in ms."""
+    results = {"shutter -> recording start": [],
+               "last write -> recording stop": [],
+               "stop command -> recording stop": [],
+               "write interval while recording": []}
+    slot_conn = {}        # slot -> conn, learned from the write just before a start
+    last_write = {}       # conn -> time of the last write
+    last_tx = {}          # conn (or BROADCAST) -> (time, command)
+    recording = set()
+    for time_ms, kind, conn, data, _ in records:
+        if kind == "WRITE":
+            previous = last_write.get(conn)
+            if previous is not None and any(slot_conn.get(s) == conn for s in recording):
+                results["write interval while recording"].append(time_ms - previous)
+            last_write[conn] = time_ms
+        elif kind == "TX" and data:
+            last_tx[conn] = (time_ms, data[0])
+        elif kind == "DISCONNECT":
+            last_write.pop(conn, None)
+        elif kind == "RECORDING" and data:
+            slot = conn
+            if data[0]:
+                # The start is detected from a write on the camera's connection
+                if last_write:
+                    slot_conn[slot] = max(last_write, key=last_write.get)
+                target = slot_conn.get(slot)
+                sent = last_tx.get(target) or last_tx.get(BROADCAST)
+                if sent and sent[1] == 1 and time_ms - sent[0] < START_WINDOW_MS:
+                    results["shutter -> recording start"].append(time_ms - sent[0])
+                recording.add(slot)
+            else:
+                target = slot_conn.get(slot)
+                if target in last_write:
+                    results["last write -> recording stop"].append(time_ms - last_write[target])
+                sent = last_tx.get(target) or last_tx.get(BROADCAST)
+                if sent and sent[1] in (1, 4) and time_ms - sent[0] < START_WINDOW_MS:
+                    results["stop command -> recording stop"].append(time_ms - sent[0])
+                recording.discard(slot)
+    return results
+
+
+def stats(values):
+    if not values:
+        return "no samples"
+    return (f"n={len(values):<4} min={min(values):7.0f}  "
+            f"median={statistics.median(values):7.0f}  max={max(values):7.0f} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", help="Serial log (default: stdin)")
+    parser.add_argument("--reference", help="capture to compare transition timing against")
+    parser.add_argument("--quiet", action="store_true", help="skip the timeline")
+    args = parser.parse_args()
+
+    source = open(args.log) if args.log else sys.stdin
+    cameras = {}
+    records = list(read_records(source, cameras))
+    if not records:
+        print("No capture found (look for CAPTURE BEGIN ... CAPTURE END)")
+        return 1
+
+    if not args.quiet:
+        for slot, (address, name) in sorted(cameras.items()):
+            print(f"Camera {slot}: {name} @ {address}")
+        start = records[0][0]
+        print("Timeline (ms from first record):")
+        for time_ms, kind, conn, data, full_len in records:
+            print(f"  {time_ms - start:9d}  {kind:<10} {describe(kind, conn, data, full_len)}")
+        print()
+
+    results = transitions(records)
+    if not args.reference:
+        print("State transitions:")
+        for name, values in results.items():
+            print(f"  {name:<32} {stats(values)}")
+        return 0
+
+    with open(args.reference) as f:
+        reference = transitions(list(read_records(f)))
+    print("State transitions (capture vs reference, median ms):")
+    worse = False
+    for name, values in results.items():
+        ref = reference[name]
+        if not values or not ref:
+            print(f"  {name:<32} {stats(values)}  |  reference {stats(ref)}")
+            continue
+        a, b = statistics.median(values), statistics.median(ref)
+        flag = ""
+        if name != "write interval while recording" and a > b * 1.2 + 50:
+            flag = "  SLOWER"
+            worse = True
+        print(f"  {name:<32} {a:7.0f} vs {b:7.0f} ({a - b:+.0f}){flag}")
+    return 2 if worse else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
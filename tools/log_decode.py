@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Turn the remote's binary log stream (built with -DLOG_BINARY) into text.
+
+Usage:
+    log_decode.py capture.bin [sketch_dir]
+
+capture.bin is the raw bytes read from the Serial port. Format strings are
+recovered by hashing every LOGE/LOGW/LOGI/LOGD("...") literal found in the
+sketch sources (default: the directory above this script), the same FNV-1a
+hash the firmware uses as the record ID. Plain text between frames (boot
+messages, dumps) is passed through unchanged.
+"""
+
+import os
+import re
+import struct
+import sys
+
+LOG_CALL = re.compile(r'\bLOG[EWID]\(\s*"((?:[^"\\]|\\.)*)"')
+SPEC = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(hh|h|ll|l|z)?([diuxXcs%])")
+LEVELS = "-EWID"
+ESCAPES = {"n": "\n", "t": "\t", '"': '"', "\\": "\\", "r": "\r"}
+
+
+def fnv1a(text):
+    h = 2166136261
+    for byte in text.encode():
+        h = ((h ^ byte) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def unescape(literal):
+    return re.sub(r"\\(.)", lambda m: ESCAPES.get(m.group(1), m.group(1)), literal)
+
+
+def load_formats(sketch_dir):
+    formats = {}
+    for name in os.listdir(sketch_dir):
+        if not name.endswith((".h", ".ino")):
+            continue
+        with open(os.path.join(sketch_dir, name), encoding="utf-8", errors="replace") as f:
+            for literal in LOG_CALL.findall(f.read()):
+                fmt = unescape(literal)
+                formats[fnv1a(fmt)] = fmt
+    return formats
+
+
+def conversions(fmt):
+    return [m.group(5) for m in SPEC.finditer(fmt) if m.group(5) != "%"]
+
+
+def render(fmt, args):
+    values = iter(args)
+
+    def one(m):
+        flags, width, precision, _, conv = m.groups()
+        if conv == "%":
+            return "%"
+        value = next(values, 0)
+        if conv in "di":
+            value = value - (1 << 32) if value & 0x80000000 else value
+            conv = "d"
+        elif conv == "u":
+            conv = "d"
+        elif conv == "c":
+            value = chr(value & 0xFF)
+        spec = "%" + flags + width + ("." + precision if precision else "") + conv
+        return spec % value
+
+    return SPEC.sub(one, fmt)
+
+
+def decode(data, formats, out):
+    i = 0
+    while i < len(data):
+        if data[i:i + 2] != b"\xa5\x5a" or i + 12 > len(data):
+            out.write(chr(data[i]) if data[i] < 0x80 else "?")
+            i += 1
+            continue
+        record_id, time_ms, level, argc = struct.unpack_from("<IIBB", data, i + 2)
+        fmt = formats.get(record_id)
+        pos = i + 12
+        kinds = conversions(fmt) if fmt else ["u"] * argc
+        args = []
+        for n in range(argc):
+            if n < len(kinds) and kinds[n] == "s":
+                length = data[pos]
+                args.append(data[pos + 1:pos + 1 + length].decode(errors="replace"))
+                pos += 1 + length
+            else:
+                args.append(struct.unpack_from("<I", data, pos)[0])
+                pos += 4
+        level_char = LEVELS[level] if level < len(LEVELS) else "?"
+        if fmt:
+            text = render(fmt, args)
+        else:
+            text = f"<unknown format {record_id:08x}> " + " ".join(str(a) for a in args)
+        out.write(f"[{level_char} {time_ms}] {text.rstrip(chr(10))}\n")
+        i = pos
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    sketch_dir = sys.argv[2] if len(sys.argv) > 2 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+    formats = load_formats(sketch_dir)
+    with open(sys.argv[1], "rb") as f:
+        decode(f.read(), formats, sys.stdout)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
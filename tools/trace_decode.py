@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""Decode an event trace dumped by the remote (Serial command 'T').
+
+Usage:
+    trace_decode.py serial.log        # or pipe the Serial capture on stdin
+
+Everything outside the TRACE BEGIN / TRACE END block is ignored, so a raw
+Serial monitor log works as-is. Prints a timeline and latency statistics.
+"""
+
+import statistics
+import struct
+import sys
+
+TYPES = {
+    1: "CONNECT",
+    2: "DISCONNECT",
+    3: "TIMER_PACKET",
+    4: "CMD_TX",
+    5: "INPUT_EDGE",
+    6: "REDRAW_START",
+    7: "REDRAW_END",
+    8: "WAKE_START",
+    9: "WAKE_END",
+}
+COMMANDS = {0: "other", 1: "shutter", 2: "mode", 3: "screen", 4: "power_off"}
+INPUTS = {0: "BtnA", 1: "BtnB", 2: "G0", 3: "G26", 4: "G36"}
+BROADCAST = 0xFFFF
+NEW_RECORDING_GAP_MS = 3000   # Timer silence that separates two recordings
+START_WINDOW_MS = 5000        # Matches maxStartLatency on the device
+
+
+def read_records(lines):
+    """Yield (time_us, type, arg8, arg16) from the last dump in the log."""
+    records = None
+    last = []
+    for line in lines:
+        line = line.strip()
+        if line.startswith("TRACE BEGIN"):
+            records = []
+        elif line == "TRACE END":
+            if records is not None:
+                last = records
+            records = None
+        elif records is not None and len(line) == 16:
+            try:
+                records.append(struct.unpack("<IBBH", bytes.fromhex(line)))
+            except ValueError:
+                pass
+    return last
+
+
+def unwrap(records):
+    """Turn 32-bit micros() into a monotonic ms timeline, dropping torn entries."""
+    events = []
+    offset = 0
+    previous = None
+    for time_us, kind, arg8, arg16 in records:
+        if kind not in TYPES:
+            continue
+        if previous is not None and time_us < previous and previous - time_us > 1 << 31:
+            offset += 1 << 32
+        previous = time_us
+        events.append(((time_us + offset) / 1000.0, TYPES[kind], arg8, arg16))
+    return events
+
+
+def describe(kind, arg8, arg16):
+    if kind in ("CONNECT", "DISCONNECT", "TIMER_PACKET"):
+        return f"conn={arg16}"
+    if kind == "CMD_TX":
+        target = "broadcast" if arg16 == BROADCAST else f"conn={arg16}"
+        return f"{COMMANDS.get(arg8, arg8)} {target}"
+    if kind == "INPUT_EDGE":
+        return f"{INPUTS.get(arg8, arg8)} {'down' if arg16 else 'up'}"
+    if kind == "REDRAW_END":
+        return f"~{arg16 * 64} bytes"
+    if kind == "WAKE_START":
+        return f"{arg8} camera(s)"
+    return ""
+
+
+def summarize(name, values):
+    if not values:
+        print(f"  {name:<28} no samples")
+        return
+    print(f"  {name:<28} n={len(values):<4} min={min(values):8.1f}  "
+          f"median={statistics.median(values):8.1f}  max={max(values):8.1f} ms")
+
+
+def main():
+    source = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    events = unwrap(read_records(source))
+    if not events:
+        print("No trace found (look for TRACE BEGIN ... TRACE END)")
+        return 1
+
+    start = events[0][0]
+    print("Timeline (ms from first event):")
+    for time_ms, kind, arg8, arg16 in events:
+        print(f"  {time_ms - start:10.1f}  {kind:<13} {describe(kind, arg8, arg16)}")
+
+    input_to_tx = []
+    shutter_to_timer = []
+    redraw = []
+    wake = []
+    wake_to_connect = []
+    timer_gaps = []
+
+    last_input = None
+    pending_start = {}      # conn (or BROADCAST) -> time the shutter went out
+    last_timer = {}
+    redraw_start = None
+    wake_start = None
+    for time_ms, kind, arg8, arg16 in events:
+        if kind == "INPUT_EDGE":
+            last_input = time_ms
+        elif kind == "CMD_TX":
+            if last_input is not None and time_ms - last_input < 2000:
+                input_to_tx.append(time_ms - last_input)
+                last_input = None
+            if arg8 == 1:
+                pending_start[arg16] = time_ms
+        elif kind == "TIMER_PACKET":
+            previous = last_timer.get(arg16)
+            first = previous is None or time_ms - previous > NEW_RECORDING_GAP_MS
+            if first:
+                sent = pending_start.pop(arg16, pending_start.get(BROADCAST))
+                if sent is not None and time_ms - sent < START_WINDOW_MS:
+                    shutter_to_timer.append(time_ms - sent)
+            else:
+                timer_gaps.append(time_ms - previous)
+            last_timer[arg16] = time_ms
+        elif kind == "DISCONNECT":
+            last_timer.pop(arg16, None)
+        elif kind == "CONNECT":
+            if wake_start is not None:
+                wake_to_connect.append(time_ms - wake_start)
+        elif kind == "REDRAW_START":
+            redraw_start = time_ms
+        elif kind == "REDRAW_END" and redraw_start is not None:
+            redraw.append(time_ms - redraw_start)
+            redraw_start = None
+        elif kind == "WAKE_START":
+            wake_start = time_ms
+        elif kind == "WAKE_END" and wake_start is not None:
+            wake.append(time_ms - wake_start)
+
+    print()
+    print("Latency:")
+    summarize("input -> command TX", input_to_tx)
+    summarize("shutter -> first timer", shutter_to_timer)
+    summarize("timer packet interval", timer_gaps)
+    summarize("redraw", redraw)
+    summarize("wake window", wake)
+    summarize("wake start -> connect", wake_to_connect)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
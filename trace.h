@@ -0,0 +1,112 @@
+/*
+ * trace.h
+ * In-RAM binary event trace - recorded everywhere, dumped on request
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <M5Unified.h>
+#include <atomic>
+
+#include "config.h"
+
+// The last TRACE_SIZE events live in a ring of 8-byte records. Recording is
+// a timestamp, one atomic increment and a store, so it is safe from the BLE
+// callbacks as well as loop(). The ring overwrites the oldest entries and is
+// dumped as hex over Serial with the 'T' console command; decode the capture
+// with tools/trace_decode.py.
+
+// Must be a power of two
+#define TRACE_SIZE 512
+
+enum TraceType : uint8_t {
+  TRACE_CONNECT = 1,     // arg16 = connId
+  TRACE_DISCONNECT,      // arg16 = connId
+  TRACE_TIMER_PACKET,    // arg16 = connId
+  TRACE_CMD_TX,          // arg8 = TraceCommand, arg16 = connId (0xFFFF broadcast)
+  TRACE_INPUT_EDGE,      // arg8 = TraceInput, arg16 = 1 pressed / 0 released
+  TRACE_REDRAW_START,    // arg8 = RenderKind
+  TRACE_REDRAW_END,      // arg8 = RenderKind, arg16 = bytes pushed / 64
+  TRACE_WAKE_START,      // arg8 = cameras being woken
+  TRACE_WAKE_END
+};
+
+enum TraceCommand : uint8_t {
+  TRACE_CMD_OTHER = 0,
+  TRACE_CMD_SHUTTER,
+  TRACE_CMD_MODE,
+  TRACE_CMD_SCREEN,
+  TRACE_CMD_POWER_OFF
+};
+
+enum TraceInput : uint8_t {
+  TRACE_INPUT_BTN_A = 0,
+  TRACE_INPUT_BTN_B,
+  TRACE_INPUT_G0,
+  TRACE_INPUT_G26,
+  TRACE_INPUT_G36
+};
+
+struct TraceEvent {
+  uint32_t timeUs;  // micros(), wraps after ~71 minutes
+  uint8_t type;     // TraceType, 0 = never written
+  uint8_t arg8;
+  uint16_t arg16;
+};
+
+TraceEvent traceRing[TRACE_SIZE];
+std::atomic<uint32_t> traceNext(0);  // Total events recorded
+
+// For events timestamped elsewhere (e.g. a GPIO edge in its ISR). The ring is
+// then slightly out of time order; the decoder works from the timestamps.
+void traceAt(uint32_t timeUs, TraceType type, uint8_t arg8 = 0, uint16_t arg16 = 0) {
+  uint32_t index = traceNext.fetch_add(1, std::memory_order_relaxed);
+  TraceEvent& event = traceRing[index & (TRACE_SIZE - 1)];
+  event.timeUs = timeUs;
+  event.arg8 = arg8;
+  event.arg16 = arg16;
+  event.type = type;
+}
+
+void trace(TraceType type, uint8_t arg8 = 0, uint16_t arg16 = 0) {
+  traceAt(micros(), type, arg8, arg16);
+}
+
+TraceCommand traceCommandId(const uint8_t* data) {
+  if (data == SHUTTER_CMD) return TRACE_CMD_SHUTTER;
+  if (data == MODE_CMD) return TRACE_CMD_MODE;
+  if (data == TOGGLE_SCREEN_CMD) return TRACE_CMD_SCREEN;
+  if (data == POWER_OFF_CMD) return TRACE_CMD_POWER_OFF;
+  return TRACE_CMD_OTHER;
+}
+
+// Button A/B edges as loop() sees them after M5.update()
+void traceButtonEdges() {
+  if (M5.BtnA.wasPressed()) trace(TRACE_INPUT_EDGE, TRACE_INPUT_BTN_A, 1);
+  if (M5.BtnA.wasReleased()) trace(TRACE_INPUT_EDGE, TRACE_INPUT_BTN_A, 0);
+  if (M5.BtnB.wasPressed()) trace(TRACE_INPUT_EDGE, TRACE_INPUT_BTN_B, 1);
+  if (M5.BtnB.wasReleased()) trace(TRACE_INPUT_EDGE, TRACE_INPUT_BTN_B, 0);
+}
+
+// Print the ring oldest-first, one little-endian record per line in hex:
+//   TRACE BEGIN <events recorded> <records that follow>
+//   <16 hex digits>
+//   TRACE END
+// An event recorded while dumping may show up torn; the decoder skips it.
+void dumpTrace() {
+  uint32_t total = traceNext.load(std::memory_order_relaxed);
+  uint32_t count = total < TRACE_SIZE ? total : TRACE_SIZE;
+
+  Serial.printf("TRACE BEGIN %lu %lu\n", (unsigned long)total, (unsigned long)count);
+  for (uint32_t i = total - count; i != total; i++) {
+    const uint8_t* bytes = (const uint8_t*)&traceRing[i & (TRACE_SIZE - 1)];
+    for (size_t b = 0; b < sizeof(TraceEvent); b++) {
+      Serial.printf("%02x", bytes[b]);
+    }
+    Serial.println();
+  }
+  Serial.println("TRACE END");
+}
+
+#endif // TRACE_H
@@ -0,0 +1,125 @@
+/*
+ * triggerslot.h
+ * Slotted GPIO trigger timing for remotes sharing one trigger cable
+ */
+
+#ifndef TRIGGERSLOT_H
+#define TRIGGERSLOT_H
+
+#include <Arduino.h>
+
+#include "camera.h"
+#include "commands.h"
+#include "config.h"
+#include "log.h"
+#include "scheduler.h"
+
+// External slot and GPIO delay settings (defined in main sketch)
+extern const int REMOTE_SLOT;
+extern int gpioDelay;
+int calculateGPIODelay();
+
+// Remotes wired to the same trigger all see the same edge. Sending at the
+// same instant, their commands collide on air and some cameras never get
+// them. With REMOTE_SLOT set, remote N sends N slot widths after the edge,
+// so N remotes spread over (N-1) x width ms instead of a hashed 0-100 ms that
+// can still land two remotes on the same millisecond.
+//
+// A GPIO start counts as collided when a camera it should have started
+// sends no timer packet in time. The width then doubles (up to
+// maxGpioSlotWidth), and narrows by one step after every gpioSlotShrinkAfter
+// clean starts. The spread settles near the smallest width that still works.
+// Both remotes in a collision see it, so they widen together.
+
+const unsigned long gpioSlotShrinkStep = 5;
+const int gpioSlotShrinkAfter = 16;
+// A start can take maxStartLatency to show up, after up to maxStartStagger
+const unsigned long gpioSlotCheckWindow = maxStartLatency + maxStartStagger;
+
+unsigned long gpioSlotWidth = initialGpioSlotWidth;
+
+struct SlotTrigger {
+  bool pending;               // A GPIO start is being checked
+  unsigned long time;
+  bool expected[MAX_CAMERAS]; // Cameras it should start
+};
+
+SlotTrigger slotTrigger;
+uint32_t slotTriggers = 0;    // GPIO starts checked
+uint32_t slotCollisions = 0;
+int slotCleanRun = 0;
+
+// Delay from a trigger edge to this remote's GPIO action
+void applyTriggerSlot() {
+  gpioDelay = REMOTE_SLOT >= 0 ? REMOTE_SLOT * gpioSlotWidth : calculateGPIODelay();
+}
+
+void setGpioSlotWidth(unsigned long width) {
+  if (width < minGpioSlotWidth) width = minGpioSlotWidth;
+  if (width > maxGpioSlotWidth) width = maxGpioSlotWidth;
+  if (width == gpioSlotWidth) return;
+  LOGI("Trigger slot width %lu -> %lu ms (%lu collisions in %lu starts)", gpioSlotWidth, width,
+       (unsigned long)slotCollisions, (unsigned long)slotTriggers);
+  gpioSlotWidth = width;
+  applyTriggerSlot();
+}
+
+// Called just before a GPIO shutter. Only a start of every connected camera
+// is checked - a sync stop leaves stopped cameras alone on purpose.
+void noteSlotTrigger() {
+  if (REMOTE_SLOT < 0) return;
+
+  bool any = false;
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    slotTrigger.expected[i] = cameras[i].connected;
+    if (!cameras[i].connected) continue;
+    if (cameras[i].isRecording) {
+      slotTrigger.pending = false;
+      cancelDeadline(DEADLINE_TRIGGER_SLOT);
+      return;
+    }
+    any = true;
+  }
+  slotTrigger.pending = any;
+  slotTrigger.time = millis();
+  // Settle a start that never shows up as the window closes, not whenever
+  // loop() next happens to wake
+  if (any) armDeadline(DEADLINE_TRIGGER_SLOT, slotTrigger.time + gpioSlotCheckWindow + 1);
+  else cancelDeadline(DEADLINE_TRIGGER_SLOT);
+}
+
+// Called from loop(): settle the pending check once every camera started or
+// the window ran out
+void updateTriggerSlot() {
+  if (!slotTrigger.pending) return;
+
+  bool waiting = false;
+  bool missed = false;
+  bool timedOut = millis() - slotTrigger.time > gpioSlotCheckWindow;
+  for (int i = 0; i < MAX_CAMERAS; i++) {
+    if (!slotTrigger.expected[i]) continue;
+    if (!cameras[i].connected) {
+      slotTrigger.expected[i] = false; // Dropped out - can't tell
+      continue;
+    }
+    if (cameras[i].isRecording) continue;
+    if (timedOut) missed = true;
+    else waiting = true;
+  }
+  if (waiting) return;
+
+  slotTrigger.pending = false;
+  cancelDeadline(DEADLINE_TRIGGER_SLOT);
+  slotTriggers++;
+  if (missed) {
+    slotCollisions++;
+    slotCleanRun = 0;
+    LOGW("Trigger slot %d: GPIO start missed a camera", REMOTE_SLOT);
+    setGpioSlotWidth(gpioSlotWidth * 2);
+  } else if (++slotCleanRun >= gpioSlotShrinkAfter) {
+    slotCleanRun = 0;
+    setGpioSlotWidth(gpioSlotWidth > gpioSlotShrinkStep ? gpioSlotWidth - gpioSlotShrinkStep : 0);
+  }
+}
+
+#endif // TRIGGERSLOT_H
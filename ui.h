@@ -1,18 +1,37 @@
 /*
  * ui.h
- * Display and user interface functions with auto-scaling for M5StickC and M5StickC Plus2
+ * Display and user interface functions for M5StickC, M5StickC Plus and Plus2
  */
 
 #ifndef UI_H
 #define UI_H
 
+#include <M5Unified.h>
+
+#include "ble_handlers.h"
+#include "camera.h"
+#include "config.h"
+#include "display.h"
+#include "icons.h"
+#include "layouts.h"
+#include "log.h"
+#include "render.h"
+#include "scheduler.h"
+#include "toast.h"
+#include "trace.h"
+
 // UI variables
 int currentScreen = 0;
-int pairingMenuSelection = 0; // 0=Cam1, 1=Cam2, 2=Layout, 3=Back
+int pairingMenuSelection = 0; // 0..MAX_CAMERAS-1=Pair slot, then Layout, then Back
+const int pairingMenuItems = MAX_CAMERAS + 2;
 extern bool isVerticalLayout;
 
+int remoteBatteryLevel = 0;  // Read by updateDisplay(), drawn by the render task
+
 // GPIO variables
-unsigned long lastPinPress[3] = {0, 0, 0}; // For G0, G26, G36
+uint32_t gpioEdgesSeen[TRIGGER_COUNT] = {0};       // triggerEdges[].count already handled
+bool gpioActionPending[TRIGGER_COUNT] = {false};    // Waiting out gpioDelay
+unsigned long gpioActionDue[TRIGGER_COUNT] = {0};
 unsigned long startupTime = 0;
 
 // External GPIO delay variable (defined in main sketch)
@@ -22,198 +41,192 @@ extern int gpioDelay;
 extern bool isRecording;
 extern unsigned long recordingStartTime;
 
-// Auto-detection and scaling variables
-bool isPlus2 = false;
-float scaleFactor = 1.0;
-int baseIconSize = 32;
-int scaledIconSize = 32;
-int baseTextSize = 1;
-int scaledTextSize = 1;
-
-// Screen layout constants (will be scaled)
-struct ScreenLayout {
-  int iconX, iconY;
-  int textX, textY;
-  int statusX, statusY;
-  int dotsY, dotsSpacing, dotsStartX;
-  int instructX, instructY;
-  int connectionX, connectionY, connectionRadius;
-};
-
-ScreenLayout layout;
-
-void detectDeviceAndSetScale() {
-  // Detect device by screen dimensions
-  int screenWidth = M5.Lcd.width();
-  int screenHeight = M5.Lcd.height();
-  
-  Serial.print("Screen dimensions: ");
-  Serial.print(screenWidth);
-  Serial.print("x");
-  Serial.println(screenHeight);
-  
-  // Check dimensions for M5StickC Plus/Plus2 (240x135) in either orientation
-  if ((screenWidth == 240 && screenHeight == 135) || (screenWidth == 135 && screenHeight == 240)) {
-    // M5StickC Plus/Plus2
-    isPlus2 = true;
-    scaleFactor = 1.5;
-    Serial.println("Detected: M5StickC Plus/Plus2");
-  } else {
-    // Original M5StickC or similar (160x80)
-    isPlus2 = false;
-    scaleFactor = 1.0;
-    Serial.println("Detected: M5StickC (original)");
-  }
-  
-  // Keep icons at original size but scale text
-  scaledIconSize = baseIconSize;  // Always 32x32
-  scaledTextSize = (scaleFactor >= 1.5) ? 2 : 1;
-  
-  // Set up layout based on device
-  if (isPlus2) {
-    // M5StickC Plus/Plus2 layout
-    if (screenWidth > screenHeight) { // Landscape
-        layout.iconX = (screenWidth - baseIconSize) / 2;
-        layout.iconY = 30;
-        layout.textX = screenWidth / 2;
-        layout.textY = layout.iconY + baseIconSize + 10;
-        layout.statusX = 220;
-        layout.statusY = 12;
-        layout.connectionRadius = 7;
-        layout.dotsY = 120;
-        layout.dotsSpacing = 25;
-        layout.dotsStartX = 45;
-        layout.instructX = 8;
-        layout.instructY = 8;
-    } else { // Portrait
-        // Adapt layout for Portrait if needed for other screens
-        // Currently Dashboard handles its own layout dynamiclly
-        layout.dotsY = screenHeight - 15; 
-        layout.dotsSpacing = 25;
-        layout.dotsStartX = (screenWidth - (25 * 3)) / 2 + 12; // Center dots
+// Trigger pin actions (commands.h, triggerslot.h)
+void executeShutter();
+void executeSleep();
+void executeWake();
+void noteSlotTrigger();
+
+// Board the layouts come from: REMOTE_BOARD unless the panel says otherwise
+int layoutBoard = REMOTE_BOARD;
+
+// Active layout - one of the compile-time tables in layouts.h
+const ScreenLayout* layout = &boardLayouts[REMOTE_BOARD][LAYOUT_HORIZONTAL];
+
+// REMOTE_BOARD is fixed at build time, but M5Unified finds the panel at run
+// time. A 160x80 M5StickC built for a generic ESP32 target would otherwise
+// draw the 240x135 layouts off screen, so use the layouts of a board with
+// this panel size. Called once after M5.begin(), before anything is drawn.
+void checkPanelSize() {
+  int32_t w = M5.Lcd.width();
+  int32_t h = M5.Lcd.height();
+  int32_t longSide = w > h ? w : h;   // Either rotation
+  int32_t shortSide = w > h ? h : w;
+  const ScreenLayout& built = boardLayouts[REMOTE_BOARD][LAYOUT_HORIZONTAL];
+  if (built.width == longSide && built.height == shortSide) return;
+
+  for (int board = 0; board < (int)(sizeof(boardLayouts) / sizeof(boardLayouts[0])); board++) {
+    const ScreenLayout& candidate = boardLayouts[board][LAYOUT_HORIZONTAL];
+    if (candidate.width != longSide || candidate.height != shortSide) continue;
+    LOGW("Panel is %ldx%ld, not %dx%d as on the %s - using the %s layouts", (long)longSide, (long)shortSide,
+         built.width, built.height, boardNames[REMOTE_BOARD], boardNames[board]);
+    if (!horizontalDashboardFits(candidate, MAX_CAMERAS) ||
+        !verticalDashboardFits(boardLayouts[board][LAYOUT_VERTICAL], MAX_CAMERAS)) {
+      LOGW("The %s dashboard does not fit %d cameras", boardNames[board], MAX_CAMERAS);
     }
-  } else {
-    // Original M5StickC layout
-    // ... (Keep existing logic, simplified for brevity if needed, but let's leave it mostly as is)
-    layout.iconX = (screenWidth - baseIconSize) / 2;
-    layout.iconY = 20;
-    layout.textX = screenWidth / 2;
-    layout.textY = layout.iconY + baseIconSize + 4;
-    layout.statusX = screenWidth - 10;
-    layout.statusY = 8;
-    layout.connectionRadius = 5;
-    layout.dotsY = screenHeight - 8;
-    layout.dotsSpacing = 17;
-    layout.dotsStartX = 30;
-    layout.instructX = 5;
-    layout.instructY = 5;
+    layoutBoard = board;
+    layout = &boardLayouts[layoutBoard][LAYOUT_HORIZONTAL];
+    return;
   }
-  
-  Serial.print("Scale factor: ");
-  Serial.print(scaleFactor);
+  LOGE("Panel is %ldx%ld - no layout for it, using the %s layouts", (long)longSide, (long)shortSide,
+       boardNames[REMOTE_BOARD]);
+}
+
+// Render task side of applyLayoutRotation()
+void rotateDisplay() {
+    layout = &boardLayouts[layoutBoard][isVerticalLayout ? LAYOUT_VERTICAL : LAYOUT_HORIZONTAL];
+    M5.Lcd.setRotation(layout->rotation); // 0 = Portrait (Button B at bottom), 3 = Landscape (Button B at right)
+    setupCanvas(); // Frame buffer follows the panel's new dimensions
 }
 
 void applyLayoutRotation() {
-    if (isVerticalLayout) {
-        M5.Lcd.setRotation(0); // Portrait (Button B at bottom)
-    } else {
-        M5.Lcd.setRotation(3); // Landscape (Button B at right)
-    }
-    detectDeviceAndSetScale();
+    postRender(RENDER_ROTATE);
 }
 
-void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color) {
+// The pairing screen stays up until pairing ends; other redraws wait for it
+bool pairingOwnsScreen() {
+  return pairingPhase != PAIRING_IDLE;
+}
+
+// Draw a 1bpp bitmap as horizontal runs of set bits - one fill per run
+// instead of one drawPixel per pixel. `scale` enlarges each source pixel.
+void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color, uint8_t scale = 1) {
   int16_t byteWidth = (w + 7) / 8;
-  uint8_t byte = 0;
 
-  // Draw bitmap at original size (no scaling)
   for (int16_t j = 0; j < h; j++) {
-    for (int16_t i = 0; i < w; i++) {
-      if (i & 7) {
-        byte <<= 1;
-      } else {
-        byte = bitmap[j * byteWidth + i / 8];
+    const uint8_t* row = bitmap + j * byteWidth;
+    int16_t i = 0;
+
+    while (i < w) {
+      // Skip clear bits, whole bytes at a time where possible
+      if ((i & 7) == 0 && row[i / 8] == 0x00) {
+        i += 8;
+        continue;
       }
-      if (byte & 0x80) {
-        M5.Lcd.drawPixel(x + i, y + j, color);
+      if (!(row[i / 8] & (0x80 >> (i & 7)))) {
+        i++;
+        continue;
+      }
+
+      // Extend the run over set bits, whole bytes at a time where possible
+      int16_t start = i;
+      while (i < w) {
+        if ((i & 7) == 0 && i + 8 <= w && row[i / 8] == 0xFF) {
+          i += 8;
+        } else if (row[i / 8] & (0x80 >> (i & 7))) {
+          i++;
+        } else {
+          break;
+        }
+      }
+
+      if (scale == 1) {
+        gfx->drawFastHLine(x + start, y + j, i - start, color);
+      } else {
+        gfx->fillRect(x + start * scale, y + j * scale, (i - start) * scale, scale, color);
       }
     }
   }
 }
 
 // Helper function to get text width for proper centering
-int getTextWidth(String text, int textSize) {
+int getTextWidth(const char* text, int textSize) {
   // Approximate character width based on text size
   int charWidth = (textSize == 1) ? 6 : 12;  // Size 1 = ~6px, Size 2 = ~12px per char
-  return text.length() * charWidth;
+  return strlen(text) * charWidth;
 }
 
-// Helper to extract short name from full camera name
-String getShortName(const char* fullName) {
-  String name = String(fullName);
-  if (name.length() == 0) return "NO CAM";
+// Helper to extract short name from full camera name into `out`
+// (e.g. "X3" from "Insta360 X3 1234"). Returns `out`.
+const char* getShortName(const char* fullName, char* out, size_t outSize) {
+  if (fullName[0] == '\0') {
+    snprintf(out, outSize, "NO CAM");
+    return out;
+  }
   
   // Remove "Insta360 " prefix if present
-  if (name.startsWith("Insta360 ")) {
-    name = name.substring(9);
+  if (strncmp(fullName, "Insta360 ", 9) == 0) {
+    fullName += 9;
   }
   
-  // Find first space to get model name (e.g. "X3" from "X3 1234")
-  int spaceIndex = name.indexOf(' ');
-  if (spaceIndex > 0) {
-    name = name.substring(0, spaceIndex);
-  }
+  // Find first space to get model name
+  const char* space = strchr(fullName, ' ');
+  size_t len = (space && space > fullName) ? (size_t)(space - fullName) : strlen(fullName);
+  if (len >= outSize) len = outSize - 1;
+  memcpy(out, fullName, len);
+  out[len] = '\0';
   
-  return name;
+  return out;
 }
 
 // Draw a colored bar at the bottom with status message
-void showBottomStatus(const char* text, uint16_t color) {
-  int width = M5.Lcd.width();
-  int height = M5.Lcd.height();
+void drawBottomStatus(const char* text, uint16_t color) {
+  int width = gfx->width();
+  int height = gfx->height();
   
-  M5.Lcd.fillRect(0, height - 25, width, 25, color);
-  M5.Lcd.setTextColor(WHITE);
-  M5.Lcd.setTextSize(scaledTextSize);
-  int textWidth = getTextWidth(String(text), scaledTextSize);
-  M5.Lcd.setCursor((width - textWidth) / 2, height - 20);
-  M5.Lcd.print(text);
+  gfx->fillRect(0, height - 25, width, 25, color);
+  gfx->setTextColor(WHITE);
+  gfx->setTextSize(layout->textSize);
+  int textWidth = getTextWidth(text, layout->textSize);
+  gfx->setCursor((width - textWidth) / 2, height - 20);
+  gfx->print(text);
 }
 
-// Clear screen and show a large centered message
-void showCenteredMessage(const char* line1, const char* line2, uint16_t color) {
-  M5.Lcd.fillScreen(BLACK);
-  int width = M5.Lcd.width();
-  int height = M5.Lcd.height();
+// Framed two-line message over the middle of the screen, clear of the timer bar
+void drawMessageBox(const char* line1, const char* line2, uint16_t color) {
+  int width = gfx->width();
+  int height = gfx->height();
   int centerY = height / 2;
+
+  gfx->fillRect(4, centerY - 28, width - 8, 58, BLACK);
+  gfx->drawRect(4, centerY - 28, width - 8, 58, color);
   
-  M5.Lcd.setTextColor(color);
-  M5.Lcd.setTextSize(scaledTextSize); // Base size
+  gfx->setTextColor(color);
+  gfx->setTextSize(layout->msgTextSize); // Base size
   
   // Line 1 (Top, smaller or same?)
   if (line1 && strlen(line1) > 0) {
-      int w1 = getTextWidth(String(line1), scaledTextSize);
-      M5.Lcd.setCursor((width - w1) / 2, centerY - 20);
-      M5.Lcd.println(line1);
+      int w1 = getTextWidth(line1, layout->msgTextSize);
+      gfx->setCursor((width - w1) / 2, centerY - 20);
+      gfx->println(line1);
   }
   
   // Line 2 (Center, larger if possible or same)
   if (line2 && strlen(line2) > 0) {
       // Make line 2 slightly larger if scale factor allows, else same
-      int size2 = scaledTextSize; // Keep consistent size for readability
-      M5.Lcd.setTextSize(size2);
-      M5.Lcd.setTextColor(WHITE);
-      int w2 = getTextWidth(String(line2), size2);
-      M5.Lcd.setCursor((width - w2) / 2, centerY + 5);
-      M5.Lcd.println(line2);
+      int size2 = layout->msgTextSize; // Keep consistent size for readability
+      gfx->setTextSize(size2);
+      gfx->setTextColor(WHITE);
+      int w2 = getTextWidth(line2, size2);
+      gfx->setCursor((width - w2) / 2, centerY + 5);
+      gfx->println(line2);
   }
 }
 
-void updateDashboardTimer() {
+// One horizontally centered line of text (no flush)
+void drawCenteredText(const char* text, int y, uint16_t color) {
+  gfx->setTextSize(layout->msgTextSize);
+  gfx->setTextColor(color);
+  gfx->setCursor((gfx->width() - getTextWidth(text, layout->msgTextSize)) / 2, y);
+  gfx->print(text);
+}
+
+void drawDashboardTimer() {
   if (currentScreen != 0) return;
+  if (toast.active && !toast.message) return; // Status toast owns the bottom strip until it expires
   
-  int width = M5.Lcd.width();
-  int height = M5.Lcd.height();
+  int width = gfx->width();
+  int height = gfx->height();
   
   // Only redraw the bottom strip
   if (isRecording) {
@@ -225,279 +238,293 @@ void updateDashboardTimer() {
     sprintf(timeStr, "%02d:%02d", minutes, seconds);
     
     // Redraw background only for the timer area
-    M5.Lcd.fillRect(0, height - 25, width, 25, RED);
-    M5.Lcd.setTextColor(WHITE);
-    M5.Lcd.setTextSize(scaledTextSize);
-    int timeWidth = getTextWidth(String(timeStr), scaledTextSize);
-    M5.Lcd.setCursor((width - timeWidth) / 2, height - 20);
-    M5.Lcd.print(timeStr);
+    gfx->fillRect(0, height - 25, width, 25, RED);
+    gfx->setTextColor(WHITE);
+    gfx->setTextSize(layout->textSize);
+    int timeWidth = getTextWidth(timeStr, layout->textSize);
+    gfx->setCursor((width - timeWidth) / 2, height - 20);
+    gfx->print(timeStr);
   } else {
      // Clear the timer area if we stopped recording but didn't do a full refresh yet
      // (Though usually a full updateDisplay is called on stop)
-     M5.Lcd.fillRect(0, height - 25, width, 25, BLACK);
+     gfx->fillRect(0, height - 25, width, 25, BLACK);
   }
 }
 
-void drawDashboard() {
-  int width = M5.Lcd.width();
-  int height = M5.Lcd.height();
-  int halfWidth = width / 2;
-  
-  // Remote Battery Indicator (Top Right)
-  int batLevel = M5.Power.getBatteryLevel();
-  M5.Lcd.setTextSize(1);
-  if (batLevel > 20) M5.Lcd.setTextColor(GREEN);
-  else M5.Lcd.setTextColor(RED);
-  M5.Lcd.setCursor(width - 25, 5);
-  M5.Lcd.print(batLevel);
-  M5.Lcd.print("%");
-
-  // --- Camera 1 Setup ---
-  uint16_t c1Color = DARKGREY;
-  String c1Name = "EMPTY";
-  if (camera1.isValid) {
-    c1Name = getShortName(camera1.name);
-    if (camera1Connected) c1Color = BLUE;
-    else c1Color = RED;
+// Timer-only refresh - flushes just the bottom strip tiles
+void updateDashboardTimer() {
+  if (pairingOwnsScreen()) return;
+  postRender(RENDER_TIMER);
+}
+
+// One camera's status circle, short name and recording dot
+void drawCameraCell(int slot, int cx, int circleY, int textY, int radius, int textSize) {
+  CameraInfo* camera = &cameras[slot];
+
+  uint16_t color = DARKGREY;
+  char shortName[12];
+  const char* name = "EMPTY";
+  if (camera->isValid) {
+    name = getShortName(camera->name, shortName, sizeof(shortName));
+    if (camera->wakeState == WAKE_WAITING) color = YELLOW;      // Smart Wake: not back yet
+    else if (camera->wakeState == WAKE_SETTLING) color = CYAN;  // Smart Wake: about to start
+    else if (camera->connected) color = BLUE;
+    else color = RED;
   }
 
-  // --- Camera 2 Setup ---
-  uint16_t c2Color = DARKGREY;
-  String c2Name = "EMPTY";
-  if (camera2.isValid) {
-    c2Name = getShortName(camera2.name);
-    if (camera2Connected) c2Color = BLUE;
-    else c2Color = RED;
+  gfx->fillCircle(cx, circleY, radius, color);
+
+  gfx->setTextSize(textSize);
+  gfx->setTextColor(WHITE);
+  int nameWidth = getTextWidth(name, textSize);
+  int textX = cx - (nameWidth/2);
+  gfx->setCursor(textX, textY);
+  gfx->print(name);
+
+  // Recording Dot (Relative to Text Top-Right)
+  if (camera->connected && camera->isRecording) {
+      // Position: Right of text + 6px, Top of text + 2px
+      gfx->fillCircle(textX + nameWidth + 6, textY + 2, 5, RED);
   }
+}
+
+void drawDashboard() {
+  int width = gfx->width();
+  int height = gfx->height();
+  
+  // Remote Battery Indicator (Top Right)
+  int batLevel = remoteBatteryLevel;
+  gfx->setTextSize(1);
+  if (batLevel > 20) gfx->setTextColor(GREEN);
+  else gfx->setTextColor(RED);
+  gfx->setCursor(width - 25, 5);
+  gfx->print(batLevel);
+  gfx->print("%");
 
   if (!isVerticalLayout) {
       // --- HORIZONTAL LAYOUT (Side by Side) ---
-      // Draw divider
-      M5.Lcd.drawLine(halfWidth, 10, halfWidth, height - 20, DARKGREY);
-      
-      // Cam 1 (Left)
-      int c1X = halfWidth / 2;
-      int c1Y = height / 2 - 10;
-      M5.Lcd.fillCircle(c1X, c1Y - 15, isPlus2 ? 15 : 10, c1Color);
-      
-      M5.Lcd.setTextSize(scaledTextSize);
-      M5.Lcd.setTextColor(WHITE);
-      int name1Width = getTextWidth(c1Name, scaledTextSize);
-      int text1X = c1X - (name1Width/2);
-      int text1Y = c1Y + 10; // Increased spacing (+5)
-      M5.Lcd.setCursor(text1X, text1Y);
-      M5.Lcd.print(c1Name);
-
-      // Recording Dot 1 (Relative to Text Top-Right)
-      if (camera1Connected && camera1.isRecording) {
-          // Position: Right of text + 6px, Top of text + 2px
-          M5.Lcd.fillCircle(text1X + name1Width + 6, text1Y + 2, 5, RED);
-      }
-      
-      // Cam 2 (Right)
-      int c2X = halfWidth + (halfWidth / 2);
-      int c2Y = height / 2 - 10;
-      M5.Lcd.fillCircle(c2X, c2Y - 15, isPlus2 ? 15 : 10, c2Color);
-      
-      M5.Lcd.setTextSize(scaledTextSize);
-      M5.Lcd.setTextColor(WHITE);
-      int name2Width = getTextWidth(c2Name, scaledTextSize);
-      int text2X = c2X - (name2Width/2);
-      int text2Y = c2Y + 10; // Increased spacing (+5)
-      M5.Lcd.setCursor(text2X, text2Y);
-      M5.Lcd.print(c2Name);
-
-      // Recording Dot 2
-      if (camera2Connected && camera2.isRecording) {
-          M5.Lcd.fillCircle(text2X + name2Width + 6, text2Y + 2, 5, RED);
+      int cellWidth = horizontalCellWidth(*layout, MAX_CAMERAS);
+      int radius = horizontalRadius(*layout, MAX_CAMERAS);
+      int textSize = dashboardTextSize(*layout, cellWidth);
+      int cy = height / 2 - 10;
+
+      for (int i = 0; i < MAX_CAMERAS; i++) {
+          // Draw divider
+          if (i > 0) gfx->drawLine(i * cellWidth, 10, i * cellWidth, height - 20, DARKGREY);
+
+          int cx = i * cellWidth + cellWidth / 2;
+          drawCameraCell(i, cx, cy - 15, cy + 10, radius, textSize);
       }
-      
   } else {
-      // --- VERTICAL LAYOUT (Top / Bottom) ---
-      int halfHeight = height / 2;
-      // Draw divider
-      M5.Lcd.drawLine(10, halfHeight, width - 10, halfHeight, DARKGREY);
-      
-      // Cam 1 (Top)
-      int c1X = width / 2;
-      int c1Y = halfHeight / 2; 
-      M5.Lcd.fillCircle(c1X, c1Y - 10, isPlus2 ? 15 : 10, c1Color);
-      
-      M5.Lcd.setTextSize(scaledTextSize);
-      M5.Lcd.setTextColor(WHITE);
-      int name1Width = getTextWidth(c1Name, scaledTextSize);
-      int text1X = c1X - (name1Width/2);
-      int text1Y = c1Y + 15; // Increased spacing (+5 from previous +10)
-      M5.Lcd.setCursor(text1X, text1Y);
-      M5.Lcd.print(c1Name);
-
-      // Recording Dot 1
-      if (camera1Connected && camera1.isRecording) {
-          M5.Lcd.fillCircle(text1X + name1Width + 6, text1Y + 2, 5, RED);
-      }
-      
-      // Cam 2 (Bottom)
-      int c2X = width / 2;
-      int c2Y = halfHeight + (halfHeight / 2) - 10;
-      M5.Lcd.fillCircle(c2X, c2Y - 10, isPlus2 ? 15 : 10, c2Color);
-      
-      M5.Lcd.setTextSize(scaledTextSize);
-      M5.Lcd.setTextColor(WHITE);
-      int name2Width = getTextWidth(c2Name, scaledTextSize);
-      int text2X = c2X - (name2Width/2);
-      int text2Y = c2Y + 15; // Increased spacing (+5)
-      M5.Lcd.setCursor(text2X, text2Y);
-      M5.Lcd.print(c2Name);
-
-      // Recording Dot 2
-      if (camera2Connected && camera2.isRecording) {
-          M5.Lcd.fillCircle(text2X + name2Width + 6, text2Y + 2, 5, RED);
+      // --- VERTICAL LAYOUT (Stacked) ---
+      int cellHeight = verticalCellHeight(*layout, MAX_CAMERAS);
+      int radius = verticalRadius(*layout, MAX_CAMERAS);
+      int circleOffset = verticalCircleOffset(*layout, MAX_CAMERAS);
+      int textOffset = verticalTextOffset(*layout, MAX_CAMERAS);
+      int textSize = dashboardTextSize(*layout, width);
+      int cx = width / 2;
+
+      for (int i = 0; i < MAX_CAMERAS; i++) {
+          // Draw divider
+          if (i > 0) gfx->drawLine(10, i * cellHeight, width - 10, i * cellHeight, DARKGREY);
+
+          // The bottom cell sits higher to leave room for the timer bar
+          int cy = i * cellHeight + cellHeight / 2;
+          if (i > 0 && i == MAX_CAMERAS - 1) cy -= verticalLastLift(*layout, MAX_CAMERAS);
+          drawCameraCell(i, cx, cy - circleOffset, cy + textOffset, radius, textSize);
       }
   }
   
   // --- Recording Status (Bottom) ---
   if (isRecording) {
-    updateDashboardTimer();
+    drawDashboardTimer();
   }
 }
 
 // External pairing menu selection (defined at top of this file)
 
 void drawPairingMenu() {
-  int width = M5.Lcd.width();
-  int height = M5.Lcd.height();
-  int numItems = 4;
+  int width = gfx->width();
+  int height = gfx->height();
+  int numItems = pairingMenuItems;
   int itemHeight = height / numItems;
   
-  // Force smaller text in Vertical mode to fit width
-  int menuTextSize = (isVerticalLayout) ? 1 : scaledTextSize;
+  // Force smaller text in Vertical mode (or with many slots) to fit
+  int menuTextSize = (isVerticalLayout || MAX_CAMERAS > 2) ? 1 : layout->textSize;
   
-  String layoutStr = isVerticalLayout ? "LAYOUT: VERT" : "LAYOUT: HORIZ";
-  String items[] = {"PAIR SLOT 1", "PAIR SLOT 2", layoutStr, "BACK"};
-  uint16_t colors[] = {ICON_BLUE, ICON_CYAN, ICON_YELLOW, WHITE};
+  const uint16_t slotColors[] = {ICON_BLUE, ICON_CYAN};
   
   for (int i = 0; i < numItems; i++) {
     int y = i * itemHeight;
     
+    char item[16];
+    uint16_t color;
+    if (i < MAX_CAMERAS) {
+      snprintf(item, sizeof(item), "PAIR SLOT %d", i + 1);
+      color = slotColors[i % 2];
+    } else if (i == MAX_CAMERAS) {
+      snprintf(item, sizeof(item), "%s", isVerticalLayout ? "LAYOUT: VERT" : "LAYOUT: HORIZ");
+      color = ICON_YELLOW;
+    } else {
+      snprintf(item, sizeof(item), "BACK");
+      color = WHITE;
+    }
+    
     // Highlight selection
     if (i == pairingMenuSelection) {
-      M5.Lcd.fillRect(0, y, width, itemHeight, DARKGREY);
-      M5.Lcd.drawRect(0, y, width, itemHeight, WHITE);
+      gfx->fillRect(0, y, width, itemHeight, DARKGREY);
+      gfx->drawRect(0, y, width, itemHeight, WHITE);
     }
     
     // Draw Text
-    M5.Lcd.setTextColor(colors[i]);
-    M5.Lcd.setTextSize(menuTextSize);
-    int textWidth = getTextWidth(items[i], menuTextSize);
-    M5.Lcd.setCursor((width - textWidth) / 2, y + (itemHeight/2) - 5);
-    M5.Lcd.print(items[i]);
+    gfx->setTextColor(color);
+    gfx->setTextSize(menuTextSize);
+    int textWidth = getTextWidth(item, menuTextSize);
+    gfx->setCursor((width - textWidth) / 2, y + (itemHeight/2) - 5);
+    gfx->print(item);
   }
 }
 
-void updateDisplay() {
-  M5.Lcd.fillScreen(BLACK);
-  M5.Lcd.setTextSize(scaledTextSize);
+// Render task side of updateDisplay(): the current screen from state
+void drawFrame() {
+  HEAP_PROBE_SCOPE(HEAP_SITE_DISPLAY);
+
+  gfx->fillScreen(BLACK);
+  gfx->setTextSize(layout->textSize);
   
   if (currentScreen == 0) {
     drawDashboard();
   } else if (currentScreen == 1) {
     drawPairingMenu();
   }
+
+  // Keep an active toast on top of the fresh frame
+  if (toast.active) {
+    if (toast.message) drawMessageBox(toast.line1, toast.line2, toast.color);
+    else drawBottomStatus(toast.line1, toast.color);
+  }
+}
+
+// Pairing icon with one status line and the cancel hint
+void drawPairingScreen(const char* text, uint16_t color) {
+  gfx->fillScreen(BLACK);
+  drawBitmap(layout->iconX, layout->iconY, pairing_icon, 32, 32, ICON_CYAN);
+  drawCenteredText(text, layout->iconLine1Y, color);
+  drawCenteredText("B:Cancel", layout->iconLine2Y, CYAN);
+}
+
+void drawRenderRequest(const RenderRequest& req) {
+  switch (req.kind) {
+    case RENDER_FRAME:   drawFrame(); break;
+    case RENDER_TIMER:   drawDashboardTimer(); break;
+    case RENDER_PAIRING: drawPairingScreen(req.text, req.color); break;
+    case RENDER_ROTATE:  rotateDisplay(); break;
+    default: break;
+  }
+}
+
+// Ask the render task for a full redraw. The battery is read here, on the
+// control task, so the render task never shares the I2C bus with M5.update().
+void updateDisplay() {
+  if (pairingOwnsScreen()) {
+    updateScreenRequested = true; // Redrawn when pairing ends
+    return;
+  }
+  remoteBatteryLevel = M5.Power.getBatteryLevel();
+  postRender(RENDER_FRAME);
 }
 
 void showNotConnectedMessage() {
-  M5.Lcd.fillScreen(BLACK);
-  M5.Lcd.setTextSize(scaledTextSize);
-  int msgX = isPlus2 ? 40 : 30;
-  int msgY = isPlus2 ? 55 : 35;
-  M5.Lcd.setCursor(msgX, msgY);
-  M5.Lcd.setTextColor(RED);
-  M5.Lcd.println("Not Connected!");
-  delay(1500);
-  updateDisplay();
+  showMessageToast("Not", "Connected!", RED, 1500);
 }
 
 void showNoCameraMessage() {
-  M5.Lcd.fillScreen(BLACK);
-  M5.Lcd.setTextSize(scaledTextSize);
-  int msgX = isPlus2 ? 25 : 25;
-  int msgY1 = isPlus2 ? 45 : 30;
-  int msgY2 = isPlus2 ? 70 : 45;
-  
-  M5.Lcd.setCursor(msgX, msgY1);
-  M5.Lcd.setTextColor(RED);
-  M5.Lcd.println("No camera paired!");
-  M5.Lcd.setCursor(msgX + (isPlus2 ? 10 : 5), msgY2);
-  M5.Lcd.setTextColor(WHITE);
-  M5.Lcd.println("Connect first");
-  delay(2000);
-  updateDisplay();
+  showMessageToast("No camera", "Pair first", RED, 2000);
+}
+
+const char* const triggerPinNames[TRIGGER_COUNT] = { "G0", "G26", "G36" };
+const char* const triggerActionNames[TRIGGER_COUNT] = { "Shutter", "Sleep", "Wake" };
+const TraceInput triggerTraceInputs[TRIGGER_COUNT] = { TRACE_INPUT_G0, TRACE_INPUT_G26, TRACE_INPUT_G36 };
+
+void runGPIOAction(int id) {
+  switch (id) {
+    case TRIGGER_SHUTTER:
+      noteSlotTrigger();
+      executeShutter();
+      // Also toggle timer for GPIO press
+      if (!isRecording) {
+          isRecording = true;
+          recordingStartTime = millis();
+      } else {
+          isRecording = false;
+      }
+      updateDisplay();
+      break;
+    case TRIGGER_SLEEP:
+      executeSleep();
+      break;
+    case TRIGGER_WAKE:
+      executeWake();
+      break;
+  }
 }
 
+// Turns trigger pin edges (captured by the ISRs in scheduler.h) into actions.
+// Each action is due gpioDelay ms after its edge, so remotes sharing a trigger
+// cable stay staggered without loop() sleeping through the offset.
 void checkGPIOPins() {
   unsigned long currentTime = millis();
   
   // Skip GPIO checks during startup delay
   if (currentTime - startupTime < startupDelay) {
+    for (int i = 0; i < TRIGGER_COUNT; i++) {
+      gpioEdgesSeen[i] = triggerEdges[i].count; // Drop edges from power-up
+    }
     return; // GPIO input disabled during startup
   }
   
   // One-time message when GPIO becomes active
   static bool gpioActivationMessageShown = false;
   if (!gpioActivationMessageShown) {
-    Serial.println("GPIO input now active!");
+    LOGI("GPIO input now active!");
     gpioActivationMessageShown = true;
   }
   
-  // Check G0 (SHUTTER_PIN) - Function #2 - Trigger on LOW (to GND)
-  static bool lastShutterState = HIGH; // G0 defaults to HIGH due to hardware pullup
-  bool currentShutterState = digitalRead(SHUTTER_PIN);
-  
-  if (currentShutterState == LOW && lastShutterState == HIGH && (currentTime - lastPinPress[0] > debounceDelay)) {
-    lastPinPress[0] = currentTime;
-    Serial.print("GPIO Pin G0 activated (pulled to GND) - Delaying ");
-    Serial.print(gpioDelay);
-    Serial.println("ms then executing Shutter");
-    delay(gpioDelay);  // Apply unique delay before executing
-    executeShutter();
-    // Also toggle timer for GPIO press
-    if (!isRecording) {
-        isRecording = true;
-        recordingStartTime = millis();
-    } else {
-        isRecording = false;
+  for (int i = 0; i < TRIGGER_COUNT; i++) {
+    uint32_t count, edgeUs;
+    readTriggerEdge(i, &count, &edgeUs);
+    if (count == gpioEdgesSeen[i]) continue;
+
+    if (count - gpioEdgesSeen[i] > 1) {
+      LOGW("GPIO Pin %s: %lu triggers merged", triggerPinNames[i], (unsigned long)(count - gpioEdgesSeen[i]));
     }
-    updateDisplay();
+    gpioEdgesSeen[i] = count;
+    traceAt(edgeUs, TRACE_INPUT_EDGE, triggerTraceInputs[i], 1);
+
+    unsigned long edgeAge = (micros() - edgeUs) / 1000;
+    gpioActionDue[i] = currentTime - edgeAge + gpioDelay;
+    gpioActionPending[i] = true;
+    LOGI("GPIO Pin %s activated %lums ago - executing %s at +%dms",
+         triggerPinNames[i], edgeAge, triggerActionNames[i], gpioDelay);
   }
-  lastShutterState = currentShutterState;
-  
-  // Check G26 (SLEEP_PIN) - Function #5 - Trigger on HIGH (to 3.3V)
-  static bool lastSleepState = LOW;
-  bool currentSleepState = digitalRead(SLEEP_PIN);
-  
-  if (currentSleepState == HIGH && lastSleepState == LOW && (currentTime - lastPinPress[1] > debounceDelay)) {
-    lastPinPress[1] = currentTime;
-    Serial.print("GPIO Pin G26 activated - Delaying ");
-    Serial.print(gpioDelay);
-    Serial.println("ms then executing Sleep");
-    delay(gpioDelay);  // Apply unique delay before executing
-    executeSleep();
+
+  // Run what is due, wake up again for the rest
+  cancelDeadline(DEADLINE_GPIO_ACTION);
+  for (int i = 0; i < TRIGGER_COUNT; i++) {
+    if (!gpioActionPending[i]) continue;
+    if ((long)(millis() - gpioActionDue[i]) >= 0) {
+      gpioActionPending[i] = false;
+      runGPIOAction(i);
+    }
   }
-  lastSleepState = currentSleepState;
-  
-  // Check G36 (WAKE_PIN) - Function #6 - Trigger on HIGH (to 3.3V)
-  static bool lastWakeState = LOW;
-  bool currentWakeState = digitalRead(WAKE_PIN);
-  
-  if (currentWakeState == HIGH && lastWakeState == LOW && (currentTime - lastPinPress[2] > debounceDelay)) {
-    lastPinPress[2] = currentTime;
-    Serial.print("GPIO Pin G36 activated - Delaying ");
-    Serial.print(gpioDelay);
-    Serial.println("ms then executing Wake");
-    delay(gpioDelay);  // Apply unique delay before executing
-    executeWake();
+  bool armed = false;
+  unsigned long next = 0;
+  for (int i = 0; i < TRIGGER_COUNT; i++) {
+    if (!gpioActionPending[i]) continue;
+    if (!armed || (long)(gpioActionDue[i] - next) < 0) next = gpioActionDue[i];
+    armed = true;
   }
-  lastWakeState = currentWakeState;
+  if (armed) armDeadline(DEADLINE_GPIO_ACTION, next);
 }
 
 #endif // UI_H
\ No newline at end of file